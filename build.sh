@@ -1 +1 @@
-compute++ --gcc-toolchain=/cm/shared/languages/GCC-4.8.4 -O2 --std=c++11 -sycl -intelspirmetadata -emit-llvm -D__DEVICE_SPIR32__ -DBUILD_PLATFORM_SPIR -I$HOME/Programs/ComputeCpp/include -o helloWorld_SYCL.cpp.bc -c helloWorld_SYCL.cpp && compute++ --gcc-toolchain=/cm/shared/languages/GCC-4.8.4 -O2 --std=c++11 -I$HOME/Programs/ComputeCpp/include -L$HOME/Programs/ComputeCpp/lib -lSYCL -lOpenCL helloWorld_SYCL.cpp --include helloWorld_SYCL.cpp.sycl -o helloWorld_SYCL -ggdb
+compute++ --gcc-toolchain=/cm/shared/languages/GCC-4.8.4 -O2 --std=c++11 -sycl -intelspirmetadata -emit-llvm -D__DEVICE_SPIR32__ -DBUILD_PLATFORM_SPIR -I$HOME/Programs/ComputeCpp/include -o helloWorld_SYCL.cpp.bc -c helloWorld_SYCL.cpp && compute++ --gcc-toolchain=/cm/shared/languages/GCC-4.8.4 -O2 --std=c++11 -I$HOME/Programs/ComputeCpp/include -L$HOME/Programs/ComputeCpp/lib -lSYCL -lOpenCL helloWorld_SYCL.cpp tools/CommandLineParser.cpp tools/DeviceSelector.cpp tools/BandwidthBenchmark.cpp tools/ComputeBenchmark.cpp tools/KernelGenerator.cpp tools/Timing.cpp tools/SizeSweep.cpp --include helloWorld_SYCL.cpp.sycl -o helloWorld_SYCL -ggdb
@@ -4,24 +4,54 @@
  * and dumps some information to stdout.
  *
  * Compile with:
- *     clang++ --std=c++11 --stdlib=libc++ -I$HOME/Programs/OpenCL/AMDAPPSDK-3.0/include -L$HOME/Programs/OpenCL/AMDAPPSDK-3.0/lib/x86_64/sdk -l OpenCL checkOpenCL.cpp tools/CommandLineParser.cpp -o checkOpenCL -Wno-deprecated-declarations -ggdb
+ *     clang++ --std=c++11 --stdlib=libc++ -I$HOME/Programs/OpenCL/AMDAPPSDK-3.0/include -L$HOME/Programs/OpenCL/AMDAPPSDK-3.0/lib/x86_64/sdk -l OpenCL checkOpenCL.cpp tools/CommandLineParser.cpp tools/Timing.cpp tools/DeviceSession.cpp tools/ProgramCache.cpp tools/StreamingPipeline.cpp tools/WorkGroupTuner.cpp tools/BandwidthBenchmark.cpp tools/ComputeBenchmark.cpp tools/KernelGenerator.cpp tools/KernelSpec.cpp tools/Verification.cpp tools/HostBaseline.cpp tools/SizeSweep.cpp tools/ResultsReport.cpp tools/DeviceSelector.cpp tools/AsyncSubmitter.cpp tools/Trace.cpp tools/SubmissionBenchmark.cpp tools/BuildVariants.cpp tools/BufferPool.cpp tools/KernelChain.cpp tools/DeviceVerifier.cpp tools/SubDevices.cpp -o checkOpenCL -pthread -Wno-deprecated-declarations -ggdb
  */
 //#define __CL_ENABLE_EXCEPTIONS
 #include <iostream>
 #include <iomanip>
 #include <vector>
 #include <fstream>
+#include <sstream>
+#include <map>
+#include <memory>
+#include <thread>
+#include <numeric>
+#include <algorithm>
+#include <exception>
+#include <cmath>
+#include <limits>
 #include <CL/cl.hpp>
 #include "tools/CommandLineParser.h"
 #include "tools/OpenCLEnums.h"
+#include "tools/Timing.h"
+#include "tools/DeviceSession.h"
+#include "tools/ProgramCache.h"
+#include "tools/AlignedAllocator.h"
+#include "tools/StreamingPipeline.h"
+#include "tools/WorkGroupTuner.h"
+#include "tools/BandwidthBenchmark.h"
+#include "tools/ComputeBenchmark.h"
+#include "tools/KernelGenerator.h"
+#include "tools/KernelSpec.h"
+#include "tools/Verification.h"
+#include "tools/HostBaseline.h"
+#include "tools/SizeSweep.h"
+#include "tools/ResultsReport.h"
+#include "tools/DeviceSelector.h"
+#include "tools/AsyncSubmitter.h"
+#include "tools/Trace.h"
+#include "tools/SubmissionBenchmark.h"
+#include "tools/BuildVariants.h"
+#include "tools/BufferPool.h"
+#include "tools/KernelChain.h"
+#include "tools/DeviceVerifier.h"
+#include "tools/SubDevices.h"
 
-const char *TestKernel="\n" \
-"__kernel void square( __global float* input, const unsigned long inputCount, __global float* output, const unsigned long outputCount ) \n" \
-"{                                                                                               \n" \
-"   int index=get_global_id(0);                                                                  \n" \
-"   //printf( \"input is %f\\n\", input[index] );                                                  \n" \
-"   if( index<inputCount && index<outputCount ) output[index] = input[index]*input[index];       \n" \
-"}                                                                                               \n";
+typedef float T_input;
+typedef float T_output;
+// Page aligned so that CL_MEM_USE_HOST_PTR buffers can use the memory directly
+typedef std::vector<T_input,tools::AlignedAllocator<T_input> > InputVector;
+typedef std::vector<T_output,tools::AlignedAllocator<T_output> > OutputVector;
 
 std::vector<cl::Device> getAllDevices()
 {
@@ -68,16 +98,983 @@ void printDevices( const std::vector<cl::Device>& devices, std::ostream& output=
 	}
 }
 
+/** @brief Splits "total" into parts proportional to "weights". The parts always add up to exactly total. */
+std::vector<size_t> partitionByWeight( size_t total, const std::vector<double>& weights )
+{
+	std::vector<size_t> parts( weights.size(), 0 );
+	if( parts.empty() ) return parts;
+
+	double weightSum=std::accumulate( weights.begin(), weights.end(), 0.0 );
+	size_t assigned=0;
+	for( size_t index=0; index<weights.size(); ++index )
+	{
+		double fraction=( weightSum>0 ? weights[index]/weightSum : 1.0/weights.size() );
+		parts[index]=static_cast<size_t>( total*fraction );
+		assigned+=parts[index];
+	}
+	// Anything left over from rounding down goes to the biggest share
+	parts[ std::max_element( weights.begin(), weights.end() )-weights.begin() ]+=total-assigned;
+	return parts;
+}
+
+/** @brief Runs one of the session's programs on pInput and copies the result into pOutput.
+ *
+ * The number of elements used is session.elementCount(). If pTimings is not null, the "write",
+ * "kernel <name>" and "read <name>" phases are filled (the session must have profiling enabled).
+ * @param writeInput   Whether to copy pInput to the device first. Not required if the input was
+ *                     written for a previous program in the session and hasn't changed.
+ * @param pOutput      If null the output is left on the device (e.g. for tools::DeviceVerifier), and
+ *                     there is no "read <name>" phase.
+ * The output buffer isn't reset first. Callers that check the results call session.fillOutput()
+ * before starting their timers, so that the reset isn't counted as part of the program.
+ */
+void runProgram( const tools::DeviceSession& session, size_t programIndex, bool writeInput, const T_input* pInput, T_output* pOutput, tools::PhaseTimings* pTimings )
+{
+	cl_int error=CL_SUCCESS;
+	const cl::CommandQueue& queue=session.queue();
+	const tools::DeviceSession::Program& program=session.programs().at(programIndex);
+	const size_t elementCount=session.elementCount();
+	// Label the phases with the transfer strategy, unless it's the default
+	std::string suffix;
+	if( session.transferStrategy()!=tools::DeviceSession::CopyTransfer ) suffix=" ["+tools::DeviceSession::transferStrategyName(session.transferStrategy())+"]";
+
+	if( writeInput )
+	{
+		double writeTime=session.writeInput( pInput );
+		if( pTimings ) pTimings->phase( "write"+suffix, sizeof(T_input)*elementCount, elementCount ).addSample( writeTime );
+	}
+
+	//
+	// Run the kernel
+	//
+	std::string kernelLabel="kernel "+program.name;
+	if( program.vectorWidth>1 ) kernelLabel+=" x"+std::to_string(program.vectorWidth);
+	if( program.maxWorkItems!=0 ) kernelLabel+=" grid stride";
+	cl::Event kernelEvent;
+	error=tools::trace::enqueueNDRangeKernel( queue, program.kernel, 0, tools::DeviceSession::globalRange( tools::DeviceSession::workItemCount( program, elementCount ), program.workGroupSize ),
+			tools::DeviceSession::localRange( program.workGroupSize ), nullptr, &kernelEvent );
+	if( error!=CL_SUCCESS ) throw std::runtime_error( "Error when enqueing kernel - "+tools::enqueKernelError(error) );
+
+	tools::trace::finish( queue );
+	// The kernel reads the input and writes the output, so count both for the bandwidth
+	if( pTimings ) pTimings->phase( kernelLabel+suffix, (sizeof(T_input)+sizeof(T_output))*elementCount, elementCount ).addSample( tools::eventDuration(kernelEvent) );
+
+	//
+	// Get the output, unless it is being checked on the device
+	//
+	if( pOutput==nullptr ) return;
+	double readTime=session.readOutput( pOutput );
+	if( pTimings ) pTimings->phase( "read "+program.name+suffix, sizeof(T_output)*elementCount, elementCount ).addSample( readTime );
+}
+
+/** @brief Checks that each of the "resultCount" results is the square of the element of "data", on several host threads.
+ *
+ * If pTimings is not null the host time taken is added to the "verify" phase, separately from the device phases.
+ * @param squarings   How many times the data has been squared, for the output of a chain of programs.
+ */
+tools::VerificationResult verifyResults( const InputVector& data, const T_output* pResults, size_t resultCount, const tools::ResultVerifier& verifier, tools::PhaseTimings* pTimings,
+		size_t squarings=1 )
+{
+	tools::trace::Scope traceScope( "host", "verify" );
+	const T_input* pInput=data.data();
+	tools::VerificationResult result=verifier.verify( pResults, std::min( data.size(), resultCount ), [pInput,squarings]( size_t first, size_t count, T_output* pExpected )
+		{
+			for( size_t index=0; index<count; ++index )
+			{
+				T_output value=pInput[first+index];
+				for( size_t squaring=0; squaring<squarings; ++squaring ) value=value*value;
+				// Equal infinities would pass, so an expected value that overflowed counts as a mismatch
+				pExpected[index]=( std::isfinite(value) ? value : std::numeric_limits<T_output>::quiet_NaN() );
+			}
+		} );
+	if( pTimings ) pTimings->phase( "verify", (sizeof(T_input)+sizeof(T_output))*result.checked, result.checked ).addSample( result.time );
+	return result;
+}
+
+tools::VerificationResult verifyResults( const InputVector& data, const OutputVector& results, const tools::ResultVerifier& verifier, tools::PhaseTimings* pTimings )
+{
+	return verifyResults( data, results.data(), results.size(), verifier, pTimings );
+}
+
+/** @brief How long the host takes to do the same work as the test kernel, to compare the devices with. */
+struct HostBaseline
+{
+	double time; ///< @brief Median wall clock seconds. Zero or less if it hasn't been measured.
+	size_t threads;
+};
+
+/** @brief Times squaring the data on the host with all of the threads used for verification.
+ *
+ * One warm up run (which also makes sure the output memory is paged in) and then the median of five.
+ */
+HostBaseline measureHostBaseline( const InputVector& data, size_t numberOfThreads )
+{
+	OutputVector hostResults( data.size() );
+	tools::squareOnHost( data.data(), hostResults.data(), data.size(), numberOfThreads );
+	tools::TimingStatistics statistics;
+	for( size_t run=0; run<5; ++run ) statistics.addSample( tools::squareOnHost( data.data(), hostResults.data(), data.size(), numberOfThreads ) );
+	return HostBaseline{ statistics.median(), tools::hostThreadCount(numberOfThreads) };
+}
+
+/** @brief Prints how many times faster than the host baseline deviceTime is, if the baseline has been measured.
+ *
+ * @param covered   Which transfers deviceTime includes, for the label.
+ */
+void printSpeedup( double deviceTime, const HostBaseline& hostBaseline, const std::string& covered="including transfers", std::ostream& output=std::cout )
+{
+	if( hostBaseline.time<=0 || deviceTime<=0 ) return;
+	output << "   speedup vs " << hostBaseline.threads << "-thread host " << hostBaseline.time/deviceTime << "x (" << covered << ")" << std::endl;
+}
+
+/** @brief Splits the data between all of the devices and runs them all at the same time from separate threads.
+ *
+ * Each device gets a share of the data proportional to CL_DEVICE_MAX_COMPUTE_UNITS times
+ * CL_DEVICE_MAX_CLOCK_FREQUENCY, or if "calibrate" is true proportional to the throughput
+ * measured when running the first program on a sample of the data on each device in turn.
+ */
+void executeSplitAcrossDevices( const std::vector<cl::Device>& devices, std::vector<size_t> devicesToUse, const std::vector<tools::DeviceSession::ProgramSource>& programSources,
+		const InputVector& data, OutputVector& results, const tools::ResultVerifier& verifier, const HostBaseline& hostBaseline, int timesToRepeat, bool calibrate, bool coldStart, const tools::DeviceSession::Settings& baseSettings,
+		std::map<size_t,tools::PhaseTimings>& deviceTimings, tools::PhaseTimings& combinedTimings )
+{
+	// Each device has its own thread, so make sure the same device isn't used twice
+	std::sort( devicesToUse.begin(), devicesToUse.end() );
+	devicesToUse.erase( std::unique( devicesToUse.begin(), devicesToUse.end() ), devicesToUse.end() );
+	if( devicesToUse.empty() ) throw std::runtime_error( "There are no valid devices to split the data between" );
+
+	const bool recordTiming=baseSettings.enableProfiling;
+
+	//
+	// Figure out what share each device gets
+	//
+	std::vector<double> weights;
+	for( const auto deviceNumber : devicesToUse )
+	{
+		const auto& device=devices[deviceNumber];
+		if( calibrate )
+		{
+			const size_t calibrationSize=std::min<size_t>( data.size(), 1<<20 );
+			OutputVector calibrationResults( calibrationSize );
+			tools::DeviceSession::Settings settings=baseSettings;
+			settings.pHostInput=data.data();
+			settings.pHostOutput=calibrationResults.data();
+			tools::DeviceSession session( device, programSources, calibrationSize, sizeof(T_input), settings );
+			runProgram( session, 0, true, data.data(), calibrationResults.data(), nullptr ); // Warm up run, not timed
+			tools::StopWatch stopWatch;
+			runProgram( session, 0, true, data.data(), calibrationResults.data(), nullptr );
+			weights.push_back( calibrationSize/stopWatch.elapsed() );
+		}
+		else weights.push_back( static_cast<double>(device.getInfo<CL_DEVICE_MAX_COMPUTE_UNITS>())*device.getInfo<CL_DEVICE_MAX_CLOCK_FREQUENCY>() );
+	}
+	const std::vector<size_t> shares=partitionByWeight( data.size(), weights );
+	std::vector<size_t> offsets( shares.size(), 0 );
+	for( size_t index=1; index<shares.size(); ++index ) offsets[index]=offsets[index-1]+shares[index-1];
+
+	std::cout << "Splitting " << data.size() << " elements between " << devicesToUse.size() << " devices (weighted by " << (calibrate ? "calibration run" : "compute units x clock") << "):" << std::endl;
+	for( size_t index=0; index<devicesToUse.size(); ++index )
+	{
+		std::cout << "   " << devicesToUse[index] << ": " << deviceInformationString(devices[devicesToUse[index]]) << " gets " << shares[index]
+				<< " elements (" << std::fixed << std::setprecision(1) << 100.0*shares[index]/data.size() << "%)" << std::endl;
+		std::cout.unsetf( std::ios::floatfield );
+		std::cout << std::setprecision(6);
+		// Create the timing entries now, because the std::map can't be modified from the threads
+		if( recordTiming ) deviceTimings[devicesToUse[index]];
+	}
+
+	std::vector<std::unique_ptr<tools::DeviceSession> > sessions( devicesToUse.size() );
+	std::vector<std::exception_ptr> threadErrors( devicesToUse.size() );
+
+	// Note that it's intentional to repeat forever if timesToRepeat is negative (quit with ctrl-c)
+	for( int repetitionIndex=0; repetitionIndex!=timesToRepeat; ++repetitionIndex )
+	{
+		for( size_t programIndex=0; programIndex<programSources.size(); ++programIndex )
+		{
+			// Reset the outputs before the clock starts; a new session's output has no earlier results in it
+			for( const auto& pSession : sessions ) if( pSession ) pSession->fillOutput();
+			tools::StopWatch wallClock;
+			std::vector<std::thread> threads;
+			for( size_t index=0; index<devicesToUse.size(); ++index )
+			{
+				if( shares[index]==0 ) continue;
+				threads.emplace_back( [&,index]()
+				{
+					try
+					{
+						const size_t deviceNumber=devicesToUse[index];
+						tools::PhaseTimings* pTimings=( recordTiming ? &deviceTimings.at(deviceNumber) : nullptr );
+						bool newSession=false;
+						if( !sessions[index] || (coldStart && programIndex==0) )
+						{
+							tools::DeviceSession::Settings settings=baseSettings;
+							settings.pTimings=pTimings;
+							settings.pHostInput=&data[offsets[index]];
+							settings.pHostOutput=&results[offsets[index]];
+							sessions[index].reset();
+							sessions[index].reset( new tools::DeviceSession( devices[deviceNumber], programSources, shares[index], sizeof(T_input), settings ) );
+							newSession=true;
+						}
+						// The input only needs writing once per session, since it never changes
+						runProgram( *sessions[index], programIndex, newSession || programIndex==0, &data[offsets[index]], &results[offsets[index]], pTimings );
+					}
+					catch( ... ) { threadErrors[index]=std::current_exception(); }
+				} );
+			}
+			for( auto& thread : threads ) thread.join();
+			for( auto& error : threadErrors )
+			{
+				if( error ) std::rethrow_exception( error );
+			}
+			double wallTime=wallClock.elapsed();
+
+			const std::string& programName=programSources[programIndex].name;
+			if( recordTiming ) combinedTimings.phase( "all devices "+programName, (sizeof(T_input)+sizeof(T_output))*data.size(), data.size() ).addSample( wallTime );
+			std::cout << "   " << programName << ": " << wallTime*1e3 << " ms (" << data.size()/wallTime/1e6 << " Melements/s including transfers)." << std::endl;
+			printSpeedup( wallTime, hostBaseline );
+			tools::printVerification( verifyResults( data, results, verifier, recordTiming ? &combinedTimings : nullptr ), verifier.tolerance(), std::cout );
+		} // end of loop over programs
+	} // end of loop over timesToRepeat
+}
+
+/** @brief Runs each program over the data in chunks, both serially and with uploads, kernels and downloads overlapped.
+ *
+ * Reports how much of the ideal overlap the pipelined version achieved. The ideal is taken to be when
+ * the wall time is the same as the busiest of the upload, kernel and download stages.
+ */
+void executeStreaming( const std::vector<cl::Device>& devices, const std::vector<size_t>& devicesToUse, const std::vector<tools::DeviceSession::ProgramSource>& programSources,
+		const InputVector& data, OutputVector& results, const tools::ResultVerifier& verifier, const HostBaseline& hostBaseline, int timesToRepeat, size_t chunkElements, size_t numberOfBufferSets, bool coldStart,
+		const tools::DeviceSession::Settings& baseSettings, std::map<size_t,tools::PhaseTimings>& deviceTimings )
+{
+	chunkElements=std::min( chunkElements, data.size() );
+	const size_t dataBytes=(sizeof(T_input)+sizeof(T_output))*data.size(); // Everything goes up and comes back
+
+	// Sessions and pipelines for each device, keyed by device number
+	std::map<size_t,std::unique_ptr<tools::DeviceSession> > sessions;
+	std::map<size_t,std::vector<tools::StreamingPipeline> > pipelines;
+
+	// Note that it's intentional to repeat forever if timesToRepeat is negative (quit with ctrl-c)
+	for( int repetitionIndex=0; repetitionIndex!=timesToRepeat; ++repetitionIndex )
+	{
+		for( const auto deviceNumber : devicesToUse )
+		{
+			const auto& device=devices[deviceNumber];
+			std::cout << "Attempting to stream on device " << deviceInformationString(device) << std::endl;
+
+			std::unique_ptr<tools::DeviceSession>& pSession=sessions[deviceNumber];
+			if( !pSession || coldStart )
+			{
+				if( sizeof(T_input)*chunkElements>device.getInfo<CL_DEVICE_MAX_MEM_ALLOC_SIZE>() )
+				{
+					std::cerr << "Warning! A chunk of " << chunkElements << " elements is larger than CL_DEVICE_MAX_MEM_ALLOC_SIZE for this device" << std::endl;
+				}
+				tools::DeviceSession::Settings sessionSettings=baseSettings;
+				if( baseSettings.enableProfiling ) sessionSettings.pTimings=&deviceTimings[deviceNumber];
+				// The pipeline does its own transfers, and the session buffers are only chunk sized
+				sessionSettings.transferStrategy=tools::DeviceSession::CopyTransfer;
+
+				pipelines[deviceNumber].clear();
+				pSession.reset();
+				pSession.reset( new tools::DeviceSession( device, programSources, chunkElements, sizeof(T_input), sessionSettings ) );
+				for( size_t programIndex=0; programIndex<pSession->programs().size(); ++programIndex )
+				{
+					pipelines[deviceNumber].emplace_back( *pSession, programIndex, numberOfBufferSets );
+				}
+			}
+
+			for( size_t programIndex=0; programIndex<pipelines[deviceNumber].size(); ++programIndex )
+			{
+				tools::StreamingPipeline& pipeline=pipelines[deviceNumber][programIndex];
+				const std::string& programName=pSession->programs()[programIndex].name;
+
+				tools::StreamingPipeline::Result serial=pipeline.runSerial( data.data(), results.data(), data.size() );
+				std::fill( results.begin(), results.end(), 0 ); // So that the serial run can't hide errors in the pipelined one
+				tools::StreamingPipeline::Result pipelined=pipeline.run( data.data(), results.data(), data.size() );
+
+				double busiestStage=std::max( pipelined.uploadTime, std::max( pipelined.kernelTime, pipelined.downloadTime ) );
+				std::cout << "   " << programName << " in " << pipelined.chunks << " chunks of " << chunkElements << " elements with " << pipeline.numberOfBufferSets() << " buffer sets:" << "\n"
+						<< "      serial    " << serial.wallTime*1e3 << " ms (upload " << serial.uploadTime*1e3 << " ms, kernel " << serial.kernelTime*1e3
+						<< " ms, download " << serial.downloadTime*1e3 << " ms)" << "\n"
+						<< "      pipelined " << pipelined.wallTime*1e3 << " ms (upload " << pipelined.uploadTime*1e3 << " ms, kernel " << pipelined.kernelTime*1e3
+						<< " ms, download " << pipelined.downloadTime*1e3 << " ms)" << "\n"
+						<< "      speedup " << serial.wallTime/pipelined.wallTime;
+				if( serial.wallTime>busiestStage ) std::cout << ", achieved " << 100.0*(serial.wallTime-pipelined.wallTime)/(serial.wallTime-busiestStage) << "% of the ideal overlap";
+				std::cout << std::endl;
+				printSpeedup( pipelined.wallTime, hostBaseline );
+				tools::printVerification( verifyResults( data, results, verifier, baseSettings.enableProfiling ? &deviceTimings[deviceNumber] : nullptr ), verifier.tolerance(), std::cout );
+
+				if( baseSettings.enableProfiling )
+				{
+					deviceTimings[deviceNumber].phase( "stream serial "+programName, dataBytes, data.size() ).addSample( serial.wallTime );
+					deviceTimings[deviceNumber].phase( "stream pipelined "+programName, dataBytes, data.size() ).addSample( pipelined.wallTime );
+				}
+			}
+		} // end of loop over devicesToUse
+	} // end of loop over timesToRepeat
+}
+
+/** @brief Finds the fastest local work group size for each program on each device, and saves them in the table. */
+void executeAutotune( const std::vector<cl::Device>& devices, const std::vector<size_t>& devicesToUse, const std::vector<tools::DeviceSession::ProgramSource>& programSources,
+		const InputVector& data, const tools::DeviceSession::Settings& baseSettings, tools::WorkGroupSizeTable& workGroupSizes )
+{
+	tools::DeviceSession::Settings sessionSettings=baseSettings;
+	sessionSettings.enableProfiling=true; // Kernels are timed with profiling events
+	sessionSettings.pTimings=nullptr;
+	sessionSettings.pWorkGroupSizes=nullptr;
+	sessionSettings.transferStrategy=tools::DeviceSession::CopyTransfer;
+
+	for( const auto deviceNumber : devicesToUse )
+	{
+		const auto& device=devices[deviceNumber];
+
+		tools::DeviceSession session( device, programSources, data.size(), sizeof(T_input), sessionSettings );
+		session.writeInput( data.data() );
+		for( size_t programIndex=0; programIndex<session.programs().size(); ++programIndex )
+		{
+			const auto& program=session.programs()[programIndex];
+			std::cout << "Tuning work group size for " << program.kernelName << " with " << data.size() << " elements on device " << deviceInformationString(device) << std::endl;
+			size_t bestSize=tools::autotuneWorkGroupSize( session, programIndex, 5, &std::cout );
+			workGroupSizes.set( device, program.kernelName, program.buildOptions, data.size(), bestSize );
+		}
+	}
+	workGroupSizes.save();
+	std::cout << "Tuned work group sizes saved to '" << workGroupSizes.filename() << "'" << std::endl;
+}
+
+/** @brief Runs the kernel described by each spec file on each device, checking against the reference output if there is one.
+ *
+ * Each spec and device gets its own harness, created once and reused for every repetition unless coldStart is true.
+ */
+void executeSpecs( const std::vector<cl::Device>& devices, const std::vector<size_t>& devicesToUse, const std::vector<std::string>& specFilenames,
+		int timesToRepeat, bool coldStart, bool recordTiming, tools::ProgramCache* pProgramCache, tools::BufferPool* pBufferPool, std::map<size_t,tools::PhaseTimings>& deviceTimings )
+{
+	std::vector<tools::KernelSpec> specs;
+	for( const auto& filename : specFilenames ) specs.push_back( tools::KernelSpec::load(filename) );
+
+	// Keyed by spec index and device number
+	std::map<std::pair<size_t,size_t>,std::unique_ptr<tools::KernelHarness> > harnesses;
+	// Note that it's intentional to repeat forever if timesToRepeat is negative (quit with ctrl-c)
+	for( int repetitionIndex=0; repetitionIndex!=timesToRepeat; ++repetitionIndex )
+	{
+		for( size_t specIndex=0; specIndex<specs.size(); ++specIndex )
+		{
+			for( const auto deviceNumber : devicesToUse )
+			{
+				const auto& device=devices[deviceNumber];
+				tools::PhaseTimings* pTimings=( recordTiming ? &deviceTimings[deviceNumber] : nullptr );
+
+				std::unique_ptr<tools::KernelHarness>& pHarness=harnesses[std::make_pair(specIndex,deviceNumber)];
+				if( !pHarness || coldStart )
+				{
+					pHarness.reset(); // Make sure the old one is released before creating the new one
+					pHarness.reset( new tools::KernelHarness( device, specs[specIndex], recordTiming, pProgramCache, pTimings, pBufferPool ) );
+				}
+				std::cout << "Running '" << pHarness->kernelName() << "' from " << specs[specIndex].filename << " on device " << deviceInformationString(device) << std::endl;
+				pHarness->run( pTimings );
+				pHarness->matchesReference( &std::cout );
+			}
+		}
+	}
+}
+
+/** @brief Runs every program timesToRepeat times on each device, first synchronously (blocking write, kernel,
+ * finish and read for each, then verifying) and then all submitted at once with tools::AsyncSubmitter, and
+ * prints the throughput of each.
+ */
+void executeAsync( const std::vector<cl::Device>& devices, const std::vector<size_t>& devicesToUse, const std::vector<tools::DeviceSession::ProgramSource>& programSources,
+		const InputVector& data, OutputVector& results, const tools::ResultVerifier& verifier, int timesToRepeat, size_t numberOfSlots,
+		const tools::DeviceSession::Settings& baseSettings, std::map<size_t,tools::PhaseTimings>& deviceTimings )
+{
+	if( timesToRepeat<=0 )
+	{
+		std::cerr << " Error! Asynchronous submission needs a finite number of repeats, using 1" << std::endl;
+		timesToRepeat=1;
+	}
+	const size_t repetitions=static_cast<size_t>(timesToRepeat);
+	const size_t dataBytes=(sizeof(T_input)+sizeof(T_output))*data.size();
+
+	for( const auto deviceNumber : devicesToUse )
+	{
+		const auto& device=devices[deviceNumber];
+		std::cout << "Asynchronous submission on device " << deviceInformationString(device) << std::endl;
+
+		tools::DeviceSession::Settings sessionSettings=baseSettings;
+		if( baseSettings.enableProfiling ) sessionSettings.pTimings=&deviceTimings[deviceNumber];
+		sessionSettings.transferStrategy=tools::DeviceSession::CopyTransfer; // The asynchronous path only uses plain copies
+		tools::DeviceSession session( device, programSources, data.size(), sizeof(T_input), sessionSettings );
+		const size_t submissions=repetitions*session.programs().size();
+
+		// Warm up so that neither path pays for first use
+		runProgram( session, 0, true, data.data(), results.data(), nullptr );
+
+		// The same work as AsyncSubmitter::run, i.e. an untimed reset of the output, then the input uploaded once and every output read back
+		session.fillOutput();
+		tools::StopWatch synchronousClock;
+		size_t synchronousMismatches=0;
+		for( size_t repetition=0; repetition<repetitions; ++repetition )
+		{
+			for( size_t programIndex=0; programIndex<session.programs().size(); ++programIndex )
+			{
+				runProgram( session, programIndex, repetition==0 && programIndex==0, data.data(), results.data(), nullptr );
+				synchronousMismatches+=verifyResults( data, results, verifier, nullptr ).mismatches;
+			}
+		}
+		const double synchronousTime=synchronousClock.elapsed();
+
+		tools::AsyncSubmitter submitter( session, numberOfSlots );
+		const tools::AsyncSubmitter::Result asynchronous=submitter.run( data.data(), repetitions, [&]( size_t /*programIndex*/, const void* pOutput )
+			{
+				return verifyResults( data, static_cast<const T_output*>(pOutput), data.size(), verifier, nullptr ).mismatches;
+			} );
+
+		std::cout << "   " << submissions << " submissions of " << data.size() << " elements, verified on " << verifier.numberOfThreads() << " host threads" << std::endl;
+		std::cout << "   synchronous:  " << synchronousTime*1e3 << " ms (" << submissions*data.size()/synchronousTime/1e6 << " Melements/s), "
+				<< synchronousMismatches << " mismatches" << std::endl;
+		std::cout << "   asynchronous: " << asynchronous.wallTime*1e3 << " ms (" << submissions*data.size()/asynchronous.wallTime/1e6 << " Melements/s), "
+				<< asynchronous.mismatches << " mismatches, " << (asynchronous.outOfOrder ? "out-of-order" : "in-order (out-of-order not supported)") << " queue, "
+				<< submitter.numberOfSlots() << " slots, " << asynchronous.verifyTime*1e3 << " ms verifying" << std::endl;
+		std::cout << "   asynchronous is " << synchronousTime/asynchronous.wallTime << "x the throughput of synchronous" << std::endl;
+
+		if( baseSettings.enableProfiling )
+		{
+			deviceTimings[deviceNumber].phase( "synchronous all programs", dataBytes*submissions, data.size()*submissions ).addSample( synchronousTime );
+			deviceTimings[deviceNumber].phase( "asynchronous all programs", dataBytes*submissions, data.size()*submissions ).addSample( asynchronous.wallTime );
+		}
+	}
+}
+
+/** @brief Runs each program on each device at every size in the sweep, and prints the throughput against size.
+ *
+ * At each size the host baseline is measured, then each device gets a fresh session, one untimed warm up
+ * run and timesToRepeat timed runs (at least one). The median wall clock time, which includes transfers,
+ * is used for both. Every timed run is also added to pReport, if it isn't null.
+ */
+void executeSweep( const std::vector<cl::Device>& devices, const std::vector<size_t>& devicesToUse, const std::vector<tools::DeviceSession::ProgramSource>& programSources,
+		const tools::SizeSweep& sweep, const tools::ResultVerifier& verifier, int timesToRepeat, const tools::DeviceSession::Settings& baseSettings, tools::ResultsReport* pReport )
+{
+	const size_t timedRuns=( timesToRepeat>0 ? timesToRepeat : 1 );
+	// Keyed by device number and program index
+	std::map<std::pair<size_t,size_t>,std::vector<tools::SweepPoint> > curves;
+
+	for( const auto size : sweep.sizes() )
+	{
+		const size_t elementCount=static_cast<size_t>(size);
+		InputVector data(elementCount);
+		OutputVector results(elementCount);
+		for( size_t index=0; index<elementCount; ++index ) data[index]=rand();
+
+		const HostBaseline hostBaseline=measureHostBaseline( data, verifier.numberOfThreads() );
+		std::cout << "Sweeping " << tools::formatSize(size) << " elements, host takes " << hostBaseline.time*1e3 << " ms" << std::endl;
+		if( pReport ) pReport->addValue( "host", "", "sweep host "+std::to_string(hostBaseline.threads)+" threads", "s", false, hostBaseline.time, size, (sizeof(T_input)+sizeof(T_output))*size );
+
+		tools::DeviceSession::Settings settings=baseSettings;
+		settings.pHostInput=data.data();
+		settings.pHostOutput=results.data();
+		for( const auto deviceNumber : devicesToUse )
+		{
+			const auto& device=devices[deviceNumber];
+			std::vector<tools::SweepPoint> points( programSources.size(), tools::SweepPoint{ size, -1, hostBaseline.time } );
+			if( sizeof(T_input)*size>device.getInfo<CL_DEVICE_MAX_MEM_ALLOC_SIZE>() )
+			{
+				std::cout << "   Skipping device " << deviceNumber << ", larger than CL_DEVICE_MAX_MEM_ALLOC_SIZE" << std::endl;
+			}
+			else
+			{
+				tools::DeviceSession session( device, programSources, elementCount, sizeof(T_input), settings );
+				for( size_t programIndex=0; programIndex<session.programs().size(); ++programIndex )
+				{
+					runProgram( session, programIndex, true, data.data(), results.data(), nullptr ); // Warm up
+					tools::TimingStatistics statistics;
+					for( size_t run=0; run<timedRuns; ++run )
+					{
+						session.fillOutput();
+						tools::StopWatch wallClock;
+						runProgram( session, programIndex, true, data.data(), results.data(), nullptr );
+						statistics.addSample( wallClock.elapsed() );
+					}
+					points[programIndex].deviceTime=statistics.median();
+					if( pReport )
+					{
+						pReport->addSamples( deviceInformationString(device), device.getInfo<CL_DRIVER_VERSION>(), "sweep "+programSources[programIndex].name, "s", false,
+								statistics.samples(), size, (sizeof(T_input)+sizeof(T_output))*size );
+					}
+
+					tools::VerificationResult verification=verifyResults( data, results, verifier, nullptr );
+					if( verification.mismatches!=0 ) tools::printVerification( verification, verifier.tolerance(), std::cout );
+				}
+			}
+			for( size_t programIndex=0; programIndex<points.size(); ++programIndex ) curves[std::make_pair(deviceNumber,programIndex)].push_back( points[programIndex] );
+		}
+	}
+
+	for( const auto& curvePair : curves )
+	{
+		std::cout << "Throughput of '" << programSources[curvePair.first.second].name << "' against size on device " << curvePair.first.first << ": "
+				<< deviceInformationString(devices[curvePair.first.first]) << " (wall clock, including transfers)" << std::endl;
+		tools::printSweep( curvePair.second, verifier.numberOfThreads(), std::cout );
+	}
+}
+
+/** @brief Builds each program on each device with every profile, both as it is and specialised with the element count and
+ * work group size baked in, then times the kernel and checks the results of each build.
+ *
+ * Programs from binaries are not specialised, since "-D" has no effect on them. The program cache is not used, so
+ * that the build times are real. Each variant gets one untimed warm up and timesToRepeat timed runs (at least five),
+ * and the median device time is compared. Every variant is added to pReport if it isn't null.
+ */
+void executeBuildVariants( const std::vector<cl::Device>& devices, const std::vector<size_t>& devicesToUse, const std::vector<tools::DeviceSession::ProgramSource>& programSources,
+		const InputVector& data, OutputVector& results, const tools::ResultVerifier& verifier, int timesToRepeat, const std::vector<tools::BuildProfile>& profiles,
+		const tools::DeviceSession::Settings& baseSettings, tools::ResultsReport* pReport )
+{
+	const size_t timedRuns=( timesToRepeat>5 ? timesToRepeat : 5 );
+	const size_t dataBytes=(sizeof(T_input)+sizeof(T_output))*data.size();
+
+	for( const auto deviceNumber : devicesToUse )
+	{
+		const auto& device=devices[deviceNumber];
+
+		for( const auto& programSource : programSources )
+		{
+			std::cout << "Build variants of '" << programSource.name << "' on device " << deviceInformationString(device) << std::endl;
+			std::vector<tools::BuildVariantResult> variantResults;
+			size_t defaultWorkGroupSize=0; // From the first, unspecialised, default build
+			for( const auto& profile : profiles )
+			{
+				for( const bool specialised : { false, true } )
+				{
+					if( specialised && !programSource.binary.empty() ) continue;
+					tools::BuildVariantResult variant{ profile.name, specialised, profile.options, -1, -1, 0, "" };
+					if( specialised ) variant.options+=( variant.options.empty() ? "" : " " )+tools::specialisationOptions( data.size(), defaultWorkGroupSize );
+
+					tools::DeviceSession::ProgramSource variantSource=programSource;
+					if( !variant.options.empty() ) variantSource.buildOptions+=" "+variant.options;
+					tools::PhaseTimings buildTimings;
+					tools::DeviceSession::Settings settings=baseSettings;
+					settings.enableProfiling=true;
+					settings.pTimings=&buildTimings;
+					settings.pProgramCache=nullptr;
+					try
+					{
+						tools::DeviceSession session( device, std::vector<tools::DeviceSession::ProgramSource>( 1, variantSource ), data.size(), sizeof(T_input), settings );
+						variant.buildTime=buildTimings.phase( "build "+programSource.name ).median();
+						const tools::DeviceSession::Program& program=session.programs().front();
+						if( variantResults.empty() ) defaultWorkGroupSize=program.workGroupSize;
+
+						session.writeInput( data.data() );
+						session.fillOutput();
+						tools::TimingStatistics kernelTimes;
+						for( size_t run=0; run<=timedRuns; ++run )
+						{
+							cl::Event kernelEvent;
+							cl_int error=tools::trace::enqueueNDRangeKernel( session.queue(), program.kernel, 0,
+									tools::DeviceSession::globalRange( tools::DeviceSession::workItemCount( program, data.size() ), program.workGroupSize ),
+									tools::DeviceSession::localRange( program.workGroupSize ), nullptr, &kernelEvent );
+							if( error!=CL_SUCCESS ) throw std::runtime_error( "Error when enqueing kernel - "+tools::enqueKernelError(error) );
+							kernelEvent.wait();
+							if( run!=0 ) kernelTimes.addSample( tools::eventDuration(kernelEvent) ); // The first is a warm up
+						}
+						variant.kernelTime=kernelTimes.median();
+						session.readOutput( results.data() );
+						variant.mismatches=verifyResults( data, results, verifier, nullptr ).mismatches;
+
+						if( pReport )
+						{
+							const std::string name="build variant "+programSource.name+" "+profile.name+( specialised ? " specialised" : "" );
+							pReport->addSamples( deviceInformationString(device), device.getInfo<CL_DRIVER_VERSION>(), name, "s", false, kernelTimes.samples(), data.size(), dataBytes );
+							pReport->addValue( deviceInformationString(device), device.getInfo<CL_DRIVER_VERSION>(), name+" build", "s", false, variant.buildTime );
+						}
+					}
+					catch( std::exception& error )
+					{
+						// Build logs can be long, so only keep the first line
+						const std::string message=error.what();
+						variant.failure=message.substr( 0, message.find('\n') );
+					}
+					variantResults.push_back( variant );
+				}
+			}
+			tools::printBuildVariants( variantResults, std::cout );
+		}
+	}
+}
+
+/** @brief Fills data with random values that stay finite after being squared "stages" times.
+ *
+ * The values are in [1/limit, limit), where limit is 2 for up to six stages and closer to 1 after that,
+ * so that the largest result is below 2^64.
+ */
+void fillChainInput( InputVector& data, size_t stages )
+{
+	const double limit=std::pow( 2.0, std::min( 1.0, 64.0/std::pow( 2.0, static_cast<double>(stages) ) ) );
+	for( size_t index=0; index<data.size(); ++index )
+	{
+		data[index]=static_cast<T_input>( 1.0/limit+(limit-1.0/limit)*( rand()/(RAND_MAX+1.0) ) );
+	}
+}
+
+/** @brief Runs the programs as one chain on each device with tools::KernelChain, and compares it with running them one
+ * after the other with the data going back to the host in between.
+ *
+ * Each program is taken to square its input, so the result of stage n is the data squared n times. Only the last
+ * stage and those in readBackStages (numbered from 1) are read back and verified, as is the result of the round trips.
+ * Each gets one untimed warm up and timesToRepeat timed runs (at least one). The data should be from fillChainInput.
+ */
+void executeChain( const std::vector<cl::Device>& devices, const std::vector<size_t>& devicesToUse, const std::vector<tools::DeviceSession::ProgramSource>& programSources,
+		const InputVector& data, OutputVector& results, const tools::ResultVerifier& verifier, int timesToRepeat, const std::vector<size_t>& readBackStages,
+		const tools::DeviceSession::Settings& baseSettings, std::map<size_t,tools::PhaseTimings>& deviceTimings )
+{
+	const size_t timedRuns=( timesToRepeat>0 ? timesToRepeat : 1 );
+	const size_t dataBytes=(sizeof(T_input)+sizeof(T_output))*data.size();
+
+	for( const auto deviceNumber : devicesToUse )
+	{
+		const auto& device=devices[deviceNumber];
+
+		tools::DeviceSession::Settings sessionSettings=baseSettings;
+		if( baseSettings.enableProfiling ) sessionSettings.pTimings=&deviceTimings[deviceNumber];
+		sessionSettings.transferStrategy=tools::DeviceSession::CopyTransfer; // The chain only uses plain copies
+		tools::DeviceSession session( device, programSources, data.size(), sizeof(T_input), sessionSettings );
+		tools::KernelChain chain( session );
+		const size_t stages=chain.numberOfStages();
+		std::cout << "Chain of " << stages << " stages on device " << deviceInformationString(device) << std::endl;
+
+		std::vector<OutputVector> intermediates;
+		std::vector<void*> intermediateOutputs( stages, nullptr );
+		for( const auto stage : readBackStages )
+		{
+			if( stage==0 || stage>=stages ) continue; // The last stage is always read back
+			if( intermediateOutputs[stage-1]!=nullptr ) continue;
+			intermediates.push_back( OutputVector(data.size()) );
+			intermediateOutputs[stage-1]=intermediates.back().data();
+		}
+
+		chain.run( data.data(), results.data(), intermediateOutputs ); // Warm up
+		tools::TimingStatistics chainWallTimes, chainDeviceTimes;
+		std::vector<tools::TimingStatistics> stageTimes( stages );
+		for( size_t run=0; run<timedRuns; ++run )
+		{
+			const tools::KernelChain::Result result=chain.run( data.data(), results.data(), intermediateOutputs );
+			chainWallTimes.addSample( result.wallTime );
+			chainDeviceTimes.addSample( result.chainTime );
+			for( size_t stage=0; stage<stages; ++stage ) stageTimes[stage].addSample( result.stageTimes[stage] );
+		}
+
+		// The same programs with every intermediate result going to the host and back
+		OutputVector roundTrip( data.size() );
+		tools::TimingStatistics roundTripTimes;
+		for( size_t run=0; run<=timedRuns; ++run )
+		{
+			session.fillOutput();
+			tools::StopWatch wallClock;
+			for( size_t stage=0; stage<stages; ++stage ) runProgram( session, stage, true, stage==0 ? data.data() : roundTrip.data(), roundTrip.data(), nullptr );
+			if( run!=0 ) roundTripTimes.addSample( wallClock.elapsed() ); // The first is a warm up
+		}
+
+		std::cout << "   end to end " << chainWallTimes.median()*1e3 << " ms (wall clock, including the upload and read back), "
+				<< chainDeviceTimes.median()*1e3 << " ms on the device from the first kernel to the last" << std::endl;
+		for( size_t stage=0; stage<stages; ++stage )
+		{
+			std::cout << "      stage " << stage+1 << " '" << session.programs()[stage].name << "' " << stageTimes[stage].median()*1e3 << " ms" << std::endl;
+		}
+		std::cout << "   with host round trips between stages " << roundTripTimes.median()*1e3 << " ms, so the chain is "
+				<< roundTripTimes.median()/chainWallTimes.median() << "x faster" << std::endl;
+
+		tools::VerificationResult verification=verifyResults( data, results.data(), results.size(), verifier, nullptr, stages );
+		std::cout << "   last stage:" << std::endl;
+		tools::printVerification( verification, verifier.tolerance(), std::cout, "      " );
+		verification=verifyResults( data, roundTrip.data(), roundTrip.size(), verifier, nullptr, stages );
+		std::cout << "   last stage with host round trips:" << std::endl;
+		tools::printVerification( verification, verifier.tolerance(), std::cout, "      " );
+		for( size_t stage=0; stage+1<stages; ++stage )
+		{
+			if( intermediateOutputs[stage]==nullptr ) continue;
+			verification=verifyResults( data, static_cast<const T_output*>(intermediateOutputs[stage]), data.size(), verifier, nullptr, stage+1 );
+			std::cout << "   stage " << stage+1 << ":" << std::endl;
+			tools::printVerification( verification, verifier.tolerance(), std::cout, "      " );
+		}
+
+		if( baseSettings.enableProfiling )
+		{
+			for( const double time : chainWallTimes.samples() ) deviceTimings[deviceNumber].phase( "chain end to end", dataBytes, data.size() ).addSample( time );
+			for( const double time : roundTripTimes.samples() ) deviceTimings[deviceNumber].phase( "chain with host round trips", dataBytes, data.size() ).addSample( time );
+		}
+	}
+}
+
+/** @brief Runs all of the programs on every one of "units" at the same time, with one thread, context and queue each.
+ *
+ * Each unit gets a share of the data in proportion to its compute units. The sessions are created before anything
+ * is timed. There is one untimed warm up and then timedRuns runs, whose wall clock times are added to wallTimes.
+ * "results" is filled with NaN first, so that anything no unit writes counts as a mismatch.
+ * @throw std::runtime_error     If a session can't be created or a program can't be run.
+ */
+tools::PartitionResult runOnDevices( const std::vector<cl::Device>& units, const std::string& schemeName, const std::vector<tools::DeviceSession::ProgramSource>& programSources,
+		const InputVector& data, OutputVector& results, const tools::ResultVerifier& verifier, size_t timedRuns, const tools::DeviceSession::Settings& baseSettings,
+		tools::TimingStatistics& wallTimes )
+{
+	tools::PartitionResult result{ schemeName, std::vector<cl_uint>(), -1, 0, 0, "" };
+	std::vector<double> weights;
+	for( const auto& unit : units )
+	{
+		result.computeUnits.push_back( unit.getInfo<CL_DEVICE_MAX_COMPUTE_UNITS>() );
+		weights.push_back( result.computeUnits.back() );
+	}
+	const std::vector<size_t> shares=partitionByWeight( data.size(), weights );
+	std::vector<size_t> offsets( shares.size(), 0 );
+	for( size_t index=1; index<shares.size(); ++index ) offsets[index]=offsets[index-1]+shares[index-1];
+
+	// Every scheme shares "results", so clear what the previous one left there
+	std::fill( results.begin(), results.end(), std::numeric_limits<T_output>::quiet_NaN() );
+
+	std::vector<std::unique_ptr<tools::DeviceSession> > sessions( units.size() );
+	for( size_t index=0; index<units.size(); ++index )
+	{
+		if( shares[index]==0 ) continue;
+		tools::DeviceSession::Settings settings=baseSettings;
+		settings.pTimings=nullptr;
+		settings.pBufferPool=nullptr; // The pool would share one context per device, and keep it after the sub-device is released
+		settings.pHostInput=&data[offsets[index]];
+		settings.pHostOutput=&results[offsets[index]];
+		sessions[index].reset( new tools::DeviceSession( units[index], programSources, shares[index], sizeof(T_input), settings ) );
+	}
+
+	std::vector<std::exception_ptr> threadErrors( units.size() );
+	for( size_t run=0; run<=timedRuns; ++run )
+	{
+		for( const auto& pSession : sessions ) if( pSession ) pSession->fillOutput();
+		tools::StopWatch wallClock;
+		std::vector<std::thread> threads;
+		for( size_t index=0; index<units.size(); ++index )
+		{
+			if( !sessions[index] ) continue;
+			threads.emplace_back( [&,index]()
+			{
+				try
+				{
+					// The input only needs writing before the first program
+					for( size_t programIndex=0; programIndex<programSources.size(); ++programIndex )
+					{
+						runProgram( *sessions[index], programIndex, programIndex==0, &data[offsets[index]], &results[offsets[index]], nullptr );
+					}
+				}
+				catch( ... ) { threadErrors[index]=std::current_exception(); }
+			} );
+		}
+		for( auto& thread : threads ) thread.join();
+		for( auto& error : threadErrors )
+		{
+			if( error ) std::rethrow_exception( error );
+		}
+		if( run!=0 ) wallTimes.addSample( wallClock.elapsed() ); // The first is a warm up
+	}
+
+	result.time=wallTimes.median();
+	result.elementsPerSecond=data.size()/result.time;
+	result.mismatches=verifyResults( data, results, verifier, nullptr ).mismatches;
+	return result;
+}
+
+/** @brief Splits each device into sub-devices with each scheme, and compares running the programs on all of the
+ * sub-devices at once with running them on the whole device.
+ *
+ * If schemes is empty, every scheme the device supports is tried (see tools::supportedPartitionSchemes). The whole
+ * device is run the same way as the partitions, with its own context and queue, so that only the partitioning
+ * differs. Each gets one untimed warm up and timesToRepeat timed runs (at least five) of all the programs, and the
+ * median wall clock time is compared. Every scheme is added to pReport if it isn't null.
+ */
+void executeSubDevices( const std::vector<cl::Device>& devices, const std::vector<size_t>& devicesToUse, const std::vector<tools::DeviceSession::ProgramSource>& programSources,
+		const InputVector& data, OutputVector& results, const tools::ResultVerifier& verifier, int timesToRepeat, const std::vector<tools::PartitionScheme>& schemes,
+		const tools::DeviceSession::Settings& baseSettings, tools::ResultsReport* pReport )
+{
+	const size_t timedRuns=( timesToRepeat>5 ? timesToRepeat : 5 );
+	const size_t dataBytes=(sizeof(T_input)+sizeof(T_output))*data.size();
+
+	for( const auto deviceNumber : devicesToUse )
+	{
+		const auto& device=devices[deviceNumber];
+		std::cout << "Sub-device partitions of device " << deviceInformationString(device) << std::endl;
+		const std::vector<tools::PartitionScheme> deviceSchemes=( schemes.empty() ? tools::supportedPartitionSchemes(device) : schemes );
+		if( deviceSchemes.empty() )
+		{
+			std::cout << "   The device can't be partitioned" << std::endl;
+			continue;
+		}
+
+		std::vector<tools::PartitionResult> partitionResults;
+		for( size_t schemeIndex=0; schemeIndex<=deviceSchemes.size(); ++schemeIndex )
+		{
+			// The whole device first, for the partitions to be compared with
+			const std::string schemeName=( schemeIndex==0 ? "whole device" : deviceSchemes[schemeIndex-1].name );
+			try
+			{
+				const std::vector<cl::Device> units=( schemeIndex==0 ? std::vector<cl::Device>( 1, device ) : tools::createSubDevices( device, deviceSchemes[schemeIndex-1] ) );
+				tools::TimingStatistics wallTimes;
+				partitionResults.push_back( runOnDevices( units, schemeName, programSources, data, results, verifier, timedRuns, baseSettings, wallTimes ) );
+				if( pReport ) pReport->addSamples( deviceInformationString(device), device.getInfo<CL_DRIVER_VERSION>(), "partition "+schemeName, "s", false, wallTimes.samples(), data.size(), dataBytes );
+			}
+			catch( std::exception& error )
+			{
+				// Build logs can be long, so only keep the first line
+				const std::string message=error.what();
+				partitionResults.push_back( tools::PartitionResult{ schemeName, std::vector<cl_uint>(), -1, 0, 0, message.substr( 0, message.find('\n') ) } );
+			}
+		}
+		tools::printPartitions( partitionResults, std::cout );
+	}
+}
+
+void addBandwidthToReport( const cl::Device& device, const std::vector<tools::BandwidthResult>& bandwidths, tools::ResultsReport& report )
+{
+	const std::string deviceName=deviceInformationString(device);
+	const std::string driver=device.getInfo<CL_DRIVER_VERSION>();
+	for( const auto& result : bandwidths )
+	{
+		report.addValue( deviceName, driver, "bandwidth write blocking", "GB/s", true, result.writeBlocking, 0, result.bytes );
+		report.addValue( deviceName, driver, "bandwidth write non-blocking", "GB/s", true, result.writeNonBlocking, 0, result.bytes );
+		report.addValue( deviceName, driver, "bandwidth read blocking", "GB/s", true, result.readBlocking, 0, result.bytes );
+		report.addValue( deviceName, driver, "bandwidth read non-blocking", "GB/s", true, result.readNonBlocking, 0, result.bytes );
+		report.addValue( deviceName, driver, "bandwidth copy blocking", "GB/s", true, result.copyBlocking, 0, result.bytes );
+		report.addValue( deviceName, driver, "bandwidth copy non-blocking", "GB/s", true, result.copyNonBlocking, 0, result.bytes );
+		report.addValue( deviceName, driver, "bandwidth map blocking", "GB/s", true, result.mapBlocking, 0, result.bytes );
+		report.addValue( deviceName, driver, "bandwidth map non-blocking", "GB/s", true, result.mapNonBlocking, 0, result.bytes );
+	}
+}
+
+void addComputeToReport( const cl::Device& device, const std::vector<tools::ComputeResult>& computeResults, tools::ResultsReport& report )
+{
+	const std::string deviceName=deviceInformationString(device);
+	const std::string driver=device.getInfo<CL_DRIVER_VERSION>();
+	for( const auto& result : computeResults )
+	{
+		if( result.gigaOpsPerSecond<0 ) continue; // Couldn't be run
+		const std::string typeName=result.type+( result.vectorWidth>1 ? std::to_string(result.vectorWidth) : "" );
+		report.addValue( deviceName, driver, "compute "+typeName+" "+std::to_string(result.chains)+" chains", "GOPS", true, result.gigaOpsPerSecond );
+	}
+}
+
+void addSubmissionToReport( const cl::Device& device, const std::vector<tools::SubmissionResult>& submissionResults, tools::ResultsReport& report )
+{
+	const std::string deviceName=deviceInformationString(device);
+	const std::string driver=device.getInfo<CL_DRIVER_VERSION>();
+	for( const auto& result : submissionResults )
+	{
+		const std::string name="submission "+std::to_string(result.threads)+" threads "+( result.sharedQueue ? "shared queue" : "own queues" );
+		report.addValue( deviceName, driver, name, "submissions/s", true, result.submissionsPerSecond );
+		report.addValue( deviceName, driver, name+" enqueue p99", "s", false, result.p99Enqueue );
+	}
+}
+
+/** @brief Writes the report to each file that has a name. @throw std::runtime_error if a file can't be written. */
+void writeReport( const tools::ResultsReport& report, const std::string& jsonFilename, const std::string& csvFilename )
+{
+	if( !jsonFilename.empty() )
+	{
+		std::ofstream jsonFile( jsonFilename );
+		if( !jsonFile.is_open() ) throw std::runtime_error( "Unable to open '"+jsonFilename+"' to write results" );
+		report.writeJson( jsonFile );
+		std::cout << "Wrote " << report.measurements().size() << " measurements to '" << jsonFilename << "'" << std::endl;
+	}
+	if( !csvFilename.empty() )
+	{
+		std::ofstream csvFile( csvFilename );
+		if( !csvFile.is_open() ) throw std::runtime_error( "Unable to open '"+csvFilename+"' to write results" );
+		report.writeCsv( csvFile );
+		std::cout << "Wrote " << report.measurements().size() << " measurements to '" << csvFilename << "'" << std::endl;
+	}
+}
+
+/** @brief Prints each regression and returns how many there were. */
+size_t printRegressions( const std::vector<tools::ResultsReport::Regression>& regressions, const std::string& baselineFilename, double threshold, std::ostream& output=std::cout )
+{
+	if( regressions.empty() )
+	{
+		output << "No regressions of more than " << threshold*100 << "% against '" << baselineFilename << "'" << std::endl;
+		return 0;
+	}
+	output << regressions.size() << " regression(s) of more than " << threshold*100 << "% against '" << baselineFilename << "':" << std::endl;
+	for( const auto& regression : regressions )
+	{
+		output << "   " << regression.device << ": " << regression.name;
+		if( regression.elements!=0 ) output << " (" << tools::formatSize(regression.elements) << " elements)";
+		output << " " << regression.baselineMedian << " -> " << regression.currentMedian << " " << regression.unit
+				<< " (" << regression.change*100 << "% worse)" << std::endl;
+	}
+	return regressions.size();
+}
+
 void printUsage( const std::string& executableName, std::ostream& output=std::cout )
 {
 	output << "Usage:" << "\n"
-			<< "\t" << executableName << " [--print] [--execute] [--spir <filename>] [--device <number>] [--repeat <number>]" << "\n"
+			<< "\t" << executableName << " [--print] [--bandwidth] [--compute] [--submission[=<threads>]] [--shared-queue] [--execute] [--spir <filename>] [--device <number>|best] [--device-profile <profile>] [--device-scores <filename>] [--repeat <number>] [--datasize <number>] [--timing] [--cold] [--pool-limit <size>] [--cache <directory>] [--split[=compute|calibrate]] [--transfer <strategy>] [--stream <chunksize>] [--stream-buffers <number>] [--async[=<slots>]] [--build-variants[=<profiles>]] [--chain[=<stage>,...]] [--subdevices[=<scheme>,...]] [--autotune] [--tune-file <filename>] [--vector-width <number>] [--grid-stride] [--spec <filename>] [--tolerance <tolerance>] [--device-verify[=expression|reference]] [--host-threads <number>] [--sweep <first>:<last>:x<factor>] [--json <filename>] [--csv <filename>] [--compare <filename>] [--threshold <percent>] [--trace <filename>]" << "\n"
 			<< "\t\t" << "--print     Print information on available OpenCL devices (default if no other action specified)." << "\n"
+			<< "\t\t" << "--bandwidth Measure read, write, copy and map/unmap throughput on the selected device(s), blocking and non-blocking," << "\n"
+			<< "\t\t" << "            for transfer sizes from 4 KiB up to the device's max allocation (at most 1 GiB)." << "\n"
+			<< "\t\t" << "--compute   Measure peak multiply-add throughput on the selected device(s) for float, int, double and half" << "\n"
+			<< "\t\t" << "            (where supported), vector widths 1 to 16, with dependent and independent chains." << "\n"
+			<< "\t\t" << "--submission  Measure kernel submissions per second and enqueue latency on the selected device(s) with 1, 2, 4..." << "\n"
+			<< "\t\t" << "            host threads submitting at once, up to the number given (default the number of hardware threads)." << "\n"
+			<< "\t\t" << "--shared-queue  Have every thread of '--submission' use the same queue, instead of one queue each." << "\n"
 			<< "\t\t" << "--execute   Execute a test kernel on the selected device(s)." << "\n"
 			<< "\t\t" << "--spir      Execute the supplied spir binary on the selected device(s)." << "\n"
 			<< "\t\t" << "--device    The device to run on (integer matching output from '--print'). Can be specified multiple times. Default is all devices." << "\n"
+			<< "\t\t" << "            'best' chooses the device with the highest predicted throughput from short bandwidth and compute benchmarks." << "\n"
+			<< "\t\t" << "--device-profile  The workload to rank devices for with '--device best': 'transfer' (default, includes host" << "\n"
+			<< "\t\t" << "            transfers), 'memory', 'compute' or <operations per byte>[:transfer]." << "\n"
+			<< "\t\t" << "--device-scores   File to cache the benchmark scores in, per device and driver. Default '" << tools::DeviceScoreTable::defaultFilename() << "'." << "\n"
 			<< "\t\t" << "--repeat    Number of times to repeat execution (to try and check for race conditions). Negative numbers will repeat forever until ctrl-c." << "\n"
-			<< "\t\t" << "--datasize  The size of the test dataset to run on. Default 4096." << "\n"
+			<< "\t\t" << "--datasize  The size of the test dataset to run on. Suffixes K, M and G (powers of 1024) are allowed. Default 4096." << "\n"
+			<< "\t\t" << "--timing    Profile each phase (context creation, build, write, kernel, read) and print min/median/p99/max" << "\n"
+			<< "\t\t" << "            over all repetitions once finished. Not printed if repeating forever." << "\n"
+			<< "\t\t" << "--cold      Recreate the context, queue, buffers and programs on every repetition, instead of once per device." << "\n"
+			<< "\t\t" << "            Also stops buffers being reused from the buffer pool." << "\n"
+			<< "\t\t" << "--pool-limit  Most bytes of free device buffers to keep for reuse, e.g. '256M'. Default 1G." << "\n"
+			<< "\t\t" << "--cache     Directory to store built program binaries in, so that later runs can skip compilation." << "\n"
+			<< "\t\t" << "--split     Split the data between all the selected devices and run them concurrently. Shares are proportional" << "\n"
+			<< "\t\t" << "            to compute units x clock speed, or to measured throughput with '--split=calibrate'." << "\n"
+			<< "\t\t" << "--transfer  How to move data to and from the device: 'copy' (default), 'usehostptr', 'allochostptr'," << "\n"
+			<< "\t\t" << "            'mapinvalidate' or 'all'. Can be specified multiple times to compare them. --sweep and --split" << "\n"
+			<< "\t\t" << "            only use the first, the other modes always copy." << "\n"
+			<< "\t\t" << "--stream    Process the data in chunks of this many elements, overlapping upload, kernel and download," << "\n"
+			<< "\t\t" << "            and compare with doing the chunks one after the other. Suffixes K, M and G are allowed." << "\n"
+			<< "\t\t" << "--stream-buffers  Number of chunks in flight at once when streaming. Default 2 (double buffering)." << "\n"
+			<< "\t\t" << "--async     Submit every repetition of every program up front on an out-of-order queue, verifying results" << "\n"
+			<< "\t\t" << "            in event callbacks while the device works, and compare with blocking on each. Optionally the number" << "\n"
+			<< "\t\t" << "            of submissions that can be in flight at once (default 4)." << "\n"
+			<< "\t\t" << "--build-variants  Build each program with every build option profile given (comma separated from default, mad," << "\n"
+			<< "\t\t" << "            no-signed-zeros, finite, unsafe and fast, or all which is the default), both as is and with the" << "\n"
+			<< "\t\t" << "            element count and work group size baked in with -D, and report the fastest that passes verification." << "\n"
+			<< "\t\t" << "--chain     Run the programs as one chain on the device, each squaring the last one's output, with only" << "\n"
+			<< "\t\t" << "            the end result read back, and compare with going through the host between programs. Any" << "\n"
+			<< "\t\t" << "            stages listed (numbered from 1) are read back and verified as well. The input is kept close" << "\n"
+			<< "\t\t" << "            to 1 so that the repeated squaring doesn't overflow." << "\n"
+			<< "\t\t" << "--subdevices  Partition each device into sub-devices and run the programs on all of them at once," << "\n"
+			<< "\t\t" << "            each with its own context and queue, reporting the scaling against the whole device. Schemes" << "\n"
+			<< "\t\t" << "            are comma separated 'equally:<units>', 'counts:<units>+<units>...' or 'affinity:<domain>' (numa," << "\n"
+			<< "\t\t" << "            l4, l3, l2, l1 or next). Default is every scheme the device supports." << "\n"
+			<< "\t\t" << "--autotune  Time each program (or the test kernel if none given) with a range of local work group sizes," << "\n"
+			<< "\t\t" << "            and save the fastest for the device and data size. Saved sizes are always used when running." << "\n"
+			<< "\t\t" << "--tune-file File to save and read tuned work group sizes. Default '" << tools::WorkGroupSizeTable::defaultFilename() << "'." << "\n"
+			<< "\t\t" << "--vector-width  Elements of the test kernel each work item processes as a floatN (1, 2, 4, 8 or 16)." << "\n"
+			<< "\t\t" << "            Default is the device's preferred/native float vector width." << "\n"
+			<< "\t\t" << "--grid-stride  Launch the test kernel with only a few work groups per compute unit, each work item" << "\n"
+			<< "\t\t" << "            looping over the data." << "\n"
+			<< "\t\t" << "--spec      Run the kernel described by a spec file (program, arguments, NDRange and optional reference output)" << "\n"
+			<< "\t\t" << "            on the selected device(s). Can be specified multiple times. See tools/KernelSpec.h for the format." << "\n"
+			<< "\t\t" << "--tolerance How close results must be to count as correct: 'exact' (default), 'abs:<value>', 'rel:<value>'" << "\n"
+			<< "\t\t" << "            or 'ulp:<value>'." << "\n"
+			<< "\t\t" << "--device-verify  Check the results with a reduction kernel on the device, so only the mismatch count," << "\n"
+			<< "\t\t" << "            maximum error and first bad index come back. The results are only read back to find the" << "\n"
+			<< "\t\t" << "            details if something is wrong. The expected values are calculated on the device from the input" << "\n"
+			<< "\t\t" << "            ('expression', the default), or uploaded once from the host ('reference'). Can't be used with" << "\n"
+			<< "\t\t" << "            --sweep, --build-variants, --chain, --subdevices, --async, --stream or --split." << "\n"
+			<< "\t\t" << "--host-threads  Number of host threads used to check results and for the host baseline each device's" << "\n"
+			<< "\t\t" << "            speedup is given against. Default is the number of hardware threads." << "\n"
+			<< "\t\t" << "--sweep     Run the programs at a range of data sizes instead of '--datasize', e.g. '1K:1G:x2' or '1M:8M:+1M'." << "\n"
+			<< "\t\t" << "            Prints throughput against size, where the device overtakes the host and where it saturates." << "\n"
+			<< "\t\t" << "--json      Write every measurement (with all samples) to this file as JSON. Turns on '--timing'." << "\n"
+			<< "\t\t" << "--csv       Write a summary of every measurement to this file as CSV. Turns on '--timing'." << "\n"
+			<< "\t\t" << "--compare   Compare with a file written by '--json' and exit with -3 if any measurement of the same" << "\n"
+			<< "\t\t" << "            device, name and size has significantly regressed. Turns on '--timing'." << "\n"
+			<< "\t\t" << "--threshold Percentage a median must be worse by to count as a regression for '--compare'. Default 5." << "\n"
+			<< "\t\t" << "--trace     Record every OpenCL build, allocation, transfer and kernel launch, with host and device times," << "\n"
+			<< "\t\t" << "            and write them to this file for chrome://tracing or ui.perfetto.dev. Turns on '--timing'." << "\n"
 			<< "\t" << executableName << " --help" << "\n"
 			<< "\t" << "\t" << "prints this help message and exits" << "\n"
 			<< std::endl;
@@ -86,22 +1083,92 @@ void printUsage( const std::string& executableName, std::ostream& output=std::co
 int main( int argc, char* argv[] )
 {
 	bool printDeviceInfo=false;
+	bool measureBandwidth=false;
+	bool measureCompute=false;
+	size_t submissionThreads=0; // Zero means the number of hardware threads
+	bool measureSubmission=false;
+	bool sharedSubmissionQueue=false;
 	bool executeKernel=false;
 	std::vector<std::string> executeSpirFiles;
+	std::vector<std::string> specFiles;
 	std::vector<size_t> devicesToUse;
+	bool useBestDevice=false; // "--device best", added to devicesToUse once the devices are ranked
+	std::string deviceProfile="transfer";
+	std::string deviceScoresFilename=tools::DeviceScoreTable::defaultFilename();
 	int timesToRepeat=1;
 	size_t dataSize=4096;
+	bool recordTiming=false;
+	bool coldStart=false;
+	size_t poolLimit=tools::BufferPool::defaultMaxFreeBytes;
+	std::string cacheDirectory;
+	bool splitAcrossDevices=false;
+	std::string splitWeights="compute";
+	std::vector<tools::DeviceSession::TransferStrategy> transferStrategies;
+	size_t streamChunkSize=0; // zero means don't stream
+	size_t streamBufferSets=2;
+	size_t asyncSlots=0; // zero means don't use asynchronous submission
+	std::vector<tools::BuildProfile> buildProfiles; // Empty unless "--build-variants" was given
+	bool chainPrograms=false;
+	std::vector<size_t> chainReadBackStages;
+	bool partitionDevices=false;
+	std::vector<tools::PartitionScheme> partitionSchemes; // Empty means every scheme each device supports
+	bool autotune=false;
+	std::string tuneFilename=tools::WorkGroupSizeTable::defaultFilename();
+	size_t testKernelVectorWidth=tools::DeviceSession::ProgramSource::DeviceVectorWidth;
+	bool gridStride=false;
+	tools::Tolerance tolerance=tools::Tolerance::fromString( "exact" );
+	bool deviceVerify=false;
+	bool deviceVerifyReference=false; // Compare with uploaded expected values rather than calculating them on the device
+	size_t hostThreads=0; // Zero means use all hardware threads
+	std::unique_ptr<tools::SizeSweep> sizeSweep; // Null unless "--sweep" was given
+	std::string jsonFilename;
+	std::string csvFilename;
+	std::string baselineFilename; // Results to compare against for "--compare"
+	double regressionThreshold=0.05;
+	std::string traceFilename;
 
 	tools::CommandLineParser commandLineParser;
 	try
 	{
 		commandLineParser.addOption( "help", tools::CommandLineParser::NoArgument );
 		commandLineParser.addOption( "print", tools::CommandLineParser::NoArgument );
+		commandLineParser.addOption( "bandwidth", tools::CommandLineParser::NoArgument );
+		commandLineParser.addOption( "compute", tools::CommandLineParser::NoArgument );
 		commandLineParser.addOption( "execute", tools::CommandLineParser::NoArgument );
 		commandLineParser.addOption( "spir", tools::CommandLineParser::RequiredArgument );
+		commandLineParser.addOption( "spec", tools::CommandLineParser::RequiredArgument );
 		commandLineParser.addOption( "device", tools::CommandLineParser::RequiredArgument );
+		commandLineParser.addOption( "device-profile", tools::CommandLineParser::RequiredArgument );
+		commandLineParser.addOption( "device-scores", tools::CommandLineParser::RequiredArgument );
 		commandLineParser.addOption( "repeat", tools::CommandLineParser::RequiredArgument );
 		commandLineParser.addOption( "datasize", tools::CommandLineParser::RequiredArgument );
+		commandLineParser.addOption( "timing", tools::CommandLineParser::NoArgument );
+		commandLineParser.addOption( "cold", tools::CommandLineParser::NoArgument );
+		commandLineParser.addOption( "pool-limit", tools::CommandLineParser::RequiredArgument );
+		commandLineParser.addOption( "cache", tools::CommandLineParser::RequiredArgument );
+		commandLineParser.addOption( "split", tools::CommandLineParser::OptionalArgument );
+		commandLineParser.addOption( "transfer", tools::CommandLineParser::RequiredArgument );
+		commandLineParser.addOption( "stream", tools::CommandLineParser::RequiredArgument );
+		commandLineParser.addOption( "stream-buffers", tools::CommandLineParser::RequiredArgument );
+		commandLineParser.addOption( "async", tools::CommandLineParser::OptionalArgument );
+		commandLineParser.addOption( "build-variants", tools::CommandLineParser::OptionalArgument );
+		commandLineParser.addOption( "chain", tools::CommandLineParser::OptionalArgument );
+		commandLineParser.addOption( "subdevices", tools::CommandLineParser::OptionalArgument );
+		commandLineParser.addOption( "autotune", tools::CommandLineParser::NoArgument );
+		commandLineParser.addOption( "tune-file", tools::CommandLineParser::RequiredArgument );
+		commandLineParser.addOption( "vector-width", tools::CommandLineParser::RequiredArgument );
+		commandLineParser.addOption( "grid-stride", tools::CommandLineParser::NoArgument );
+		commandLineParser.addOption( "tolerance", tools::CommandLineParser::RequiredArgument );
+		commandLineParser.addOption( "device-verify", tools::CommandLineParser::OptionalArgument );
+		commandLineParser.addOption( "host-threads", tools::CommandLineParser::RequiredArgument );
+		commandLineParser.addOption( "sweep", tools::CommandLineParser::RequiredArgument );
+		commandLineParser.addOption( "json", tools::CommandLineParser::RequiredArgument );
+		commandLineParser.addOption( "csv", tools::CommandLineParser::RequiredArgument );
+		commandLineParser.addOption( "compare", tools::CommandLineParser::RequiredArgument );
+		commandLineParser.addOption( "threshold", tools::CommandLineParser::RequiredArgument );
+		commandLineParser.addOption( "trace", tools::CommandLineParser::RequiredArgument );
+		commandLineParser.addOption( "submission", tools::CommandLineParser::OptionalArgument );
+		commandLineParser.addOption( "shared-queue", tools::CommandLineParser::NoArgument );
 		commandLineParser.parse( argc, argv );
 
 		if( commandLineParser.optionHasBeenSet( "help" ) )
@@ -111,20 +1178,200 @@ int main( int argc, char* argv[] )
 		}
 
 		if( commandLineParser.optionHasBeenSet( "print" ) ) printDeviceInfo=true;
+		if( commandLineParser.optionHasBeenSet( "bandwidth" ) ) measureBandwidth=true;
+		if( commandLineParser.optionHasBeenSet( "compute" ) ) measureCompute=true;
+		if( commandLineParser.optionHasBeenSet( "submission" ) )
+		{
+			measureSubmission=true;
+			if( !commandLineParser.optionArguments("submission").empty() )
+			{
+				std::string argument=commandLineParser.optionArguments("submission").back();
+				try
+				{
+					int newNumber=std::stoi( argument );
+					if( newNumber<=0 ) std::cerr << " Error! '" << newNumber << "' must be a non zero positive integer for --submission, using the number of hardware threads" << std::endl;
+					else submissionThreads=static_cast<size_t>(newNumber);
+				}
+				catch( std::exception& error ) { std::cerr << " Error! '" << argument << "' must be a non zero positive integer for --submission, using the number of hardware threads" << std::endl; }
+			}
+		}
+		if( commandLineParser.optionHasBeenSet( "shared-queue" ) ) sharedSubmissionQueue=true;
 		if( commandLineParser.optionHasBeenSet( "execute" ) ) executeKernel=true;
 		if( commandLineParser.optionHasBeenSet( "spir" ) ) executeSpirFiles=commandLineParser.optionArguments("spir");
+		if( commandLineParser.optionHasBeenSet( "spec" ) ) specFiles=commandLineParser.optionArguments("spec");
+		if( commandLineParser.optionHasBeenSet( "timing" ) ) recordTiming=true;
+		if( commandLineParser.optionHasBeenSet( "cold" ) ) coldStart=true;
+		if( commandLineParser.optionHasBeenSet( "pool-limit" ) )
+		{
+			try{ poolLimit=static_cast<size_t>( tools::parseSize( commandLineParser.optionArguments("pool-limit").back() ) ); }
+			catch( std::exception& error ) { std::cerr << " Error! " << error.what() << " for --pool-limit" << std::endl; }
+		}
+		if( commandLineParser.optionHasBeenSet( "cache" ) ) cacheDirectory=commandLineParser.optionArguments("cache").back();
+		if( commandLineParser.optionHasBeenSet( "split" ) )
+		{
+			splitAcrossDevices=true;
+			if( !commandLineParser.optionArguments("split").empty() ) splitWeights=commandLineParser.optionArguments("split").back();
+			if( splitWeights!="compute" && splitWeights!="calibrate" )
+			{
+				std::cerr << " Error! '" << splitWeights << "' is not a valid argument for --split, using 'compute'" << std::endl;
+				splitWeights="compute";
+			}
+		}
+
+		for( const auto& argument : commandLineParser.optionArguments("transfer") )
+		{
+			if( argument=="all" ) transferStrategies=tools::DeviceSession::allTransferStrategies();
+			else
+			{
+				try{ transferStrategies.push_back( tools::DeviceSession::transferStrategyFromName(argument) ); }
+				catch( std::exception& error ) { std::cerr << " Error! " << error.what() << " for --transfer" << std::endl; }
+			}
+		}
+		if( transferStrategies.empty() ) transferStrategies.push_back( tools::DeviceSession::CopyTransfer );
+
+		if( commandLineParser.optionHasBeenSet( "stream" ) )
+		{
+			try{ streamChunkSize=static_cast<size_t>( tools::parseSize( commandLineParser.optionArguments("stream").back() ) ); }
+			catch( std::exception& error ) { std::cerr << " Error! " << error.what() << " for --stream" << std::endl; }
+		}
+
+		if( commandLineParser.optionHasBeenSet( "stream-buffers" ) )
+		{
+			std::string argument=commandLineParser.optionArguments("stream-buffers").back();
+			try
+			{
+				int newNumber=std::stoi( argument );
+				if( newNumber<=0 ) std::cerr << " Error! '" << newNumber << "' must be a non zero positive integer for --stream-buffers" << std::endl;
+				else streamBufferSets=static_cast<size_t>(newNumber);
+			}
+			catch( std::exception& error ) { std::cerr << " Error! '" << argument << "' must be a non zero positive integer for --stream-buffers" << std::endl; }
+		}
+
+		if( commandLineParser.optionHasBeenSet( "async" ) )
+		{
+			asyncSlots=4;
+			if( !commandLineParser.optionArguments("async").empty() )
+			{
+				std::string argument=commandLineParser.optionArguments("async").back();
+				try
+				{
+					int newNumber=std::stoi( argument );
+					if( newNumber<=0 ) std::cerr << " Error! '" << newNumber << "' must be a non zero positive integer for --async, using 4" << std::endl;
+					else asyncSlots=static_cast<size_t>(newNumber);
+				}
+				catch( std::exception& error ) { std::cerr << " Error! '" << argument << "' must be a non zero positive integer for --async, using 4" << std::endl; }
+			}
+		}
+
+		if( commandLineParser.optionHasBeenSet( "build-variants" ) )
+		{
+			std::string argument;
+			if( !commandLineParser.optionArguments("build-variants").empty() ) argument=commandLineParser.optionArguments("build-variants").back();
+			try{ buildProfiles=tools::buildProfilesFromString( argument ); }
+			catch( std::exception& error )
+			{
+				std::cerr << " Error! " << error.what() << " for --build-variants, using all" << std::endl;
+				buildProfiles=tools::defaultBuildProfiles();
+			}
+		}
+
+		if( commandLineParser.optionHasBeenSet( "chain" ) )
+		{
+			chainPrograms=true;
+			for( const auto& argument : commandLineParser.optionArguments("chain") )
+			{
+				std::stringstream stages( argument );
+				std::string stage;
+				while( std::getline( stages, stage, ',' ) )
+				{
+					try
+					{
+						int newNumber=std::stoi( stage );
+						if( newNumber<=0 ) std::cerr << " Error! '" << newNumber << "' must be a stage number from 1 for --chain" << std::endl;
+						else chainReadBackStages.push_back( static_cast<size_t>(newNumber) );
+					}
+					catch( std::exception& error ) { std::cerr << " Error! '" << stage << "' must be a stage number from 1 for --chain" << std::endl; }
+				}
+			}
+		}
+
+		if( commandLineParser.optionHasBeenSet( "subdevices" ) )
+		{
+			partitionDevices=true;
+			std::string argument;
+			if( !commandLineParser.optionArguments("subdevices").empty() ) argument=commandLineParser.optionArguments("subdevices").back();
+			try{ partitionSchemes=tools::partitionSchemesFromString( argument ); }
+			catch( std::exception& error ) { std::cerr << " Error! " << error.what() << " for --subdevices, using every supported scheme" << std::endl; }
+		}
+
+		if( commandLineParser.optionHasBeenSet( "autotune" ) ) autotune=true;
+		if( commandLineParser.optionHasBeenSet( "tune-file" ) ) tuneFilename=commandLineParser.optionArguments("tune-file").back();
+
+		if( commandLineParser.optionHasBeenSet( "vector-width" ) )
+		{
+			std::string argument=commandLineParser.optionArguments("vector-width").back();
+			try
+			{
+				int newWidth=std::stoi( argument );
+				if( newWidth<=0 || !tools::isValidVectorWidth(newWidth) ) std::cerr << " Error! '" << newWidth << "' must be one of 1, 2, 4, 8 or 16 for --vector-width" << std::endl;
+				else testKernelVectorWidth=static_cast<size_t>(newWidth);
+			}
+			catch( std::exception& error ) { std::cerr << " Error! '" << argument << "' must be one of 1, 2, 4, 8 or 16 for --vector-width" << std::endl; }
+		}
+		if( commandLineParser.optionHasBeenSet( "grid-stride" ) ) gridStride=true;
+
+		if( commandLineParser.optionHasBeenSet( "tolerance" ) )
+		{
+			try{ tolerance=tools::Tolerance::fromString( commandLineParser.optionArguments("tolerance").back() ); }
+			catch( std::exception& error ) { std::cerr << " Error! " << error.what() << std::endl; }
+		}
+
+		if( commandLineParser.optionHasBeenSet( "device-verify" ) )
+		{
+			deviceVerify=true;
+			std::string argument="expression";
+			if( !commandLineParser.optionArguments("device-verify").empty() ) argument=commandLineParser.optionArguments("device-verify").back();
+			if( argument=="reference" ) deviceVerifyReference=true;
+			else if( argument!="expression" ) std::cerr << " Error! '" << argument << "' is not a valid argument for --device-verify, using 'expression'" << std::endl;
+		}
+
+		if( commandLineParser.optionHasBeenSet( "host-threads" ) )
+		{
+			std::string argument=commandLineParser.optionArguments("host-threads").back();
+			try
+			{
+				int newNumber=std::stoi( argument );
+				if( newNumber<=0 ) std::cerr << " Error! '" << newNumber << "' must be a non zero positive integer for --host-threads" << std::endl;
+				else hostThreads=static_cast<size_t>(newNumber);
+			}
+			catch( std::exception& error ) { std::cerr << " Error! '" << argument << "' must be a non zero positive integer for --host-threads" << std::endl; }
+		}
+
 		// If none of these are set, then default to "print"
-		if( !printDeviceInfo && !executeKernel && executeSpirFiles.empty() ) printDeviceInfo=true;
+		if( !printDeviceInfo && !measureBandwidth && !measureCompute && !measureSubmission && !executeKernel && executeSpirFiles.empty() && specFiles.empty() && !autotune ) printDeviceInfo=true;
 
 		if( commandLineParser.optionHasBeenSet( "device" ) )
 		{
 			for( const auto& argument : commandLineParser.optionArguments("device") )
 			{
+				if( argument=="best" )
+				{
+					useBestDevice=true;
+					continue;
+				}
 				try{ devicesToUse.push_back( std::stoi(argument) ); }
 				catch( std::exception& error ) { std::cerr << " Error! '" << argument << "' is an invalid device number!" << std::endl; }
 			}
 		}
 
+		if( commandLineParser.optionHasBeenSet( "device-profile" ) )
+		{
+			// Only checked here, the profile itself is created when needed
+			try{ deviceProfile=tools::WorkloadProfile::fromString( commandLineParser.optionArguments("device-profile").back() ).name; }
+			catch( std::exception& error ) { std::cerr << " Error! " << error.what() << ", using '" << deviceProfile << "'" << std::endl; }
+		}
+		if( commandLineParser.optionHasBeenSet( "device-scores" ) ) deviceScoresFilename=commandLineParser.optionArguments("device-scores").back();
+
 		if( commandLineParser.optionHasBeenSet( "repeat" ) )
 		{
 			try{ timesToRepeat=std::stoi( commandLineParser.optionArguments("repeat").back() ); }
@@ -133,15 +1380,62 @@ int main( int argc, char* argv[] )
 
 		if( commandLineParser.optionHasBeenSet( "datasize" ) )
 		{
-			std::string argument=commandLineParser.optionArguments("datasize").back();
+			try{ dataSize=static_cast<size_t>( tools::parseSize( commandLineParser.optionArguments("datasize").back() ) ); }
+			catch( std::exception& error ) { std::cerr << " Error! " << error.what() << " for --datasize" << std::endl; }
+		}
+
+		if( commandLineParser.optionHasBeenSet( "sweep" ) )
+		{
+			try{ sizeSweep.reset( new tools::SizeSweep( tools::SizeSweep::fromString( commandLineParser.optionArguments("sweep").back() ) ) ); }
+			catch( std::exception& error ) { std::cerr << " Error! " << error.what() << std::endl; }
+		}
+
+		if( commandLineParser.optionHasBeenSet( "json" ) ) jsonFilename=commandLineParser.optionArguments("json").back();
+		if( commandLineParser.optionHasBeenSet( "csv" ) ) csvFilename=commandLineParser.optionArguments("csv").back();
+		if( commandLineParser.optionHasBeenSet( "compare" ) ) baselineFilename=commandLineParser.optionArguments("compare").back();
+		if( commandLineParser.optionHasBeenSet( "threshold" ) )
+		{
+			std::string argument=commandLineParser.optionArguments("threshold").back();
 			try
 			{
-				int newSize=std::stoi( argument );
-				if( newSize<=0 ) std::cerr << " Error! '" << newSize << "' must be a non zero positive integer for --datasize" << std::endl;
-				else dataSize=static_cast<size_t>(newSize);
+				double newThreshold=std::stod( argument );
+				if( newThreshold<0 ) std::cerr << " Error! '" << newThreshold << "' must be a positive percentage for --threshold" << std::endl;
+				else regressionThreshold=newThreshold/100;
+			}
+			catch( std::exception& error ) { std::cerr << " Error! '" << argument << "' must be a positive percentage for --threshold" << std::endl; }
+		}
+		// The report is made from the per phase timings, so they need recording
+		if( !jsonFilename.empty() || !csvFilename.empty() || !baselineFilename.empty() ) recordTiming=true;
+		if( commandLineParser.optionHasBeenSet( "trace" ) )
+		{
+			traceFilename=commandLineParser.optionArguments("trace").back();
+			// Device timestamps need the queues created with profiling enabled
+			recordTiming=true;
+			tools::trace::enable();
+		}
+
+		// The options that run the programs some other way than the plain loop over devices and transfer strategies
+		std::vector<std::string> modeOptions;
+		if( sizeSweep ) modeOptions.push_back( "--sweep" );
+		if( !buildProfiles.empty() ) modeOptions.push_back( "--build-variants" );
+		if( chainPrograms ) modeOptions.push_back( "--chain" );
+		if( partitionDevices ) modeOptions.push_back( "--subdevices" );
+		if( asyncSlots!=0 ) modeOptions.push_back( "--async" );
+		if( streamChunkSize!=0 ) modeOptions.push_back( "--stream" );
+		if( splitAcrossDevices ) modeOptions.push_back( "--split" );
+		// Only one can be used at a time, rather than silently running the first and ignoring the rest
+		if( modeOptions.size()>1 ) throw std::runtime_error( modeOptions[0]+" and "+modeOptions[1]+" can't be used together" );
+		if( commandLineParser.optionHasBeenSet( "transfer" ) && !modeOptions.empty() )
+		{
+			if( modeOptions.front()!="--sweep" && modeOptions.front()!="--split" ) std::cerr << " Warning! --transfer is ignored by " << modeOptions.front() << ", which only uses plain copies" << std::endl;
+			else if( transferStrategies.size()>1 )
+			{
+				std::cerr << " Warning! " << modeOptions.front() << " only uses the first --transfer strategy, '"
+						<< tools::DeviceSession::transferStrategyName(transferStrategies.front()) << "'" << std::endl;
 			}
-			catch( std::exception& error ) { std::cerr << " Error! '" << argument << "' must be a non zero positive integer for --datasize" << std::endl; }
 		}
+		// Only the plain loop can check the results on the device
+		if( deviceVerify && !modeOptions.empty() ) throw std::runtime_error( "--device-verify can't be used with "+modeOptions.front() );
 	}
 	catch( std::exception& error )
 	{
@@ -155,126 +1449,305 @@ int main( int argc, char* argv[] )
 		const auto& devices=getAllDevices();
 		if( devices.empty() ) throw std::runtime_error( "There are no OpenCL devices available!" );
 
+		if( useBestDevice )
+		{
+			tools::BenchmarkDeviceSelector selector( tools::WorkloadProfile::fromString(deviceProfile), deviceScoresFilename );
+			const std::vector<size_t> ranking=selector.rank( devices );
+			if( ranking.empty() ) throw std::runtime_error( "None of the devices could be calibrated to choose the best one" );
+			std::cout << "Devices ranked for the '" << deviceProfile << "' workload profile (scores cached in '" << deviceScoresFilename << "'):" << std::endl;
+			tools::printDeviceRanking( devices, ranking, selector, std::cout );
+			if( std::find( devicesToUse.begin(), devicesToUse.end(), ranking.front() )==devicesToUse.end() ) devicesToUse.push_back( ranking.front() );
+		}
+
 		// If no devices have been asked for, use the first one
 		if( devicesToUse.empty() ) for( size_t index=0; index<devices.size(); ++index ) devicesToUse.push_back(index);
+		// Drop any device numbers that don't exist here, so that nothing after this has to check them
+		for( auto iDeviceNumber=devicesToUse.begin(); iDeviceNumber!=devicesToUse.end(); )
+		{
+			if( *iDeviceNumber<devices.size() ) ++iDeviceNumber;
+			else
+			{
+				std::cerr << "Error! There is no device numbered " << *iDeviceNumber << ". There are only " << devices.size() << " devices." << std::endl;
+				iDeviceNumber=devicesToUse.erase( iDeviceNumber );
+			}
+		}
+
+		// Load the baseline first, so that a bad file is found before spending time on the measurements
+		std::unique_ptr<tools::ResultsReport> pBaseline;
+		if( !baselineFilename.empty() ) pBaseline.reset( new tools::ResultsReport( tools::ResultsReport::loadJson(baselineFilename) ) );
+		// Every measurement made, for "--json", "--csv" and "--compare". Null if none of those were asked for.
+		tools::ResultsReport report;
+		tools::ResultsReport* pReport=( !jsonFilename.empty() || !csvFilename.empty() || pBaseline ? &report : nullptr );
 
 		if( printDeviceInfo ) printDevices( devices );
 
+		if( measureBandwidth )
+		{
+			for( const auto deviceNumber : devicesToUse )
+			{
+				std::cout << "Bandwidth for device " << deviceNumber << ": " << deviceInformationString(devices[deviceNumber]) << std::endl;
+				const std::vector<tools::BandwidthResult> bandwidths=tools::measureBandwidth( devices[deviceNumber] );
+				tools::printBandwidth( bandwidths, std::cout );
+				if( pReport ) addBandwidthToReport( devices[deviceNumber], bandwidths, *pReport );
+			}
+		}
+
+		if( measureCompute )
+		{
+			for( const auto deviceNumber : devicesToUse )
+			{
+				std::cout << "Compute throughput for device " << deviceNumber << ": " << deviceInformationString(devices[deviceNumber]) << std::endl;
+				const std::vector<tools::ComputeResult> computeResults=tools::measureCompute( devices[deviceNumber] );
+				tools::printCompute( computeResults, std::cout );
+				if( pReport ) addComputeToReport( devices[deviceNumber], computeResults, *pReport );
+			}
+		}
+
+		if( measureSubmission )
+		{
+			for( const auto deviceNumber : devicesToUse )
+			{
+				std::cout << "Submission scaling for device " << deviceNumber << ": " << deviceInformationString(devices[deviceNumber]) << std::endl;
+				const std::vector<tools::SubmissionResult> submissionResults=tools::measureSubmission( devices[deviceNumber], submissionThreads, sharedSubmissionQueue );
+				tools::printSubmission( submissionResults, std::cout );
+				if( pReport ) addSubmissionToReport( devices[deviceNumber], submissionResults, *pReport );
+			}
+		}
+
 		//
 		// See if I can open the SPIR files requested
 		//
-		std::vector< std::vector<char> > binaries;
+		const tools::DeviceSession::ProgramSource testKernel{ "TestKernel", tools::squareKernelSource(), std::vector<char>(), "", testKernelVectorWidth, gridStride };
+		std::vector<tools::DeviceSession::ProgramSource> programSources;
+		if( executeKernel ) programSources.push_back( testKernel );
 		for( const auto& filename : executeSpirFiles )
 		{
 			std::ifstream spirFile( filename, std::ios::binary | std::ios::ate ); // Open at end to get the length
 			if( !spirFile.is_open() ) std::cerr << "Unable to open SPIR file " << filename << std::endl;
 			else
 			{
-				binaries.emplace_back( spirFile.tellg() ); // Create a new std::vector<char> the same size as the file
+				programSources.push_back( tools::DeviceSession::ProgramSource{ filename, "", std::vector<char>(spirFile.tellg()), "", 0, false } ); // Create a new std::vector<char> the same size as the file
 				spirFile.seekg( 0, std::ios::beg ); // Jump back to start
 				// Copy into this char vector
-				std::copy( std::istreambuf_iterator<char>(spirFile), std::istreambuf_iterator<char>(), binaries.back().begin() );
+				std::copy( std::istreambuf_iterator<char>(spirFile), std::istreambuf_iterator<char>(), programSources.back().binary.begin() );
 			}
 		}
 
-		typedef float T_input;
-		typedef float T_output;
-		std::vector<T_input> data(dataSize); // Arbitrary input data
-		std::vector<T_output> results(dataSize);
-		for( size_t index=0; index<dataSize; ++index ) data[index]=rand();
+		InputVector data(dataSize); // Arbitrary input data
+		OutputVector results(dataSize);
+		if( chainPrograms ) fillChainInput( data, programSources.size() );
+		else
+		{
+			for( size_t index=0; index<dataSize; ++index ) data[index]=rand();
+		}
+
+		// Timing for each phase, keyed by the device number. Only filled if "--timing" was specified.
+		std::map<size_t,tools::PhaseTimings> deviceTimings;
+		tools::PhaseTimings combinedTimings; // Only used for "--split"
+
+		std::unique_ptr<tools::ProgramCache> pProgramCache;
+		if( !cacheDirectory.empty() ) pProgramCache.reset( new tools::ProgramCache(cacheDirectory) );
+		// Declared before anything that takes buffers from it, so that it outlives them
+		tools::BufferPool bufferPool( poolLimit );
 
-		if( !binaries.empty() || executeKernel )
+		const tools::ResultVerifier verifier( tolerance, hostThreads );
+		// Only the square kernel (test kernel or SPIR files) can be compared with the host
+		HostBaseline hostBaseline{ 0, 0 };
+		if( !programSources.empty() && !sizeSweep ) // Sweeps measure their own at each size
 		{
+			hostBaseline=measureHostBaseline( data, hostThreads );
+			std::cout << "Host baseline: " << data.size() << " elements on " << hostBaseline.threads << " threads in " << hostBaseline.time*1e3
+					<< " ms (" << data.size()/hostBaseline.time/1e6 << " Melements/s)" << std::endl;
+		}
+
+		tools::DeviceSession::Settings baseSettings;
+		baseSettings.enableProfiling=recordTiming;
+		baseSettings.pProgramCache=pProgramCache.get();
+		// A cold start should pay for creating everything, so don't share contexts or reuse buffers
+		if( !coldStart ) baseSettings.pBufferPool=&bufferPool;
+		baseSettings.pHostInput=data.data();
+		baseSettings.pHostOutput=results.data();
+
+		// Any previously tuned work group sizes are always used
+		tools::WorkGroupSizeTable workGroupSizes( tuneFilename );
+		baseSettings.pWorkGroupSizes=&workGroupSizes;
+		if( autotune )
+		{
+			// If no programs were specified, tune the test kernel
+			if( programSources.empty() ) executeAutotune( devices, devicesToUse, std::vector<tools::DeviceSession::ProgramSource>( 1, testKernel ), data, baseSettings, workGroupSizes );
+			else executeAutotune( devices, devicesToUse, programSources, data, baseSettings, workGroupSizes );
+		}
+
+		if( !programSources.empty() && sizeSweep )
+		{
+			baseSettings.transferStrategy=transferStrategies.front();
+			executeSweep( devices, devicesToUse, programSources, *sizeSweep, verifier, timesToRepeat, baseSettings, pReport );
+		}
+		else if( !programSources.empty() && !buildProfiles.empty() )
+		{
+			executeBuildVariants( devices, devicesToUse, programSources, data, results, verifier, timesToRepeat, buildProfiles, baseSettings, pReport );
+		}
+		else if( !programSources.empty() && chainPrograms )
+		{
+			executeChain( devices, devicesToUse, programSources, data, results, verifier, timesToRepeat, chainReadBackStages, baseSettings, deviceTimings );
+		}
+		else if( !programSources.empty() && partitionDevices )
+		{
+			executeSubDevices( devices, devicesToUse, programSources, data, results, verifier, timesToRepeat, partitionSchemes, baseSettings, pReport );
+		}
+		else if( !programSources.empty() && asyncSlots!=0 )
+		{
+			executeAsync( devices, devicesToUse, programSources, data, results, verifier, timesToRepeat, asyncSlots, baseSettings, deviceTimings );
+		}
+		else if( !programSources.empty() && streamChunkSize!=0 )
+		{
+			executeStreaming( devices, devicesToUse, programSources, data, results, verifier, hostBaseline, timesToRepeat, streamChunkSize, streamBufferSets,
+					coldStart, baseSettings, deviceTimings );
+		}
+		else if( !programSources.empty() && splitAcrossDevices )
+		{
+			baseSettings.transferStrategy=transferStrategies.front();
+			executeSplitAcrossDevices( devices, devicesToUse, programSources, data, results, verifier, hostBaseline, timesToRepeat, splitWeights=="calibrate",
+					coldStart, baseSettings, deviceTimings, combinedTimings );
+		}
+		else if( !programSources.empty() )
+		{
+			// The context, queue, buffers and built programs for each device and transfer strategy, keyed by device
+			// number. Created on the first repetition and then reused, unless "--cold" was specified.
+			std::map<std::pair<size_t,tools::DeviceSession::TransferStrategy>,std::unique_ptr<tools::DeviceSession> > sessions;
+			// Only used with "--device-verify", with the same keys as sessions. Declared after so that they are destroyed first.
+			std::map<std::pair<size_t,tools::DeviceSession::TransferStrategy>,std::unique_ptr<tools::DeviceVerifier> > deviceVerifiers;
+			OutputVector expected; // The reference for "--device-verify=reference"
+			if( deviceVerifyReference )
+			{
+				expected.resize( data.size() );
+				for( size_t index=0; index<data.size(); ++index ) expected[index]=data[index]*data[index];
+			}
+			// Host wall clock time for write, all kernels and read, for comparing the transfer strategies.
+			std::map<size_t,tools::PhaseTimings> roundTripTimings;
+
 			// Note that it's intentional to repeat forever if timesToRepeat is negative (quit with ctrl-c)
 			for( int repetitionIndex=0; repetitionIndex!=timesToRepeat; ++repetitionIndex )
 			{
 				for( const auto deviceNumber : devicesToUse )
 				{
-					cl_int error=CL_SUCCESS;
-
-					if( deviceNumber>=devices.size() )
-					{
-						std::cerr << "Error! There is no device numbered " << deviceNumber << ". There are only " << devices.size() << " devices." << std::endl;
-						continue;
-					}
 					const auto& device=devices[deviceNumber];
 					std::cout << "Attempting to run on device " << deviceInformationString(device) << std::endl;
 
-					cl::Context context( device, nullptr, nullptr, nullptr, &error );
-					if( error!=CL_SUCCESS ) throw std::runtime_error( "Error when creating context - "+tools::contextCreateError(error) );
-
-					cl::CommandQueue queue( context, device );
-					cl::Buffer input( context, CL_MEM_READ_ONLY, sizeof(T_input)*data.size() );
-					cl::Buffer output( context, CL_MEM_WRITE_ONLY, sizeof(T_input)*data.size() );
-					error=queue.enqueueWriteBuffer( input, CL_TRUE, 0, sizeof(T_input)*data.size(), data.data() );
-					if( error!=CL_SUCCESS ) throw std::runtime_error( "Error when copying input in" );
-
-					std::vector<cl::Program> openCLPrograms;
-					if( executeKernel )
+					for( const auto transferStrategy : transferStrategies )
 					{
-						cl::Program temp(context,TestKernel,false,&error);
-						if( error!=CL_SUCCESS ) throw std::runtime_error( "Error when creating program from source - "+tools::createProgramError(error) );
-						openCLPrograms.push_back( std::move(temp) );
-					}
-					for( const auto binary : binaries )
-					{
-						cl::Program::Binaries clBinaries;
-						clBinaries.push_back( std::make_pair( static_cast<const void*>(binary.data()), binary.size() ) );
-						cl::Program temp(context,std::vector<cl::Device>(1,device),clBinaries,nullptr,&error);
-						if( error!=CL_SUCCESS ) throw std::runtime_error( "Error when creating program from binary - "+tools::createProgramError(error) );
-						openCLPrograms.push_back( std::move(temp) );
-					}
+						if( transferStrategies.size()>1 ) std::cout << "  Transfer strategy '" << tools::DeviceSession::transferStrategyName(transferStrategy) << "'" << std::endl;
 
-					for( const auto& program : openCLPrograms )
-					{
-						error=program.build();
-						if( error!=CL_SUCCESS ) throw std::runtime_error( "Error when building program:\n "+program.getBuildInfo<CL_PROGRAM_BUILD_LOG>(device) );
-
-						//
-						// Figure out the kernel name and get it
-						//
-						cl::Kernel kernel;
-						{ // limit scope of local variables
-							std::string kernelName=program.getInfo<CL_PROGRAM_KERNEL_NAMES>(&error);
-							if( error!=CL_SUCCESS ) throw std::runtime_error( "Error getting the kernel name" );
-							kernel=cl::Kernel( program, kernelName.c_str(), &error );
-							if( error!=CL_SUCCESS ) throw std::runtime_error( "Error when creating kernel '"+kernelName+"' - "+tools::createKernelError(error) );
-						}
-						size_t local=kernel.getWorkGroupInfo<CL_KERNEL_WORK_GROUP_SIZE>(device);
-						if( local>data.size() ) local=data.size();
-
-						//
-						// Set Kernel arguments
-						//
-						error=kernel.setArg( 0, input ); if( error!=CL_SUCCESS ) throw std::runtime_error( "Error when setting kernel argument 0: "+tools::setKernelArgError(error) );
-						error=kernel.setArg( 1, static_cast<unsigned long>(data.size()) ); if( error!=CL_SUCCESS ) throw std::runtime_error( "Error when setting kernel argument 1: "+tools::setKernelArgError(error) );
-						error=kernel.setArg( 2, output ); if( error!=CL_SUCCESS ) throw std::runtime_error( "Error when setting kernel argument 2: "+tools::setKernelArgError(error) );
-						error=kernel.setArg( 3, static_cast<unsigned long>(data.size()) ); if( error!=CL_SUCCESS ) throw std::runtime_error( "Error when setting kernel argument 3: "+tools::setKernelArgError(error) );
-
-						//
-						// Run the kernel
-						//
-						error=queue.enqueueNDRangeKernel( kernel, 0, data.size(), local );
-						if( error!=CL_SUCCESS ) throw std::runtime_error( "Error when enqueing kernel - "+tools::enqueKernelError(error) );
-
-						queue.finish();
-
-						//
-						// Get and check output
-						//
-						error=queue.enqueueReadBuffer( output, CL_TRUE, 0, sizeof(T_output)*results.size(), results.data() );
-						if( error!=CL_SUCCESS ) throw std::runtime_error( "Error when copying output out" );
-
-						size_t correctResults=0;
-						for( size_t index=0; index<data.size() && index<results.size(); ++index )
+						std::unique_ptr<tools::DeviceSession>& pSession=sessions[std::make_pair(deviceNumber,transferStrategy)];
+						std::unique_ptr<tools::DeviceVerifier>& pDeviceVerifier=deviceVerifiers[std::make_pair(deviceNumber,transferStrategy)];
+						if( !pSession || coldStart )
 						{
-							if( results[index]==(data[index]*data[index]) ) ++correctResults;
+							tools::DeviceSession::Settings sessionSettings=baseSettings;
+							if( recordTiming ) sessionSettings.pTimings=&deviceTimings[deviceNumber];
+							sessionSettings.transferStrategy=transferStrategy;
+
+							pDeviceVerifier.reset(); // Refers to the session
+							pSession.reset(); // Make sure the old one is released before creating the new one
+							pSession.reset( new tools::DeviceSession( device, programSources, data.size(), sizeof(T_input), sessionSettings ) );
+							if( deviceVerify && deviceVerifyReference ) pDeviceVerifier.reset( new tools::DeviceVerifier( *pSession, verifier.tolerance(), expected.data() ) );
+							else if( deviceVerify ) pDeviceVerifier.reset( new tools::DeviceVerifier( *pSession, verifier.tolerance(), "x*x" ) );
 						}
-						std::cout << "   " << correctResults << "/" << data.size() << " correct results." << std::endl;
-					} // end of loop over openCLPrograms
+						const tools::DeviceSession& session=*pSession;
+
+						tools::StopWatch roundTripTime;
+						for( size_t programIndex=0; programIndex<session.programs().size(); ++programIndex )
+						{
+							// The input only needs writing before the first program, and the output is only read if it is checked on the host
+							const bool writes=( programIndex==0 );
+							const bool reads=!pDeviceVerifier;
+							const std::string covered=( writes && reads ? "including transfers" : writes ? "including the write" : reads ? "including the read" : "no transfers" );
+							session.fillOutput();
+							tools::StopWatch programTime;
+							if( pDeviceVerifier )
+							{
+								runProgram( session, programIndex, writes, data.data(), nullptr, recordTiming ? &deviceTimings[deviceNumber] : nullptr );
+								printSpeedup( programTime.elapsed(), hostBaseline, covered );
+								const tools::VerificationResult verification=pDeviceVerifier->verify( session.output(), data.size() );
+								if( recordTiming ) deviceTimings[deviceNumber].phase( "device verify", (sizeof(T_input)+sizeof(T_output))*verification.checked, verification.checked ).addSample( verification.time );
+								tools::printVerification( verification, verifier.tolerance(), std::cout );
+								if( verification.mismatches!=0 )
+								{
+									// Only now is it worth reading everything back, to find all the details on the host
+									session.readOutput( results.data() );
+									tools::printVerification( verifyResults( data, results, verifier, nullptr ), verifier.tolerance(), std::cout, "      " );
+								}
+							}
+							else
+							{
+								runProgram( session, programIndex, writes, data.data(), results.data(), recordTiming ? &deviceTimings[deviceNumber] : nullptr );
+								printSpeedup( programTime.elapsed(), hostBaseline, covered );
+								tools::printVerification( verifyResults( data, results, verifier, recordTiming ? &deviceTimings[deviceNumber] : nullptr ), verifier.tolerance(), std::cout );
+							}
+						} // end of loop over session programs
+						// Note this includes the time to check results, but that's the same for each strategy
+						roundTripTimings[deviceNumber].phase( tools::DeviceSession::transferStrategyName(transferStrategy), 0, data.size() ).addSample( roundTripTime.elapsed() );
+					} // end of loop over transferStrategies
 				} // end of loop over devicesToUse
 			} // end of loop over timesToRepeat
-		} // end of "if( !binaries.empty() || executeKernel )
+
+			if( transferStrategies.size()>1 )
+			{
+				for( const auto& deviceTimingPair : roundTripTimings )
+				{
+					std::cout << "Transfer strategies on device " << deviceInformationString(devices[deviceTimingPair.first]) << " (wall clock for write, all programs and read)" << std::endl;
+					deviceTimingPair.second.print( std::cout );
+					const auto& phases=deviceTimingPair.second.phases();
+					auto iFastest=std::min_element( phases.begin(), phases.end(), []( const tools::PhaseTimings::Phase& a, const tools::PhaseTimings::Phase& b ){ return a.statistics.median()<b.statistics.median(); } );
+					if( iFastest!=phases.end() ) std::cout << "   Cheapest strategy is '" << iFastest->name << "'" << std::endl;
+				}
+			}
+		} // end of "else if( !programSources.empty() )
+
+		if( !specFiles.empty() ) executeSpecs( devices, devicesToUse, specFiles, timesToRepeat, coldStart, recordTiming, pProgramCache.get(), baseSettings.pBufferPool, deviceTimings );
+
+		for( const auto& deviceTimingPair : deviceTimings )
+		{
+			std::cout << "Timing on device " << deviceInformationString(devices[deviceTimingPair.first]) << std::endl;
+			deviceTimingPair.second.print( std::cout );
+		}
+		if( !combinedTimings.empty() )
+		{
+			std::cout << "Timing for all devices together (wall clock, including transfers)" << std::endl;
+			combinedTimings.print( std::cout );
+		}
+
+		if( pProgramCache )
+		{
+			std::cout << "Program cache '" << pProgramCache->directory() << "': " << pProgramCache->hits() << " hits, "
+					<< pProgramCache->misses() << " misses, " << pProgramCache->timeSaved() << " seconds of build time saved." << std::endl;
+		}
+		if( bufferPool.statistics().requests!=0 ) tools::printBufferPool( bufferPool, std::cout );
+
+		if( !traceFilename.empty() )
+		{
+			std::ofstream traceFile( traceFilename );
+			if( !traceFile.is_open() ) throw std::runtime_error( "Unable to open '"+traceFilename+"' to write the trace" );
+			tools::trace::writeChromeTrace( traceFile );
+			std::cout << "Wrote trace to '" << traceFilename << "'" << std::endl;
+		}
+
+		if( pReport )
+		{
+			for( const auto& deviceTimingPair : deviceTimings )
+			{
+				const auto& device=devices[deviceTimingPair.first];
+				pReport->addTimings( deviceInformationString(device), device.getInfo<CL_DRIVER_VERSION>(), deviceTimingPair.second );
+			}
+			pReport->addTimings( "all devices", "", combinedTimings );
+			if( hostBaseline.time>0 )
+			{
+				pReport->addValue( "host", "", "host baseline "+std::to_string(hostBaseline.threads)+" threads", "s", false, hostBaseline.time,
+						data.size(), (sizeof(T_input)+sizeof(T_output))*data.size() );
+			}
+			writeReport( *pReport, jsonFilename, csvFilename );
+			// A distinct return code so that scripts can tell a regression from a failure to run
+			if( pBaseline && printRegressions( pReport->compare( *pBaseline, regressionThreshold ), baselineFilename, regressionThreshold )!=0 ) return -3;
+		}
 	}
 	catch( std::exception& error )
 	{
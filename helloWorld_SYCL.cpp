@@ -1,86 +1,399 @@
 /* Compiled with:
- * compute++ --gcc-toolchain=/cm/shared/languages/GCC-4.8.4 -O2 --std=c++11 -sycl -intelspirmetadata -emit-llvm -D__DEVICE_SPIR32__ -DBUILD_PLATFORM_SPIR -I$HOME/Programs/ComputeCpp/include -o helloWorld_SYCL.cpp.bc -c helloWorld_SYCL.cpp && compute++ --gcc-toolchain=/cm/shared/languages/GCC-4.8.4 -O2 --std=c++11 -I$HOME/Programs/ComputeCpp/include -L$HOME/Programs/ComputeCpp/lib -lSYCL -L$HOME/Programs/OpenCL/AMDAPPSDK-3.0/lib/x86_64/sdk -lOpenCL helloWorld_SYCL.cpp --include helloWorld_SYCL.cpp.sycl -o helloWorld_SYCL ~/Programs/glibc-install/lib/only_libc/libc.so.6 -Wl,-rpath,$HOME/Programs/glibc-install/lib/only_libc -ggdb
+ * compute++ --gcc-toolchain=/cm/shared/languages/GCC-4.8.4 -O2 --std=c++11 -sycl -intelspirmetadata -emit-llvm -D__DEVICE_SPIR32__ -DBUILD_PLATFORM_SPIR -I$HOME/Programs/ComputeCpp/include -o helloWorld_SYCL.cpp.bc -c helloWorld_SYCL.cpp && compute++ --gcc-toolchain=/cm/shared/languages/GCC-4.8.4 -O2 --std=c++11 -I$HOME/Programs/ComputeCpp/include -L$HOME/Programs/ComputeCpp/lib -lSYCL -L$HOME/Programs/OpenCL/AMDAPPSDK-3.0/lib/x86_64/sdk -lOpenCL helloWorld_SYCL.cpp tools/CommandLineParser.cpp tools/DeviceSelector.cpp tools/BandwidthBenchmark.cpp tools/ComputeBenchmark.cpp tools/KernelGenerator.cpp tools/Timing.cpp tools/SizeSweep.cpp --include helloWorld_SYCL.cpp.sycl -o helloWorld_SYCL ~/Programs/glibc-install/lib/only_libc/libc.so.6 -Wl,-rpath,$HOME/Programs/glibc-install/lib/only_libc -ggdb
  */
 #include <CL/sycl.hpp>
 #include <iostream>
 #include <iomanip>
-
-// Use a static data size for simplicity
-//
-#define DATA_SIZE (20)
+#include <vector>
+#include <limits>
+#include <algorithm>
+#include <cmath>
+#include "tools/CommandLineParser.h"
+#include "tools/DeviceSelector.h"
+#include "tools/SyclDeviceSelector.h"
+#include "tools/Timing.h"
+#include "tools/SizeSweep.h"
 
 //
 // Unnamed namespace for things only used in this file
 //
 namespace
 {
-	/** @brief SYCL device selector that will choose Xeon Phis */
-	class XeonPhiDeviceSelector : public cl::sycl::device_selector
+	/** @brief Points uniformly distributed in the unit cube. The w component is unused and always zero. */
+	std::vector<cl::sycl::float4> randomPoints( size_t count )
+	{
+		std::vector<cl::sycl::float4> points;
+		points.reserve( count );
+		for( size_t index=0; index<count; ++index )
+		{
+			points.push_back( cl::sycl::float4( rand()/(RAND_MAX+1.0f), rand()/(RAND_MAX+1.0f), rand()/(RAND_MAX+1.0f), 0.0f ) );
+		}
+		return points;
+	}
+
+	float distanceSquared( const cl::sycl::float4& a, const cl::sycl::float4& b )
+	{
+		const float dx=a.x()-b.x(), dy=a.y()-b.y(), dz=a.z()-b.z();
+		return dx*dx+dy*dy+dz*dz;
+	}
+
+	/** @brief Every point compares itself with every other point, straight from global memory. O(N^2).
+	 *
+	 * All of the find functions write the index of each point's nearest neighbour into "nearest" and
+	 * return the wall clock seconds taken, including the transfers to and from the device.
+	 */
+	double findNearestBruteForce( cl::sycl::queue& queue, const std::vector<cl::sycl::float4>& points, std::vector<int>& nearest )
+	{
+		tools::StopWatch stopWatch;
+		const size_t count=points.size();
+		const float largest=std::numeric_limits<float>::max();
+		{
+			cl::sycl::buffer<cl::sycl::float4,1> pointsBuffer( points.data(), cl::sycl::range<1>(count) );
+			cl::sycl::buffer<int,1> nearestBuffer( nearest.data(), cl::sycl::range<1>(count) );
+
+			queue.submit( [&]( cl::sycl::handler& handler )
+			{
+				auto pointsAccess=pointsBuffer.get_access<cl::sycl::access::mode::read>(handler);
+				auto nearestAccess=nearestBuffer.get_access<cl::sycl::access::mode::discard_write>(handler);
+
+				handler.parallel_for<class NearestBruteForce>( cl::sycl::range<1>(count), [=]( cl::sycl::item<1> item )
+				{
+					const size_t index=item.get(0);
+					const cl::sycl::float4 point=pointsAccess[index];
+					float bestDistance=largest;
+					int bestIndex=-1;
+					for( size_t other=0; other<count; ++other )
+					{
+						const cl::sycl::float4 difference=pointsAccess[other]-point;
+						const float distance=difference.x()*difference.x()+difference.y()*difference.y()+difference.z()*difference.z();
+						if( other!=index && distance<bestDistance )
+						{
+							bestDistance=distance;
+							bestIndex=static_cast<int>(other);
+						}
+					}
+					nearestAccess[index]=bestIndex;
+				} );
+			} );
+		} // Buffer destructors wait for the kernel and copy the result back into "nearest"
+		return stopWatch.elapsed();
+	}
+
+	/** @brief Still O(N^2), but each work group stages a tile of tileSize points at a time in local memory, so each
+	 * point is read from global memory once per work group instead of once per work item. */
+	double findNearestTiled( cl::sycl::queue& queue, const std::vector<cl::sycl::float4>& points, std::vector<int>& nearest, size_t tileSize )
+	{
+		tools::StopWatch stopWatch;
+		const size_t count=points.size();
+		const size_t globalSize=(count+tileSize-1)/tileSize*tileSize;
+		const float largest=std::numeric_limits<float>::max();
+		{
+			cl::sycl::buffer<cl::sycl::float4,1> pointsBuffer( points.data(), cl::sycl::range<1>(count) );
+			cl::sycl::buffer<int,1> nearestBuffer( nearest.data(), cl::sycl::range<1>(count) );
+
+			queue.submit( [&]( cl::sycl::handler& handler )
+			{
+				auto pointsAccess=pointsBuffer.get_access<cl::sycl::access::mode::read>(handler);
+				auto nearestAccess=nearestBuffer.get_access<cl::sycl::access::mode::discard_write>(handler);
+				cl::sycl::accessor<cl::sycl::float4,1,cl::sycl::access::mode::read_write,cl::sycl::access::target::local> tile( cl::sycl::range<1>(tileSize), handler );
+
+				handler.parallel_for<class NearestTiled>( cl::sycl::nd_range<1>( cl::sycl::range<1>(globalSize), cl::sycl::range<1>(tileSize) ), [=]( cl::sycl::nd_item<1> item )
+				{
+					const size_t index=item.get_global(0);
+					const size_t localIndex=item.get_local(0);
+					// Work items past the end still have to help load the tiles and reach the barriers
+					const cl::sycl::float4 point=( index<count ? pointsAccess[index] : cl::sycl::float4(0.0f) );
+					float bestDistance=largest;
+					int bestIndex=-1;
+					for( size_t tileStart=0; tileStart<count; tileStart+=tileSize )
+					{
+						if( tileStart+localIndex<count ) tile[localIndex]=pointsAccess[tileStart+localIndex];
+						item.barrier( cl::sycl::access::fence_space::local_space );
+
+						const size_t tileLength=( count-tileStart<tileSize ? count-tileStart : tileSize );
+						for( size_t other=0; other<tileLength; ++other )
+						{
+							const cl::sycl::float4 difference=tile[other]-point;
+							const float distance=difference.x()*difference.x()+difference.y()*difference.y()+difference.z()*difference.z();
+							if( tileStart+other!=index && distance<bestDistance )
+							{
+								bestDistance=distance;
+								bestIndex=static_cast<int>(tileStart+other);
+							}
+						}
+						// Everyone has to finish with this tile before it is overwritten by the next
+						item.barrier( cl::sycl::access::fence_space::local_space );
+					}
+					if( index<count ) nearestAccess[index]=bestIndex;
+				} );
+			} );
+		}
+		return stopWatch.elapsed();
+	}
+
+	/** @brief Bins the points into a uniform grid of cells (on the host, a counting sort so O(N)), then each point
+	 * searches shells of cells around its own until no unsearched cell can hold anything closer.
+	 *
+	 * With about two points per cell the search is close to O(N) for uniformly distributed points. Returns the total
+	 * time and sets binningTime to the part spent binning on the host.
+	 */
+	double findNearestGrid( cl::sycl::queue& queue, const std::vector<cl::sycl::float4>& points, std::vector<int>& nearest, double& binningTime )
 	{
-	public:
-		virtual int operator()( const cl::sycl::device& device ) const override
+		tools::StopWatch stopWatch;
+		const size_t count=points.size();
+		const float largest=std::numeric_limits<float>::max();
+
+		const int cellsPerSide=std::max( 1, std::min( 1024, static_cast<int>( std::cbrt(count/2.0) ) ) );
+		const float cellSize=1.0f/cellsPerSide;
+		auto cellOf=[cellsPerSide]( float coordinate ){ return std::max( 0, std::min( cellsPerSide-1, static_cast<int>(coordinate*cellsPerSide) ) ); };
+
+		const size_t numberOfCells=static_cast<size_t>(cellsPerSide)*cellsPerSide*cellsPerSide;
+		std::vector<int> cellStart( numberOfCells+1, 0 ); // Points in cell c are sortedPoints[cellStart[c]] to sortedPoints[cellStart[c+1]-1]
+		std::vector<int> pointCell( count );
+		for( size_t index=0; index<count; ++index )
 		{
-			// If it doesn't support the cl_khr_spir extension, can't use it at all
-			if( !device.has_extension("cl_khr_spir") ) return -1; // Negative numbers mean it will never be used
+			const cl::sycl::float4& point=points[index];
+			pointCell[index]=( cellOf(point.z())*cellsPerSide+cellOf(point.y()) )*cellsPerSide+cellOf(point.x());
+			++cellStart[pointCell[index]+1];
+		}
+		for( size_t cell=0; cell<numberOfCells; ++cell ) cellStart[cell+1]+=cellStart[cell];
 
-			auto type=device.get_info<cl::sycl::info::device::device_type>();
-			if( type==cl::sycl::info::device_type::accelerator ) return 100;
-			else if( type==cl::sycl::info::device_type::gpu ) return 90;
-			else if( type==cl::sycl::info::device_type::cpu )
+		std::vector<cl::sycl::float4> sortedPoints( count );
+		std::vector<int> originalIndex( count );
+		std::vector<int> nextSlot( cellStart.begin(), cellStart.end()-1 );
+		for( size_t index=0; index<count; ++index )
+		{
+			const int slot=nextSlot[pointCell[index]]++;
+			sortedPoints[slot]=points[index];
+			originalIndex[slot]=static_cast<int>(index);
+		}
+		binningTime=stopWatch.elapsed();
+
+		{
+			cl::sycl::buffer<cl::sycl::float4,1> pointsBuffer( sortedPoints.data(), cl::sycl::range<1>(count) );
+			cl::sycl::buffer<int,1> originalIndexBuffer( originalIndex.data(), cl::sycl::range<1>(count) );
+			cl::sycl::buffer<int,1> cellStartBuffer( cellStart.data(), cl::sycl::range<1>(cellStart.size()) );
+			cl::sycl::buffer<int,1> nearestBuffer( nearest.data(), cl::sycl::range<1>(count) );
+
+			queue.submit( [&]( cl::sycl::handler& handler )
 			{
-				// On my system I have the AMD OpenCL implementation that can run on Intel chips,
-				// and I also have the Intel OpenCL implementation. I've heard the Intel implementation
-				// is much faster (no proof of that though). It also reports larger work group sizes.
-				std::string vendor=device.get_platform().get_info<cl::sycl::info::platform::vendor>();
-				if( vendor.substr(0,5)=="Intel" ) return 80;
-				else return 70;
+				auto pointsAccess=pointsBuffer.get_access<cl::sycl::access::mode::read>(handler);
+				auto originalIndexAccess=originalIndexBuffer.get_access<cl::sycl::access::mode::read>(handler);
+				auto cellStartAccess=cellStartBuffer.get_access<cl::sycl::access::mode::read>(handler);
+				auto nearestAccess=nearestBuffer.get_access<cl::sycl::access::mode::discard_write>(handler);
+
+				handler.parallel_for<class NearestGrid>( cl::sycl::range<1>(count), [=]( cl::sycl::item<1> item )
+				{
+					const int index=static_cast<int>(item.get(0));
+					const cl::sycl::float4 point=pointsAccess[index];
+					const int cellX=cl::sycl::min( cellsPerSide-1, static_cast<int>(point.x()*cellsPerSide) );
+					const int cellY=cl::sycl::min( cellsPerSide-1, static_cast<int>(point.y()*cellsPerSide) );
+					const int cellZ=cl::sycl::min( cellsPerSide-1, static_cast<int>(point.z()*cellsPerSide) );
+
+					float bestDistance=largest;
+					int bestIndex=-1;
+					for( int radius=0; radius<cellsPerSide; ++radius )
+					{
+						// Only the cells on the surface of the cube of side 2*radius+1, the inside has already been done
+						for( int z=cl::sycl::max( 0, cellZ-radius ); z<=cl::sycl::min( cellsPerSide-1, cellZ+radius ); ++z )
+						{
+							for( int y=cl::sycl::max( 0, cellY-radius ); y<=cl::sycl::min( cellsPerSide-1, cellY+radius ); ++y )
+							{
+								const bool wholeRow=( z==cellZ-radius || z==cellZ+radius || y==cellY-radius || y==cellY+radius );
+								for( int x=cellX-radius; x<=cellX+radius; x+=( wholeRow ? 1 : 2*radius ) )
+								{
+									if( x<0 || x>=cellsPerSide ) continue;
+									const int cell=(z*cellsPerSide+y)*cellsPerSide+x;
+									for( int other=cellStartAccess[cell]; other<cellStartAccess[cell+1]; ++other )
+									{
+										const cl::sycl::float4 difference=pointsAccess[other]-point;
+										const float distance=difference.x()*difference.x()+difference.y()*difference.y()+difference.z()*difference.z();
+										if( other!=index && distance<bestDistance )
+										{
+											bestDistance=distance;
+											bestIndex=other;
+										}
+									}
+								}
+							}
+						}
+						// Anything in cells further out is at least radius*cellSize away
+						const float searched=radius*cellSize;
+						if( bestIndex>=0 && bestDistance<=searched*searched ) break;
+					}
+					nearestAccess[originalIndexAccess[index]]=( bestIndex<0 ? -1 : originalIndexAccess[bestIndex] );
+				} );
+			} );
+		}
+		return stopWatch.elapsed();
+	}
+
+	/** @brief Checks an evenly spaced sample of the points against a brute force search on the host.
+	 *
+	 * Only the distances are compared, so that a different choice between equally near neighbours isn't
+	 * counted as wrong. Returns the number of sampled points that were wrong, and nothing is checked if samples is zero.
+	 */
+	size_t countWrongNeighbours( const std::vector<cl::sycl::float4>& points, const std::vector<int>& nearest, size_t samples, size_t& checked )
+	{
+		checked=0;
+		if( samples==0 ) return 0;
+		const size_t count=points.size();
+		const size_t stride=std::max<size_t>( 1, count/samples );
+		size_t wrong=0;
+		for( size_t index=0; index<count; index+=stride, ++checked )
+		{
+			float bestDistance=std::numeric_limits<float>::max();
+			for( size_t other=0; other<count; ++other )
+			{
+				if( other!=index ) bestDistance=std::min( bestDistance, distanceSquared( points[index], points[other] ) );
 			}
-			else return 1;
+			const int found=nearest[index];
+			// The device may contract to fused multiply-adds, so allow for a little rounding difference
+			if( found<0 || static_cast<size_t>(found)>=count || static_cast<size_t>(found)==index
+					|| distanceSquared( points[index], points[found] )>bestDistance*(1+1e-5f) ) ++wrong;
 		}
-	};
+		return wrong;
+	}
+
+	void printUsage( const std::string& executableName, std::ostream& output=std::cout )
+	{
+		output << "Usage:" << "\n"
+				<< "\t" << executableName << " [--points <number>] [--max-all-pairs <number>] [--tile <number>] [--check <number>]" << "\n"
+				<< "\t\t" << "--points    Number of points to find the nearest neighbours of. Suffixes K, M and G (powers of 1024) are" << "\n"
+				<< "\t\t" << "            allowed. Can be specified multiple times. Default is 10^3 to 10^7 in factors of ten." << "\n"
+				<< "\t\t" << "--max-all-pairs  Largest number of points to run the O(N^2) brute force and tiled kernels on. Default 10^6." << "\n"
+				<< "\t\t" << "--tile      Points staged in local memory per work group for the tiled kernel. Default is the smaller of" << "\n"
+				<< "\t\t" << "            256 and the device's maximum work group size." << "\n"
+				<< "\t\t" << "--check     Number of points to check against a brute force search on the host, 0 to not check. Default 100." << "\n"
+				<< "\t" << executableName << " --help" << "\n"
+				<< "\t" << "\t" << "prints this help message and exits" << "\n"
+				<< std::endl;
+	}
 } // end of the unnamed namespace
 
 int main( int argc, char* argv[] )
 {
 	//
-	// Example piece of code that takes an arbitrary number of 3D points and for
-	// each point calculates which of the other points is closest in Cartesian space.
-	// Uses brute force to calculate the distances between all points, then loops over
-	// these distances to find the lowest value.
+	// Takes an arbitrary number of 3D points and for each point calculates which of the other
+	// points is closest in Cartesian space, three different ways:
+	//     brute force - every point against every other, from global memory.
+	//     tiled       - the same, but blocks of points are shared between a work group in local memory.
+	//     grid        - points are binned into a uniform grid and only nearby cells searched.
+	// Each is timed for a range of point counts to show how they scale.
 	//
-    unsigned int count = DATA_SIZE;
-	std::array<float,DATA_SIZE> data;
-    for( size_t index=0; index<count; ++index ) data[index]=rand()/static_cast<float>(RAND_MAX);
+	std::vector<size_t> pointCounts;
+	size_t maxAllPairs=1000000;
+	size_t tileSize=0; // Zero means choose from the device
+	size_t samplesToCheck=100;
 
-	cl::sycl::buffer<float> input( data.data(), cl::sycl::range<1>(data.size()) );
-	cl::sycl::buffer<float> output( cl::sycl::range<1>(data.size()) );
+	tools::CommandLineParser commandLineParser;
+	try
+	{
+		commandLineParser.addOption( "help", tools::CommandLineParser::NoArgument );
+		commandLineParser.addOption( "points", tools::CommandLineParser::RequiredArgument );
+		commandLineParser.addOption( "max-all-pairs", tools::CommandLineParser::RequiredArgument );
+		commandLineParser.addOption( "tile", tools::CommandLineParser::RequiredArgument );
+		commandLineParser.addOption( "check", tools::CommandLineParser::RequiredArgument );
+		commandLineParser.parse( argc, argv );
 
-	::XeonPhiDeviceSelector deviceSelector;
-	cl::sycl::queue myQueue(deviceSelector);
+		if( commandLineParser.optionHasBeenSet( "help" ) )
+		{
+			printUsage( commandLineParser.executableName(), std::cerr );
+			return 0;
+		}
 
-	myQueue.submit( [&]( cl::sycl::handler& myHandler )
+		for( const auto& argument : commandLineParser.optionArguments("points") )
+		{
+			try
+			{
+				const uint64_t count=tools::parseSize( argument );
+				if( count<2 || count>static_cast<uint64_t>(std::numeric_limits<int>::max()) ) std::cerr << " Error! '" << argument << "' must be between 2 and 2^31 for --points" << std::endl;
+				else pointCounts.push_back( static_cast<size_t>(count) );
+			}
+			catch( std::exception& error ) { std::cerr << " Error! " << error.what() << " for --points" << std::endl; }
+		}
+		if( pointCounts.empty() ) pointCounts={ 1000, 10000, 100000, 1000000, 10000000 };
+
+		if( commandLineParser.optionHasBeenSet( "max-all-pairs" ) )
+		{
+			try{ maxAllPairs=static_cast<size_t>( tools::parseSize( commandLineParser.optionArguments("max-all-pairs").back() ) ); }
+			catch( std::exception& error ) { std::cerr << " Error! " << error.what() << " for --max-all-pairs" << std::endl; }
+		}
+		if( commandLineParser.optionHasBeenSet( "tile" ) )
+		{
+			try{ tileSize=static_cast<size_t>( tools::parseSize( commandLineParser.optionArguments("tile").back() ) ); }
+			catch( std::exception& error ) { std::cerr << " Error! " << error.what() << " for --tile" << std::endl; }
+		}
+		if( commandLineParser.optionHasBeenSet( "check" ) )
+		{
+			const std::string argument=commandLineParser.optionArguments("check").back();
+			try{ samplesToCheck=( argument=="0" ? 0 : static_cast<size_t>( tools::parseSize( argument ) ) ); }
+			catch( std::exception& error ) { std::cerr << " Error! " << error.what() << " for --check" << std::endl; }
+		}
+	}
+	catch( std::exception& error )
 	{
-		auto inputAccess=input.get_access<cl::sycl::access::mode::read>(myHandler);
-		auto outputAccess=output.get_access<cl::sycl::access::mode::write>(myHandler);
+		std::cerr << "Exception parsing command line: " << error.what() << std::endl;
+		printUsage( commandLineParser.executableName(), std::cerr );
+		return -1;
+	}
+
+	try
+	{
+		// Devices are ranked on measured bandwidth and compute (cached between runs), for a workload that
+		// is dominated by arithmetic. Only devices that can take SPIR are usable.
+		tools::BenchmarkDeviceSelector benchmarkSelector( tools::WorkloadProfile::fromString("compute") );
+		tools::SyclDeviceSelector deviceSelector( benchmarkSelector, "cl_khr_spir" );
+		cl::sycl::queue myQueue(deviceSelector);
+
+		if( tileSize==0 ) tileSize=std::min<size_t>( 256, myQueue.get_device().get_info<cl::sycl::info::device::max_work_group_size>() );
+		std::cout << "Running on " << myQueue.get_device().get_info<cl::sycl::info::device::name>() << ", tile size " << tileSize << std::endl;
+
+		// The first submit of each kernel also builds its program, so run them all once untimed first
+		{
+			const std::vector<cl::sycl::float4> points=randomPoints( 2*tileSize );
+			std::vector<int> nearest( points.size() );
+			double binningTime=0;
+			findNearestBruteForce( myQueue, points, nearest );
+			findNearestTiled( myQueue, points, nearest, tileSize );
+			findNearestGrid( myQueue, points, nearest, binningTime );
+		}
 
-		myHandler.parallel_for<class HelloWorld>( cl::sycl::range<1>(input.get_count()), [=](cl::sycl::item<1> range)
+		std::cout << std::setw(10) << "points" << std::setw(16) << "brute force ms" << std::setw(12) << "tiled ms" << std::setw(12) << "grid ms"
+				<< std::setw(14) << "(binning ms)" << "   checked" << std::endl;
+		std::cout << std::fixed << std::setprecision(2);
+		for( const auto count : pointCounts )
 		{
-			float temp=inputAccess[range];
-			outputAccess[range]=temp*temp;
-			// Bizarelly, this next line gives incorrect results unless there is either
-			// a temporary variable (as above), or a printf.
-			//outputAccess[range]=inputAccess[range]*inputAccess[range];
-		} );
-	});
-
-
-	auto outputCheck=output.get_access<cl::sycl::access::mode::read,cl::sycl::access::target::host_buffer>();
-	size_t correctAnswers=0;
-	for( size_t index=0; index<input.get_count(); ++index )
+			const std::vector<cl::sycl::float4> points=randomPoints( count );
+			std::vector<int> nearest( count );
+			size_t checked=0;
+			size_t wrong=0;
+
+			std::cout << std::setw(10) << count << std::flush;
+			if( count<=maxAllPairs )
+			{
+				std::cout << std::setw(16) << findNearestBruteForce( myQueue, points, nearest )*1e3 << std::flush;
+				wrong+=countWrongNeighbours( points, nearest, samplesToCheck, checked );
+				std::cout << std::setw(12) << findNearestTiled( myQueue, points, nearest, tileSize )*1e3 << std::flush;
+				wrong+=countWrongNeighbours( points, nearest, samplesToCheck, checked );
+			}
+			else std::cout << std::setw(16) << "-" << std::setw(12) << "-";
+
+			double binningTime=0;
+			std::cout << std::setw(12) << findNearestGrid( myQueue, points, nearest, binningTime )*1e3 << std::setw(14) << binningTime*1e3 << std::flush;
+			wrong+=countWrongNeighbours( points, nearest, samplesToCheck, checked );
+
+			if( samplesToCheck==0 ) std::cout << "   not checked";
+			else std::cout << "   " << checked << " points per method";
+			if( wrong!=0 ) std::cout << ", " << wrong << " WRONG";
+			std::cout << std::endl;
+		}
+	}
+	catch( std::exception& error )
 	{
-		if( outputCheck[index]==(data[index]*data[index]) ) ++correctAnswers;
-		//else std::cout << data[index] << "*" << data[index] << "!=" << outputCheck[index] << "!\n";
+		std::cerr << "Exception while executing: " << error.what() << std::endl;
+		return -2;
 	}
-	std::cout << "There were " << correctAnswers << "/" << input.get_count() << " correct answers." << std::endl;
 
+	return 0;
 }
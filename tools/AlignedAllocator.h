@@ -0,0 +1,39 @@
+#ifndef INCLUDEGUARD_tools_AlignedAllocator_h
+#define INCLUDEGUARD_tools_AlignedAllocator_h
+
+#include <cstddef>
+#include <cstdlib>
+#include <new>
+
+namespace tools
+{
+	/** @brief Allocator for std::vector that aligns the memory, by default to a page boundary.
+	 *
+	 * Some OpenCL implementations can only use host memory directly for CL_MEM_USE_HOST_PTR if it
+	 * is page aligned (and a multiple of the cache line in size), otherwise they silently copy it.
+	 */
+	template<typename T, size_t Alignment=4096>
+	class AlignedAllocator
+	{
+	public:
+		typedef T value_type;
+		template<typename U> struct rebind { typedef AlignedAllocator<U,Alignment> other; };
+
+		AlignedAllocator() {}
+		template<typename U> AlignedAllocator( const AlignedAllocator<U,Alignment>& ) {}
+
+		T* allocate( size_t count )
+		{
+			void* pMemory=nullptr;
+			if( ::posix_memalign( &pMemory, Alignment, count*sizeof(T) )!=0 ) throw std::bad_alloc();
+			return static_cast<T*>(pMemory);
+		}
+		void deallocate( T* pMemory, size_t ) { std::free( pMemory ); }
+
+		template<typename U> bool operator==( const AlignedAllocator<U,Alignment>& ) const { return true; }
+		template<typename U> bool operator!=( const AlignedAllocator<U,Alignment>& ) const { return false; }
+	};
+
+} // end of the tools namespace
+
+#endif
@@ -0,0 +1,177 @@
+#include "AsyncSubmitter.h"
+
+#include <stdexcept>
+#include <thread>
+#include <string>
+#include "DeviceSession.h"
+#include "OpenCLEnums.h"
+#include "Timing.h"
+#include "Trace.h"
+
+
+tools::AsyncSubmitter::AsyncSubmitter( const tools::DeviceSession& session, size_t numberOfSlots )
+	: session_( session ), outOfOrder_( false )
+{
+	cl_int error=CL_SUCCESS;
+	if( numberOfSlots<1 ) throw std::runtime_error( "AsyncSubmitter needs at least one slot" );
+
+	outOfOrder_=( session.device().getInfo<CL_DEVICE_QUEUE_PROPERTIES>() & CL_QUEUE_OUT_OF_ORDER_EXEC_MODE_ENABLE )!=0;
+	queue_=cl::CommandQueue( session.context(), session.device(), outOfOrder_ ? CL_QUEUE_OUT_OF_ORDER_EXEC_MODE_ENABLE : 0, &error );
+	if( error!=CL_SUCCESS ) throw std::runtime_error( "Error when creating asynchronous command queue - "+tools::createQueueError(error) );
+
+	const size_t outputBytes=session.bytesPerElement()*session.elementCount();
+	for( size_t index=0; index<numberOfSlots; ++index )
+	{
+		Slot slot;
+		slot.output=session.createBuffer( CL_MEM_WRITE_ONLY, outputBytes, nullptr, &error );
+		if( error!=CL_SUCCESS ) throw std::runtime_error( "Error when creating an asynchronous output buffer - "+tools::createBufferError(error) );
+		slot.hostOutput.resize( outputBytes );
+
+		for( size_t programIndex=0; programIndex<session.programs().size(); ++programIndex )
+		{
+			slot.kernels.push_back( session.createKernel( programIndex, session.input(), slot.output.buffer(), session.elementCount() ) );
+		}
+		slots_.push_back( std::move(slot) );
+	}
+}
+
+tools::AsyncSubmitter::Result tools::AsyncSubmitter::run( const void* pInput, size_t repetitions, const VerifyFunction& verify )
+{
+	cl_int error=CL_SUCCESS;
+	const size_t numberOfPrograms=session_.programs().size();
+	const size_t submissions=repetitions*numberOfPrograms;
+	const size_t numberOfSlots=slots_.size();
+	const size_t elementCount=session_.elementCount();
+
+	// All sized up front, because the verification thread and the callbacks use them while the loop below runs
+	std::vector<cl::Event> kernels(submissions), reads(submissions);
+	std::vector<cl::UserEvent> verified(submissions);
+	std::vector<CallbackData> callbackData(submissions);
+	completed_.clear();
+
+	Result result{ submissions, 0, 0, 0, outOfOrder_ };
+	size_t registered=0; // Number of reads with a callback, i.e. how many the verification thread should expect
+	bool registeringFinished=false;
+	std::string failure; // Set by the verification thread if anything went wrong
+
+	// Reset every slot's output before the clock starts, as is done for the synchronous comparison
+	for( const auto& slot : slots_ )
+	{
+		error=tools::trace::enqueueFillBuffer( queue_, slot.output.buffer(), tools::BufferPool::sentinelByte, 0, slot.hostOutput.size() );
+		if( error!=CL_SUCCESS ) throw std::runtime_error( "Error when filling a slot's output buffer" );
+	}
+	error=tools::trace::finish( queue_ );
+	if( error!=CL_SUCCESS ) throw std::runtime_error( "Error when waiting for the output fills to finish" );
+
+	tools::StopWatch wallClock;
+	std::thread verificationThread( [&]()
+	{
+		for( size_t verifiedCount=0; ; ++verifiedCount )
+		{
+			std::pair<size_t,cl_int> next;
+			{
+				std::unique_lock<std::mutex> lock( completedMutex_ );
+				completedCondition_.wait( lock, [&](){ return !completed_.empty() || (registeringFinished && verifiedCount==registered); } );
+				if( completed_.empty() ) break; // Everything that was registered has been verified
+				next=completed_.front();
+				completed_.pop_front();
+			}
+
+			const size_t submission=next.first;
+			if( next.second==CL_COMPLETE )
+			{
+				tools::StopWatch verifyClock;
+				try{ result.mismatches+=verify( submission%numberOfPrograms, slots_[submission%numberOfSlots].hostOutput.data() ); }
+				catch( std::exception& error ) { failure=std::string("Verification failed: ")+error.what(); }
+				result.verifyTime+=verifyClock.elapsed();
+			}
+			else failure="Submission "+std::to_string(submission)+" failed on the device with status "+std::to_string(next.second);
+			// Let the next read into this slot's host memory go ahead
+			verified[submission].setStatus( CL_COMPLETE );
+		}
+	} );
+
+	try
+	{
+		cl::Event writeEvent;
+		error=tools::trace::enqueueWriteBuffer( queue_, session_.input(), CL_FALSE, 0, session_.bytesPerElement()*elementCount, pInput, nullptr, &writeEvent );
+		if( error!=CL_SUCCESS ) throw std::runtime_error( "Error when copying input to the device" );
+
+		for( size_t submission=0; submission<submissions; ++submission )
+		{
+			const size_t programIndex=submission%numberOfPrograms;
+			Slot& slot=slots_[submission%numberOfSlots];
+			const tools::DeviceSession::Program& program=session_.programs()[programIndex];
+
+			// The output buffer is free once the last read from it has finished
+			std::vector<cl::Event> kernelWaitList( 1, writeEvent );
+			if( submission>=numberOfSlots ) kernelWaitList.push_back( reads[submission-numberOfSlots] );
+			error=tools::trace::enqueueNDRangeKernel( queue_, slot.kernels[programIndex], 0, tools::DeviceSession::globalRange( tools::DeviceSession::workItemCount( program, elementCount ), program.workGroupSize ),
+					tools::DeviceSession::localRange( program.workGroupSize ), &kernelWaitList, &kernels[submission] );
+			if( error!=CL_SUCCESS ) throw std::runtime_error( "Error when enqueing kernel - "+tools::enqueKernelError(error) );
+
+			// The host memory is free once the last output read into it has been verified
+			std::vector<cl::Event> readWaitList( 1, kernels[submission] );
+			if( submission>=numberOfSlots ) readWaitList.push_back( verified[submission-numberOfSlots] );
+			error=tools::trace::enqueueReadBuffer( queue_, slot.output.buffer(), CL_FALSE, 0, slot.hostOutput.size(), slot.hostOutput.data(), &readWaitList, &reads[submission] );
+			if( error!=CL_SUCCESS ) throw std::runtime_error( "Error when copying output from the device" );
+
+			verified[submission]=cl::UserEvent( session_.context(), &error );
+			if( error!=CL_SUCCESS ) throw std::runtime_error( "Error when creating a user event" );
+			callbackData[submission]=CallbackData{ this, submission };
+			// Not under the lock, because the callback can be called from within this if the read has already finished
+			error=reads[submission].setCallback( CL_COMPLETE, &AsyncSubmitter::readComplete, &callbackData[submission] );
+			if( error!=CL_SUCCESS ) throw std::runtime_error( "Error when setting the completion callback" );
+			{
+				std::lock_guard<std::mutex> lock( completedMutex_ );
+				++registered;
+			}
+			queue_.flush(); // Start the device on it straight away rather than waiting for everything to be enqueued
+		}
+	}
+	catch( ... )
+	{
+		// Let the verification thread finish off what did get registered, so that nothing is left waiting on a user event
+		{
+			std::lock_guard<std::mutex> lock( completedMutex_ );
+			registeringFinished=true;
+		}
+		completedCondition_.notify_all();
+		verificationThread.join();
+		tools::trace::finish( queue_ );
+		throw;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock( completedMutex_ );
+		registeringFinished=true;
+	}
+	completedCondition_.notify_all();
+	verificationThread.join();
+	tools::trace::finish( queue_ );
+	result.wallTime=wallClock.elapsed();
+
+	if( !failure.empty() ) throw std::runtime_error( failure );
+	return result;
+}
+
+bool tools::AsyncSubmitter::outOfOrder() const
+{
+	return outOfOrder_;
+}
+
+size_t tools::AsyncSubmitter::numberOfSlots() const
+{
+	return slots_.size();
+}
+
+void CL_CALLBACK tools::AsyncSubmitter::readComplete( cl_event /*event*/, cl_int status, void* pUserData )
+{
+	CallbackData* pData=static_cast<CallbackData*>(pUserData);
+	AsyncSubmitter& submitter=*pData->pSubmitter;
+	{
+		std::lock_guard<std::mutex> lock( submitter.completedMutex_ );
+		submitter.completed_.push_back( std::make_pair( pData->submission, status ) );
+	}
+	submitter.completedCondition_.notify_all();
+}
@@ -0,0 +1,96 @@
+#ifndef INCLUDEGUARD_tools_AsyncSubmitter_h
+#define INCLUDEGUARD_tools_AsyncSubmitter_h
+
+#include <vector>
+#include <deque>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <CL/cl.hpp>
+#include "BufferPool.h"
+
+//
+// Forward declarations
+//
+namespace tools
+{
+	class DeviceSession;
+}
+
+namespace tools
+{
+	/** @brief Submits every repetition of every one of a DeviceSession's programs up front, and verifies the results
+	 * on a host thread while the device carries on with the rest.
+	 *
+	 * Commands go on a queue created with CL_QUEUE_OUT_OF_ORDER_EXEC_MODE_ENABLE if the device supports it
+	 * (otherwise an in-order queue), with the ordering given entirely by event wait lists. Each submission
+	 * uses one of several slots, each with its own output buffer, kernels and host memory:
+	 *     kernel  - waits for the input upload, and for the previous read from this slot's output buffer.
+	 *     read    - waits for the kernel, and for the previous verification of this slot's host memory
+	 *               (a user event).
+	 * A clSetEventCallback on each read hands the finished submission to the verification thread, which
+	 * checks it and then completes the user event so the slot can be reused. The input is uploaded once
+	 * with enqueueWriteBuffer whatever the session's transfer strategy.
+	 */
+	class AsyncSubmitter
+	{
+	public:
+		struct Result
+		{
+			size_t submissions;
+			double wallTime; ///< @brief Host wall clock seconds from the first enqueue until everything is verified.
+			double verifyTime; ///< @brief Sum of the host seconds spent verifying, most of which overlaps with device work.
+			size_t mismatches; ///< @brief Total returned by the verify function over all submissions.
+			bool outOfOrder; ///< @brief False if the device doesn't support out-of-order queues.
+		};
+		/** @brief Checks the output of one submission of a program, returning the number of mismatches.
+		 * Only ever called from the one verification thread. */
+		typedef std::function<size_t(size_t programIndex, const void* pOutput)> VerifyFunction;
+
+		/** @brief Creates the queue, and the output buffers and kernels for each slot.
+		 *
+		 * @param numberOfSlots   How many submissions can be between starting the kernel and being verified at once.
+		 * @throw std::runtime_error     If any of the OpenCL calls fail.
+		 */
+		AsyncSubmitter( const tools::DeviceSession& session, size_t numberOfSlots=4 );
+
+		/** @brief Runs every program "repetitions" times on elementCount() elements from pInput.
+		 *
+		 * Each slot's output is filled with BufferPool::sentinelByte before the wall clock starts.
+		 *
+		 * @throw std::runtime_error     If anything can't be enqueued, or a command fails on the device.
+		 */
+		Result run( const void* pInput, size_t repetitions, const VerifyFunction& verify );
+
+		bool outOfOrder() const;
+		size_t numberOfSlots() const;
+	protected:
+		struct Slot
+		{
+			tools::PooledBuffer output;
+			std::vector<cl::Kernel> kernels; ///< @brief One per program, so that the buffer arguments only need setting once.
+			std::vector<char> hostOutput;
+		};
+		/** @brief What each read's callback is told, so that it knows which submission finished. */
+		struct CallbackData
+		{
+			AsyncSubmitter* pSubmitter;
+			size_t submission;
+		};
+		/** @brief Registered with clSetEventCallback on each read. Only queues the submission for the verification thread,
+		 * since callbacks should return promptly. */
+		static void CL_CALLBACK readComplete( cl_event event, cl_int status, void* pUserData );
+
+		const tools::DeviceSession& session_; ///< @brief Must outlive the submitter.
+		cl::CommandQueue queue_;
+		bool outOfOrder_;
+		std::vector<Slot> slots_;
+
+		std::mutex completedMutex_;
+		std::condition_variable completedCondition_;
+		std::deque<std::pair<size_t,cl_int> > completed_; ///< @brief Submission number and event status, waiting to be verified
+	};
+
+} // end of the tools namespace
+
+#endif
@@ -0,0 +1,142 @@
+#include "BandwidthBenchmark.h"
+
+#include <stdexcept>
+#include <algorithm>
+#include <ostream>
+#include <iomanip>
+#include <functional>
+#include "AlignedAllocator.h"
+#include "OpenCLEnums.h"
+#include "Timing.h"
+#include "Trace.h"
+
+//
+// Unnamed namespace for things only used in this file
+//
+namespace
+{
+	/** @brief Runs "operation" (which must block until done) "iterations" times and returns GB/s from the median time. */
+	double blockingThroughput( size_t bytes, size_t iterations, const std::function<void()>& operation )
+	{
+		operation(); // Warm up, e.g. so that lazy allocation of the device memory isn't timed
+		tools::TimingStatistics statistics;
+		for( size_t iteration=0; iteration<iterations; ++iteration )
+		{
+			tools::StopWatch stopWatch;
+			operation();
+			statistics.addSample( stopWatch.elapsed() );
+		}
+		return bytes/statistics.median()/1e9;
+	}
+
+	/** @brief Enqueues "operation" "iterations" times without waiting, then finishes the queue. Returns GB/s. */
+	double nonBlockingThroughput( size_t bytes, size_t iterations, const cl::CommandQueue& queue, const std::function<void()>& operation )
+	{
+		operation();
+		tools::trace::finish( queue );
+		tools::StopWatch stopWatch;
+		for( size_t iteration=0; iteration<iterations; ++iteration ) operation();
+		tools::trace::finish( queue );
+		return bytes*iterations/stopWatch.elapsed()/1e9;
+	}
+
+	void checkError( cl_int error, const std::string& message )
+	{
+		if( error!=CL_SUCCESS ) throw std::runtime_error( message );
+	}
+} // end of the unnamed namespace
+
+std::vector<tools::BandwidthResult> tools::measureBandwidth( const cl::Device& device, size_t minBytes, size_t maxBytes )
+{
+	cl_int error=CL_SUCCESS;
+	if( maxBytes==0 )
+	{
+		maxBytes=std::min<cl_ulong>( device.getInfo<CL_DEVICE_MAX_MEM_ALLOC_SIZE>(), device.getInfo<CL_DEVICE_GLOBAL_MEM_SIZE>()/2 );
+		maxBytes=std::min<size_t>( maxBytes, 1<<30 );
+	}
+	if( minBytes==0 || minBytes>maxBytes ) throw std::runtime_error( "Invalid range of transfer sizes for the bandwidth test" );
+
+	cl::Context context=tools::trace::createContext( device, &error );
+	if( error!=CL_SUCCESS ) throw std::runtime_error( "Error when creating context - "+tools::contextCreateError(error) );
+	cl::CommandQueue queue( context, device, 0, &error );
+	if( error!=CL_SUCCESS ) throw std::runtime_error( "Error when creating command queue - "+tools::createQueueError(error) );
+
+	std::vector<char,tools::AlignedAllocator<char> > hostMemory( maxBytes, 1 );
+
+	std::vector<BandwidthResult> results;
+	for( size_t bytes=minBytes; bytes<=maxBytes; bytes*=4 )
+	{
+		// Enough iterations to get a stable answer without taking forever for the big sizes
+		const size_t iterations=std::max<size_t>( 3, std::min<size_t>( 100, (size_t(64)<<20)/bytes ) );
+
+		cl::Buffer source=tools::trace::createBuffer( context, CL_MEM_READ_WRITE, bytes, nullptr, &error );
+		if( error!=CL_SUCCESS ) throw std::runtime_error( "Error when creating a buffer for the bandwidth test - "+tools::createBufferError(error) );
+		cl::Buffer destination=tools::trace::createBuffer( context, CL_MEM_READ_WRITE, bytes, nullptr, &error );
+		if( error!=CL_SUCCESS ) throw std::runtime_error( "Error when creating a buffer for the bandwidth test - "+tools::createBufferError(error) );
+
+		BandwidthResult result;
+		result.bytes=bytes;
+
+		result.writeBlocking=blockingThroughput( bytes, iterations, [&](){ checkError( tools::trace::enqueueWriteBuffer( queue, source, CL_TRUE, 0, bytes, hostMemory.data() ), "Error when writing a buffer" ); } );
+		result.writeNonBlocking=nonBlockingThroughput( bytes, iterations, queue, [&](){ checkError( tools::trace::enqueueWriteBuffer( queue, source, CL_FALSE, 0, bytes, hostMemory.data() ), "Error when writing a buffer" ); } );
+
+		result.readBlocking=blockingThroughput( bytes, iterations, [&](){ checkError( tools::trace::enqueueReadBuffer( queue, source, CL_TRUE, 0, bytes, hostMemory.data() ), "Error when reading a buffer" ); } );
+		result.readNonBlocking=nonBlockingThroughput( bytes, iterations, queue, [&](){ checkError( tools::trace::enqueueReadBuffer( queue, source, CL_FALSE, 0, bytes, hostMemory.data() ), "Error when reading a buffer" ); } );
+
+		result.copyBlocking=blockingThroughput( bytes, iterations, [&]()
+		{
+			cl::Event copyEvent;
+			checkError( tools::trace::enqueueCopyBuffer( queue, source, destination, 0, 0, bytes, nullptr, &copyEvent ), "Error when copying a buffer" );
+			copyEvent.wait();
+		} );
+		result.copyNonBlocking=nonBlockingThroughput( bytes, iterations, queue, [&](){ checkError( tools::trace::enqueueCopyBuffer( queue, source, destination, 0, 0, bytes ), "Error when copying a buffer" ); } );
+
+		result.mapBlocking=blockingThroughput( bytes, iterations, [&]()
+		{
+			cl_int mapError=CL_SUCCESS;
+			void* pMapped=tools::trace::enqueueMapBuffer( queue, source, CL_TRUE, CL_MAP_WRITE, 0, bytes, nullptr, nullptr, &mapError );
+			if( mapError!=CL_SUCCESS ) throw std::runtime_error( "Error when mapping a buffer - "+tools::mapBufferError(mapError) );
+			cl::Event unmapEvent;
+			checkError( tools::trace::enqueueUnmapMemObject( queue, source, pMapped, nullptr, &unmapEvent ), "Error when unmapping a buffer" );
+			unmapEvent.wait();
+		} );
+		result.mapNonBlocking=nonBlockingThroughput( bytes, iterations, queue, [&]()
+		{
+			// The unmap can't be enqueued until the mapped pointer is known, so the best that can be
+			// done is a non-blocking map immediately followed by the unmap.
+			cl_int mapError=CL_SUCCESS;
+			void* pMapped=tools::trace::enqueueMapBuffer( queue, source, CL_FALSE, CL_MAP_WRITE, 0, bytes, nullptr, nullptr, &mapError );
+			if( mapError!=CL_SUCCESS ) throw std::runtime_error( "Error when mapping a buffer - "+tools::mapBufferError(mapError) );
+			checkError( tools::trace::enqueueUnmapMemObject( queue, source, pMapped ), "Error when unmapping a buffer" );
+		} );
+
+		results.push_back( result );
+		if( bytes>maxBytes/4 ) break; // Stop before multiplying would overflow or overshoot
+	}
+
+	return results;
+}
+
+void tools::printBandwidth( const std::vector<BandwidthResult>& results, std::ostream& output, const std::string& indent )
+{
+	std::ios::fmtflags previousFlags=output.flags();
+	std::streamsize previousPrecision=output.precision();
+
+	const char* headings[]={ "bytes", "write", "write-nb", "read", "read-nb", "copy", "copy-nb", "map", "map-nb" };
+	output << indent << std::setw(12) << headings[0];
+	for( size_t index=1; index<sizeof(headings)/sizeof(headings[0]); ++index ) output << std::setw(10) << headings[index];
+	output << "   (GB/s, nb=non-blocking)" << "\n";
+
+	output << std::fixed << std::setprecision(2);
+	for( const auto& result : results )
+	{
+		output << indent << std::setw(12) << result.bytes
+				<< std::setw(10) << result.writeBlocking << std::setw(10) << result.writeNonBlocking
+				<< std::setw(10) << result.readBlocking << std::setw(10) << result.readNonBlocking
+				<< std::setw(10) << result.copyBlocking << std::setw(10) << result.copyNonBlocking
+				<< std::setw(10) << result.mapBlocking << std::setw(10) << result.mapNonBlocking << "\n";
+	}
+	output.flags( previousFlags );
+	output.precision( previousPrecision );
+	output << std::flush;
+}
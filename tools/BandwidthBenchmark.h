@@ -0,0 +1,45 @@
+#ifndef INCLUDEGUARD_tools_BandwidthBenchmark_h
+#define INCLUDEGUARD_tools_BandwidthBenchmark_h
+
+#include <vector>
+#include <string>
+#include <iosfwd>
+#include <CL/cl.hpp>
+
+namespace tools
+{
+	/** @brief Throughput in GB/s for each kind of transfer at one transfer size.
+	 *
+	 * The blocking variants issue one blocking call at a time and use the median host wall clock
+	 * time, i.e. what a caller that waits for each transfer sees. The non-blocking variants enqueue
+	 * a batch of transfers and time the batch until finish(). Copies count the bytes once, even
+	 * though they are both read and written.
+	 */
+	struct BandwidthResult
+	{
+		size_t bytes;
+		double writeBlocking;
+		double writeNonBlocking;
+		double readBlocking;
+		double readNonBlocking;
+		double copyBlocking; ///< @brief enqueueCopyBuffer between two buffers on the device
+		double copyNonBlocking;
+		double mapBlocking; ///< @brief enqueueMapBuffer for writing followed by enqueueUnmapMemObject
+		double mapNonBlocking;
+	};
+
+	/** @brief Measures host to device, device to host, on device copy and map/unmap throughput.
+	 *
+	 * Transfer sizes start at minBytes and go up by a factor of four until maxBytes. If maxBytes is
+	 * zero, the smallest of CL_DEVICE_MAX_MEM_ALLOC_SIZE, half of CL_DEVICE_GLOBAL_MEM_SIZE (there are
+	 * two device buffers) and 1 GiB is used.
+	 * @throw std::runtime_error     If any of the OpenCL calls fail.
+	 */
+	std::vector<BandwidthResult> measureBandwidth( const cl::Device& device, size_t minBytes=4096, size_t maxBytes=0 );
+
+	/** @brief Prints the results as a table, one row per transfer size. */
+	void printBandwidth( const std::vector<BandwidthResult>& results, std::ostream& output, const std::string& indent="   " );
+
+} // end of the tools namespace
+
+#endif
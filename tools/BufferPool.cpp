@@ -0,0 +1,199 @@
+#include "BufferPool.h"
+
+#include <stdexcept>
+#include <ostream>
+#include "OpenCLEnums.h"
+#include "Trace.h"
+
+const size_t tools::BufferPool::defaultMaxFreeBytes;
+const cl_uchar tools::BufferPool::sentinelByte;
+
+tools::PooledBuffer::PooledBuffer()
+	: pPool_(nullptr), context_(nullptr), flags_(0), classBytes_(0)
+{
+	// No operation besides the initialiser list
+}
+
+tools::PooledBuffer::PooledBuffer( const cl::Buffer& buffer )
+	: pPool_(nullptr), buffer_(buffer), context_(nullptr), flags_(0), classBytes_(0)
+{
+	// No operation besides the initialiser list
+}
+
+tools::PooledBuffer::PooledBuffer( BufferPool* pPool, const cl::Buffer& buffer, cl_context context, cl_mem_flags flags, size_t classBytes )
+	: pPool_(pPool), buffer_(buffer), context_(context), flags_(flags), classBytes_(classBytes)
+{
+	// No operation besides the initialiser list
+}
+
+tools::PooledBuffer::PooledBuffer( PooledBuffer&& other )
+	: pPool_(other.pPool_), buffer_(other.buffer_), context_(other.context_), flags_(other.flags_), classBytes_(other.classBytes_)
+{
+	other.pPool_=nullptr;
+	other.buffer_=cl::Buffer();
+}
+
+tools::PooledBuffer& tools::PooledBuffer::operator=( PooledBuffer&& other )
+{
+	if( &other!=this )
+	{
+		release();
+		pPool_=other.pPool_;
+		buffer_=other.buffer_;
+		context_=other.context_;
+		flags_=other.flags_;
+		classBytes_=other.classBytes_;
+		other.pPool_=nullptr;
+		other.buffer_=cl::Buffer();
+	}
+	return *this;
+}
+
+tools::PooledBuffer::~PooledBuffer()
+{
+	release();
+}
+
+const cl::Buffer& tools::PooledBuffer::buffer() const
+{
+	return buffer_;
+}
+
+void tools::PooledBuffer::release()
+{
+	if( pPool_ ) pPool_->giveBack( buffer_, context_, flags_, classBytes_ );
+	pPool_=nullptr;
+	buffer_=cl::Buffer();
+}
+
+tools::BufferPool::BufferPool( size_t maxFreeBytes )
+	: maxFreeBytes_(maxFreeBytes), statistics_{ 0, 0, 0, 0, 0, 0, 0, 0 }
+{
+	// No operation besides the initialiser list
+}
+
+cl::Context tools::BufferPool::context( const cl::Device& device )
+{
+	std::lock_guard<std::mutex> lock( mutex_ );
+	auto iFindResult=contexts_.find( device() );
+	if( iFindResult!=contexts_.end() ) return iFindResult->second;
+
+	cl_int error=CL_SUCCESS;
+	cl::Context newContext=tools::trace::createContext( device, &error );
+	if( error!=CL_SUCCESS ) throw std::runtime_error( "Error when creating context - "+tools::contextCreateError(error) );
+	contexts_[device()]=newContext;
+	return newContext;
+}
+
+tools::PooledBuffer tools::BufferPool::acquire( const cl::Context& context, cl_mem_flags flags, size_t bytes, void* pHostMemory, cl_int* pError,
+		const cl::CommandQueue* pFillQueue )
+{
+	if( pHostMemory!=nullptr || (flags & (CL_MEM_USE_HOST_PTR | CL_MEM_COPY_HOST_PTR)) )
+	{
+		{
+			std::lock_guard<std::mutex> lock( mutex_ );
+			++statistics_.requests;
+			++statistics_.unpooled;
+		}
+		return PooledBuffer( tools::trace::createBuffer( context, flags, bytes, pHostMemory, pError ) );
+	}
+
+	const size_t classBytes=sizeClass( bytes );
+	cl::Buffer buffer;
+	{
+		std::lock_guard<std::mutex> lock( mutex_ );
+		++statistics_.requests;
+		auto iFindResult=freeBuffers_.find( Key( context(), flags, classBytes ) );
+		if( iFindResult!=freeBuffers_.end() && !iFindResult->second.empty() )
+		{
+			buffer=iFindResult->second.back();
+			iFindResult->second.pop_back();
+			++statistics_.reused;
+			statistics_.bytesFree-=classBytes;
+			statistics_.bytesInUse+=classBytes;
+			if( statistics_.bytesInUse>statistics_.peakBytesInUse ) statistics_.peakBytesInUse=statistics_.bytesInUse;
+		}
+	}
+	if( buffer() )
+	{
+		// Not under the lock, since the fill has to be waited for
+		PooledBuffer reused( this, buffer, context(), flags, classBytes );
+		cl_int error=CL_SUCCESS;
+		if( pFillQueue )
+		{
+			error=tools::trace::enqueueFillBuffer( *pFillQueue, buffer, sentinelByte, 0, classBytes );
+			if( error==CL_SUCCESS ) error=tools::trace::finish( *pFillQueue );
+		}
+		if( pError ) *pError=error;
+		return ( error==CL_SUCCESS ? std::move(reused) : PooledBuffer() );
+	}
+
+	// Not under the lock, since creating the buffer can take a while
+	cl_int error=CL_SUCCESS;
+	buffer=tools::trace::createBuffer( context, flags, classBytes, nullptr, &error );
+	if( (error==CL_INVALID_BUFFER_SIZE || error==CL_MEM_OBJECT_ALLOCATION_FAILURE) && classBytes!=bytes )
+	{
+		// Rounding up took it over CL_DEVICE_MAX_MEM_ALLOC_SIZE or what is free, so try the exact size. That isn't
+		// a size class, so it could never be handed out again and isn't kept.
+		buffer=tools::trace::createBuffer( context, flags, bytes, nullptr, &error );
+		if( pError ) *pError=error;
+		if( error!=CL_SUCCESS ) return PooledBuffer();
+		std::lock_guard<std::mutex> lock( mutex_ );
+		++statistics_.unpooled;
+		return PooledBuffer( buffer );
+	}
+	if( pError ) *pError=error;
+	if( error!=CL_SUCCESS ) return PooledBuffer();
+
+	std::lock_guard<std::mutex> lock( mutex_ );
+	++statistics_.created;
+	statistics_.bytesInUse+=classBytes;
+	if( statistics_.bytesInUse>statistics_.peakBytesInUse ) statistics_.peakBytesInUse=statistics_.bytesInUse;
+	return PooledBuffer( this, buffer, context(), flags, classBytes );
+}
+
+void tools::BufferPool::clear()
+{
+	std::lock_guard<std::mutex> lock( mutex_ );
+	freeBuffers_.clear();
+	statistics_.bytesFree=0;
+}
+
+tools::BufferPool::Statistics tools::BufferPool::statistics() const
+{
+	std::lock_guard<std::mutex> lock( mutex_ );
+	return statistics_;
+}
+
+size_t tools::BufferPool::maxFreeBytes() const
+{
+	return maxFreeBytes_;
+}
+
+size_t tools::BufferPool::sizeClass( size_t bytes )
+{
+	size_t classBytes=1;
+	while( classBytes<bytes && classBytes*2!=0 ) classBytes*=2;
+	return ( classBytes<bytes ? bytes : classBytes );
+}
+
+void tools::BufferPool::giveBack( const cl::Buffer& buffer, cl_context context, cl_mem_flags flags, size_t classBytes )
+{
+	std::lock_guard<std::mutex> lock( mutex_ );
+	statistics_.bytesInUse-=classBytes;
+	if( statistics_.bytesFree+classBytes>maxFreeBytes_ )
+	{
+		++statistics_.dropped;
+		return; // The last reference goes with the caller's handle
+	}
+	freeBuffers_[Key( context, flags, classBytes )].push_back( buffer );
+	statistics_.bytesFree+=classBytes;
+}
+
+void tools::printBufferPool( const BufferPool& pool, std::ostream& output )
+{
+	const BufferPool::Statistics statistics=pool.statistics();
+	output << "Buffer pool: " << statistics.requests << " buffers requested, " << statistics.reused << " reused (allocations avoided), "
+			<< statistics.created << " created, " << statistics.unpooled << " on host memory, " << statistics.dropped << " released over the "
+			<< pool.maxFreeBytes()/(1024*1024) << " MiB limit, peak " << statistics.peakBytesInUse/(1024*1024) << " MiB in use." << std::endl;
+}
@@ -0,0 +1,127 @@
+#ifndef INCLUDEGUARD_tools_BufferPool_h
+#define INCLUDEGUARD_tools_BufferPool_h
+
+#include <vector>
+#include <map>
+#include <tuple>
+#include <mutex>
+#include <iosfwd>
+#include <CL/cl.hpp>
+
+//
+// Forward declarations
+//
+namespace tools
+{
+	class BufferPool;
+}
+
+namespace tools
+{
+	/** @brief A buffer handed out by a BufferPool, which is given back to the pool when this is destroyed.
+	 *
+	 * Can also hold a buffer that didn't come from a pool (e.g. one on host memory), which is simply released.
+	 * Move only, since only one owner can give the buffer back.
+	 */
+	class PooledBuffer
+	{
+	public:
+		PooledBuffer();
+		/** @brief Holds a buffer that isn't from a pool. */
+		explicit PooledBuffer( const cl::Buffer& buffer );
+		PooledBuffer( PooledBuffer&& other );
+		PooledBuffer& operator=( PooledBuffer&& other );
+		~PooledBuffer();
+
+		/** @brief The buffer itself, which can be larger than was asked for. */
+		const cl::Buffer& buffer() const;
+		/** @brief Gives the buffer back to the pool now, leaving this empty. */
+		void release();
+	protected:
+		friend class BufferPool;
+		PooledBuffer( BufferPool* pPool, const cl::Buffer& buffer, cl_context context, cl_mem_flags flags, size_t classBytes );
+		PooledBuffer( const PooledBuffer& other ) = delete;
+		PooledBuffer& operator=( const PooledBuffer& other ) = delete;
+
+		BufferPool* pPool_; ///< @brief Null if the buffer isn't pooled
+		cl::Buffer buffer_;
+		cl_context context_; ///< @brief Only used as part of the pool's key. The buffer keeps the context alive.
+		cl_mem_flags flags_;
+		size_t classBytes_;
+	};
+
+	/** @brief Reuses device buffers instead of creating and releasing one for every use.
+	 *
+	 * Requests are rounded up to a power of two size class, and a free buffer of the same context, memory
+	 * flags and size class is handed out if there is one, otherwise a new one is created. Reused buffers
+	 * skip both clCreateBuffer and the page faults of first touching the memory. When a PooledBuffer is
+	 * destroyed its buffer is kept for reuse, unless that would take the bytes held free over maxFreeBytes,
+	 * in which case it is released. Buffers on host memory (CL_MEM_USE_HOST_PTR or CL_MEM_COPY_HOST_PTR) can't
+	 * be reused, so are created as normal and only counted.
+	 *
+	 * Buffers can only be reused within a context, so the pool can also hand out one context per device for
+	 * everything to share. Safe to use from several threads at once. Must outlive every buffer it hands out.
+	 */
+	class BufferPool
+	{
+	public:
+		struct Statistics
+		{
+			size_t requests; ///< @brief Calls to acquire
+			size_t reused; ///< @brief Requests given a free buffer, i.e. allocations avoided
+			size_t created; ///< @brief Requests that had to create a buffer that can be pooled
+			size_t unpooled; ///< @brief Requests for buffers on host memory, or too big for their size class, which are never pooled
+			size_t dropped; ///< @brief Buffers released rather than kept, because of maxFreeBytes
+			size_t bytesInUse; ///< @brief Size class bytes of pooled buffers handed out and not given back yet
+			size_t peakBytesInUse;
+			size_t bytesFree; ///< @brief Bytes held for reuse
+		};
+
+		static const size_t defaultMaxFreeBytes=size_t(1)<<30;
+		/// @brief What reused buffers are filled with. All bits set is a NaN for both float and double, so stale
+		/// results from whoever had the buffer before can't pass for a kernel's output.
+		static const cl_uchar sentinelByte=0xff;
+
+		explicit BufferPool( size_t maxFreeBytes=defaultMaxFreeBytes );
+
+		/** @brief The context for the device that everything using this pool should share, created on first use.
+		 *
+		 * @throw std::runtime_error     If the context can't be created.
+		 */
+		cl::Context context( const cl::Device& device );
+
+		/** @brief A buffer of at least "bytes" bytes, reused if possible. Arguments and errors are as clCreateBuffer.
+		 *
+		 * If pFillQueue isn't null, a reused buffer is filled with sentinelByte on it before being handed out,
+		 * and the fill is waited for so that the buffer can be used on any queue.
+		 */
+		PooledBuffer acquire( const cl::Context& context, cl_mem_flags flags, size_t bytes, void* pHostMemory, cl_int* pError,
+				const cl::CommandQueue* pFillQueue=nullptr );
+
+		/** @brief Releases every free buffer. Buffers that are in use are unaffected. */
+		void clear();
+
+		Statistics statistics() const;
+		size_t maxFreeBytes() const;
+
+		/** @brief The smallest power of two that is at least "bytes". */
+		static size_t sizeClass( size_t bytes );
+	protected:
+		friend class PooledBuffer;
+		/** @brief Called by PooledBuffer to hand a buffer back. */
+		void giveBack( const cl::Buffer& buffer, cl_context context, cl_mem_flags flags, size_t classBytes );
+
+		typedef std::tuple<cl_context,cl_mem_flags,size_t> Key; ///< @brief Context, memory flags and size class
+		mutable std::mutex mutex_; ///< @brief Protects everything below
+		size_t maxFreeBytes_;
+		std::map<cl_device_id,cl::Context> contexts_;
+		std::map<Key,std::vector<cl::Buffer> > freeBuffers_;
+		Statistics statistics_;
+	};
+
+	/** @brief Prints how many buffers were requested and how many allocations were avoided, on one line. */
+	void printBufferPool( const BufferPool& pool, std::ostream& output );
+
+} // end of the tools namespace
+
+#endif
@@ -0,0 +1,98 @@
+#include "BuildVariants.h"
+
+#include <stdexcept>
+#include <ostream>
+#include <iomanip>
+
+std::vector<tools::BuildProfile> tools::defaultBuildProfiles()
+{
+	return std::vector<BuildProfile>{
+		BuildProfile{ "default", "" },
+		BuildProfile{ "mad", "-cl-mad-enable" },
+		BuildProfile{ "no-signed-zeros", "-cl-no-signed-zeros" },
+		BuildProfile{ "finite", "-cl-finite-math-only" },
+		BuildProfile{ "unsafe", "-cl-unsafe-math-optimizations" },
+		BuildProfile{ "fast", "-cl-fast-relaxed-math" }
+	};
+}
+
+std::vector<tools::BuildProfile> tools::buildProfilesFromString( const std::string& names )
+{
+	const std::vector<BuildProfile> allProfiles=defaultBuildProfiles();
+	if( names.empty() || names=="all" ) return allProfiles;
+
+	std::vector<BuildProfile> profiles( 1, allProfiles.front() );
+	size_t start=0;
+	while( start<=names.size() )
+	{
+		size_t comma=names.find( ',', start );
+		if( comma==std::string::npos ) comma=names.size();
+		const std::string name=names.substr( start, comma-start );
+		start=comma+1;
+		if( name.empty() || name==allProfiles.front().name ) continue;
+
+		bool found=false;
+		for( const auto& profile : allProfiles )
+		{
+			if( profile.name!=name ) continue;
+			profiles.push_back( profile );
+			found=true;
+		}
+		if( !found ) throw std::runtime_error( "Unknown build profile '"+name+"', expected default, mad, no-signed-zeros, finite, unsafe, fast or all" );
+	}
+	return profiles;
+}
+
+std::string tools::specialisationOptions( size_t elementCount, size_t workGroupSize )
+{
+	std::string options="-D ELEMENT_COUNT="+std::to_string(elementCount)+"UL";
+	if( workGroupSize!=0 ) options+=" -D WORK_GROUP_SIZE="+std::to_string(workGroupSize);
+	return options;
+}
+
+const tools::BuildVariantResult* tools::fastestPassingVariant( const std::vector<BuildVariantResult>& results )
+{
+	const BuildVariantResult* pFastest=nullptr;
+	for( const auto& result : results )
+	{
+		if( !result.failure.empty() || result.kernelTime<0 || result.mismatches!=0 ) continue;
+		if( pFastest==nullptr || result.kernelTime<pFastest->kernelTime ) pFastest=&result;
+	}
+	return pFastest;
+}
+
+void tools::printBuildVariants( const std::vector<BuildVariantResult>& results, std::ostream& output, const std::string& indent )
+{
+	std::ios::fmtflags previousFlags=output.flags();
+	std::streamsize previousPrecision=output.precision();
+
+	const double referenceTime=( results.empty() ? -1 : results.front().kernelTime );
+	output << indent << std::left << std::setw(18) << "profile" << std::setw(13) << "specialised" << std::right
+			<< std::setw(12) << "build ms" << std::setw(12) << "kernel us" << std::setw(10) << "speedup" << std::setw(12) << "mismatches" << "\n";
+	output << std::fixed;
+	for( const auto& result : results )
+	{
+		output << indent << std::left << std::setw(18) << result.profile << std::setw(13) << ( result.specialised ? "yes" : "no" ) << std::right;
+		if( !result.failure.empty() )
+		{
+			output << "   " << result.failure << "\n";
+			continue;
+		}
+		output << std::setprecision(1) << std::setw(12) << result.buildTime*1e3 << std::setw(12) << result.kernelTime*1e6;
+		if( referenceTime>0 && result.kernelTime>0 ) output << std::setprecision(2) << std::setw(10) << referenceTime/result.kernelTime;
+		else output << std::setw(10) << "-";
+		output << std::setw(12) << result.mismatches << "\n";
+	}
+
+	const BuildVariantResult* pFastest=fastestPassingVariant( results );
+	if( pFastest==nullptr ) output << indent << "No variant passed verification" << "\n";
+	else
+	{
+		output << indent << "Fastest passing variant: " << pFastest->profile << ( pFastest->specialised ? ", specialised" : "" );
+		if( !pFastest->options.empty() ) output << " (" << pFastest->options << ")";
+		output << "\n";
+	}
+	output.flags( previousFlags );
+	output.precision( previousPrecision );
+	output << std::flush;
+}
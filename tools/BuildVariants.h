@@ -0,0 +1,59 @@
+#ifndef INCLUDEGUARD_tools_BuildVariants_h
+#define INCLUDEGUARD_tools_BuildVariants_h
+
+#include <vector>
+#include <string>
+#include <iosfwd>
+
+namespace tools
+{
+	/** @brief A named set of build options to try a program with. */
+	struct BuildProfile
+	{
+		std::string name;
+		std::string options;
+	};
+
+	/** @brief The build option profiles tried by default:
+	 *     default            - no options
+	 *     mad                - -cl-mad-enable
+	 *     no-signed-zeros    - -cl-no-signed-zeros
+	 *     finite             - -cl-finite-math-only
+	 *     unsafe             - -cl-unsafe-math-optimizations (which implies mad and no-signed-zeros)
+	 *     fast               - -cl-fast-relaxed-math (unsafe and finite)
+	 */
+	std::vector<BuildProfile> defaultBuildProfiles();
+
+	/** @brief Parses a comma separated list of profile names from defaultBuildProfiles, e.g. "default,fast".
+	 *
+	 * "all" means every profile. The "default" profile is always included, first, since the others are compared with it.
+	 * @throw std::runtime_error     If a name is not recognised.
+	 */
+	std::vector<BuildProfile> buildProfilesFromString( const std::string& names );
+
+	/** @brief "-D" options that bake the element count and work group size into the square kernel
+	 * (see tools::squareKernelSource). A work group size of zero leaves it out. */
+	std::string specialisationOptions( size_t elementCount, size_t workGroupSize );
+
+	/** @brief How one build of a program did. */
+	struct BuildVariantResult
+	{
+		std::string profile; ///< @brief Name of the BuildProfile
+		bool specialised; ///< @brief Whether specialisationOptions were added
+		std::string options; ///< @brief The options the profile and specialisation added, not including any the program already had
+		double buildTime; ///< @brief Host seconds for clBuildProgram. Negative if the build failed.
+		double kernelTime; ///< @brief Median device seconds for the kernel. Negative if it wasn't run.
+		size_t mismatches; ///< @brief Wrong results, compared with the host.
+		std::string failure; ///< @brief Why the variant couldn't be built or run, empty if it could.
+	};
+
+	/** @brief The variant with the lowest kernel time that built, ran and had no mismatches. Null if none did. */
+	const BuildVariantResult* fastestPassingVariant( const std::vector<BuildVariantResult>& results );
+
+	/** @brief Prints one row per variant, with the kernel time relative to the first (unspecialised default) variant,
+	 * followed by which variant is fastest. */
+	void printBuildVariants( const std::vector<BuildVariantResult>& results, std::ostream& output, const std::string& indent="   " );
+
+} // end of the tools namespace
+
+#endif
@@ -0,0 +1,189 @@
+#include "ComputeBenchmark.h"
+
+#include <stdexcept>
+#include <sstream>
+#include <ostream>
+#include <iomanip>
+#include <algorithm>
+#include "OpenCLEnums.h"
+#include "Timing.h"
+#include "KernelGenerator.h"
+#include "Trace.h"
+#include "DeviceSession.h"
+
+//
+// Unnamed namespace for things only used in this file
+//
+namespace
+{
+	const size_t unrollFactor=16; ///< @brief How many steps of each chain are written out in the loop body
+	const size_t computeIterations=1024; ///< @brief Multiply-adds per chain for measureCompute
+	const size_t totalLanes=1<<20; ///< @brief Work items times vector width for measureCompute, so each width does the same work
+
+	size_t scalarSize( const std::string& type )
+	{
+		if( type=="double" ) return 8;
+		else if( type=="half" ) return 2;
+		else return 4;
+	}
+
+	bool hasExtension( const cl::Device& device, const std::string& extension )
+	{
+		const std::string extensions=" "+device.getInfo<CL_DEVICE_EXTENSIONS>()+" ";
+		return extensions.find( " "+extension+" " )!=std::string::npos;
+	}
+
+	/** @brief Builds and runs one configuration, returning the best time in seconds over a few runs. */
+	double timeComputeKernel( const cl::Context& context, const cl::Device& device, const cl::CommandQueue& queue, const std::string& type,
+			size_t vectorWidth, size_t chains, size_t globalSize )
+	{
+		cl_int error=CL_SUCCESS;
+		const cl::Program program=tools::DeviceSession::buildProgram( context, device, tools::computeKernelSource( type, vectorWidth, chains, computeIterations ),
+				std::vector<char>(), "", "compute "+type );
+		cl::Kernel kernel( program, "compute", &error );
+		if( error!=CL_SUCCESS ) throw std::runtime_error( "Error when creating kernel 'compute' - "+tools::createKernelError(error) );
+
+		cl::Buffer output=tools::trace::createBuffer( context, CL_MEM_WRITE_ONLY, globalSize*vectorWidth*scalarSize(type), nullptr, &error );
+		if( error!=CL_SUCCESS ) throw std::runtime_error( "Error when creating the output buffer - "+tools::createBufferError(error) );
+		error=kernel.setArg( 0, output );
+		if( error!=CL_SUCCESS ) throw std::runtime_error( "Error when setting kernel argument 0: "+tools::setKernelArgError(error) );
+
+		double bestTime=-1;
+		for( size_t run=0; run<4; ++run )
+		{
+			cl::Event kernelEvent;
+			error=tools::trace::enqueueNDRangeKernel( queue, kernel, cl::NullRange, cl::NDRange(globalSize), cl::NullRange, nullptr, &kernelEvent );
+			if( error!=CL_SUCCESS ) throw std::runtime_error( "Error when enqueing kernel - "+tools::enqueKernelError(error) );
+			kernelEvent.wait();
+			if( run==0 ) continue; // Warm up
+			double time=tools::eventDuration(kernelEvent);
+			if( bestTime<0 || time<bestTime ) bestTime=time;
+		}
+		return bestTime;
+	}
+} // end of the unnamed namespace
+
+std::string tools::computeKernelSource( const std::string& type, size_t vectorWidth, size_t chains, size_t iterations )
+{
+	const std::string vectorType=( vectorWidth==1 ? type : type+std::to_string(vectorWidth) );
+	std::string a, b;
+	if( type=="int" ) { a="3"; b="1"; }
+	else if( type=="double" ) { a="0.999"; b="0.001"; }
+	else if( type=="half" ) { a="(half)0.999f"; b="(half)0.001f"; }
+	else { a="0.999f"; b="0.001f"; }
+
+	std::stringstream source;
+	if( type=="double" ) source << "#pragma OPENCL EXTENSION cl_khr_fp64 : enable\n";
+	else if( type=="half" ) source << "#pragma OPENCL EXTENSION cl_khr_fp16 : enable\n";
+	source << "__kernel void compute( __global " << vectorType << "* output )\n"
+			<< "{\n"
+			<< "	const " << vectorType << " a=(" << vectorType << ")(" << a << ");\n"
+			<< "	const " << vectorType << " b=(" << vectorType << ")(" << b << ");\n";
+	// Start each chain from a different value that the compiler can't know in advance
+	for( size_t chain=0; chain<chains; ++chain )
+	{
+		source << "	" << vectorType << " x" << chain << "=(" << vectorType << ")((" << type << ")(get_global_id(0)+" << chain << "));\n";
+	}
+	source << "	for( int i=0; i<" << std::max<size_t>( 1, iterations/unrollFactor ) << "; ++i )\n"
+			<< "	{\n";
+	for( size_t step=0; step<unrollFactor; ++step )
+	{
+		source << "		";
+		for( size_t chain=0; chain<chains; ++chain )
+		{
+			if( type=="int" ) source << "x" << chain << "=x" << chain << "*a+b; ";
+			else source << "x" << chain << "=mad(x" << chain << ",a,b); ";
+		}
+		source << "\n";
+	}
+	source << "	}\n"
+			<< "	output[get_global_id(0)]=x0";
+	for( size_t chain=1; chain<chains; ++chain ) source << "+x" << chain;
+	source << ";\n"
+			<< "}\n";
+	return source.str();
+}
+
+double tools::computeKernelOperations( size_t vectorWidth, size_t chains, size_t iterations )
+{
+	const size_t loopCount=std::max<size_t>( 1, iterations/unrollFactor );
+	return 2.0*vectorWidth*chains*loopCount*unrollFactor;
+}
+
+std::vector<tools::ComputeResult> tools::measureCompute( const cl::Device& device )
+{
+	cl_int error=CL_SUCCESS;
+	cl::Context context=tools::trace::createContext( device, &error );
+	if( error!=CL_SUCCESS ) throw std::runtime_error( "Error when creating context - "+tools::contextCreateError(error) );
+	cl::CommandQueue queue( context, device, CL_QUEUE_PROFILING_ENABLE, &error );
+	if( error!=CL_SUCCESS ) throw std::runtime_error( "Error when creating command queue - "+tools::createQueueError(error) );
+
+	std::vector<std::string> types{ "float", "int" };
+	if( hasExtension( device, "cl_khr_fp64" ) ) types.push_back( "double" );
+	if( hasExtension( device, "cl_khr_fp16" ) ) types.push_back( "half" );
+
+	std::vector<ComputeResult> results;
+	for( const auto& type : types )
+	{
+		for( const size_t chains : { size_t(1), size_t(8) } )
+		{
+			for( const size_t vectorWidth : { size_t(1), size_t(2), size_t(4), size_t(8), size_t(16) } )
+			{
+				ComputeResult result{ type, vectorWidth, chains, -1 };
+				const size_t globalSize=totalLanes/vectorWidth;
+				try
+				{
+					double time=timeComputeKernel( context, device, queue, type, vectorWidth, chains, globalSize );
+					if( time>0 ) result.gigaOpsPerSecond=computeKernelOperations( vectorWidth, chains, computeIterations )*globalSize/time/1e9;
+				}
+				catch( std::exception& ) { /* Leave it marked as failed */ }
+				results.push_back( result );
+			}
+		}
+	}
+	return results;
+}
+
+double tools::measurePeakCompute( const cl::Device& device )
+{
+	cl_int error=CL_SUCCESS;
+	cl::Context context=tools::trace::createContext( device, &error );
+	if( error!=CL_SUCCESS ) throw std::runtime_error( "Error when creating context - "+tools::contextCreateError(error) );
+	cl::CommandQueue queue( context, device, CL_QUEUE_PROFILING_ENABLE, &error );
+	if( error!=CL_SUCCESS ) throw std::runtime_error( "Error when creating command queue - "+tools::createQueueError(error) );
+
+	const size_t vectorWidth=tools::preferredVectorWidth( device );
+	const size_t chains=8;
+	const size_t globalSize=totalLanes/vectorWidth;
+	double time=timeComputeKernel( context, device, queue, "float", vectorWidth, chains, globalSize );
+	if( time<=0 ) throw std::runtime_error( "The compute kernel took no time" );
+	return computeKernelOperations( vectorWidth, chains, computeIterations )*globalSize/time/1e9;
+}
+
+void tools::printCompute( const std::vector<ComputeResult>& results, std::ostream& output, const std::string& indent )
+{
+	std::ios::fmtflags previousFlags=output.flags();
+	std::streamsize previousPrecision=output.precision();
+
+	const size_t widths[]={ 1, 2, 4, 8, 16 };
+	output << indent << std::setw(8) << "type" << std::setw(8) << "chains";
+	for( const auto width : widths ) output << std::setw(10) << ( "x"+std::to_string(width) );
+	output << "   (GFLOPS, GIOPS for int)" << "\n";
+
+	output << std::fixed << std::setprecision(1);
+	// Results are grouped by type and chain count, with the vector widths in order
+	for( size_t index=0; index<results.size(); )
+	{
+		const auto& first=results[index];
+		output << indent << std::setw(8) << first.type << std::setw(8) << first.chains;
+		for( ; index<results.size() && results[index].type==first.type && results[index].chains==first.chains; ++index )
+		{
+			if( results[index].gigaOpsPerSecond<0 ) output << std::setw(10) << "-";
+			else output << std::setw(10) << results[index].gigaOpsPerSecond;
+		}
+		output << "\n";
+	}
+	output.flags( previousFlags );
+	output.precision( previousPrecision );
+	output << std::flush;
+}
@@ -0,0 +1,52 @@
+#ifndef INCLUDEGUARD_tools_ComputeBenchmark_h
+#define INCLUDEGUARD_tools_ComputeBenchmark_h
+
+#include <vector>
+#include <string>
+#include <iosfwd>
+#include <CL/cl.hpp>
+
+namespace tools
+{
+	/** @brief Throughput of one configuration of the compute benchmark. */
+	struct ComputeResult
+	{
+		std::string type; ///< @brief The scalar type, "float", "double", "half" or "int".
+		size_t vectorWidth;
+		size_t chains; ///< @brief Number of independent chains of operations per work item. 1 means every operation depends on the last.
+		double gigaOpsPerSecond; ///< @brief A multiply-add counts as two operations. Negative if the configuration couldn't be run.
+	};
+
+	/** @brief OpenCL C source for a kernel called "compute" that runs chains of multiply-adds.
+	 *
+	 * Each work item runs "chains" interleaved chains, each "iterations" multiply-adds long, on
+	 * vectors of "vectorWidth" elements of "type", then writes the sum of the chains to
+	 * "output[get_global_id(0)]" so that the compiler can't remove the work. The signature is
+	 * compute( __global <type><vectorWidth>* output ).
+	 */
+	std::string computeKernelSource( const std::string& type, size_t vectorWidth, size_t chains, size_t iterations );
+
+	/** @brief Number of operations one work item of computeKernelSource performs. */
+	double computeKernelOperations( size_t vectorWidth, size_t chains, size_t iterations );
+
+	/** @brief Runs the compute kernel for float, int, double (if cl_khr_fp64 is supported) and half (if cl_khr_fp16
+	 * is supported), at vector widths 1, 2, 4, 8 and 16, with both dependent and independent chains.
+	 *
+	 * @throw std::runtime_error     If the context or queue can't be created. Failures for individual
+	 *                               configurations are recorded as a negative throughput instead.
+	 */
+	std::vector<ComputeResult> measureCompute( const cl::Device& device );
+
+	/** @brief A quick estimate of peak float throughput in GFLOPS, using only the device's preferred vector width
+	 * with independent chains, rather than the whole table from measureCompute.
+	 *
+	 * @throw std::runtime_error     If the context, queue or kernel can't be created or run.
+	 */
+	double measurePeakCompute( const cl::Device& device );
+
+	/** @brief Prints the results as a table, one row per type and chain count, one column per vector width. */
+	void printCompute( const std::vector<ComputeResult>& results, std::ostream& output, const std::string& indent="   " );
+
+} // end of the tools namespace
+
+#endif
@@ -0,0 +1,198 @@
+#include "DeviceSelector.h"
+
+#include <stdexcept>
+#include <fstream>
+#include <sstream>
+#include <ostream>
+#include <iomanip>
+#include <limits>
+#include <cstdlib>
+#include <algorithm>
+#include "BandwidthBenchmark.h"
+#include "ComputeBenchmark.h"
+
+//
+// Unnamed namespace for things only used in this file
+//
+namespace
+{
+	const size_t calibrationBytes=16<<20; ///< @brief Transfer size for the bandwidth part of the calibration
+} // end of the unnamed namespace
+
+tools::WorkloadProfile tools::WorkloadProfile::fromString( const std::string& description )
+{
+	if( description=="transfer" ) return WorkloadProfile{ description, 0.125, true };
+	else if( description=="memory" ) return WorkloadProfile{ description, 0.125, false };
+	else if( description=="compute" ) return WorkloadProfile{ description, 64, false };
+
+	const std::string transferSuffix=":transfer";
+	std::string number=description;
+	bool includeTransfers=false;
+	if( number.size()>transferSuffix.size() && number.compare( number.size()-transferSuffix.size(), std::string::npos, transferSuffix )==0 )
+	{
+		number=number.substr( 0, number.size()-transferSuffix.size() );
+		includeTransfers=true;
+	}
+
+	size_t charactersUsed=0;
+	double operationsPerByte=-1;
+	try{ operationsPerByte=std::stod( number, &charactersUsed ); }
+	catch( std::exception& error ) { /* Reported below */ }
+	if( charactersUsed!=number.size() || operationsPerByte<0 )
+	{
+		throw std::runtime_error( "Workload profile '"+description+"' should be 'transfer', 'memory', 'compute' or <operations per byte>[:transfer]" );
+	}
+	return WorkloadProfile{ description, operationsPerByte, includeTransfers };
+}
+
+double tools::WorkloadProfile::predictedThroughput( const DeviceScores& scores ) const
+{
+	const double bandwidth=( includeTransfers ? scores.transferBandwidth : scores.deviceBandwidth );
+	if( bandwidth<=0 || scores.compute<=0 ) return 0;
+	return 1.0/( 1.0/bandwidth + operationsPerByte/scores.compute );
+}
+
+tools::DeviceScoreTable::DeviceScoreTable( const std::string& filename )
+	: filename_(filename)
+{
+	std::ifstream inputFile( filename_ );
+	std::string line;
+	while( std::getline( inputFile, line ) )
+	{
+		std::stringstream lineStream( line );
+		DeviceScores scores;
+		std::string platform, name, driver;
+		lineStream >> scores.transferBandwidth >> scores.deviceBandwidth >> scores.compute;
+		lineStream.ignore(); // The tab before the platform
+		if( !lineStream || !std::getline( lineStream, platform, '\t' ) || !std::getline( lineStream, name, '\t' ) || !std::getline( lineStream, driver ) ) continue; // Ignore any corrupt lines
+		entries_[platform+"\t"+name+"\t"+driver]=scores;
+	}
+}
+
+void tools::DeviceScoreTable::save() const
+{
+	std::ofstream outputFile( filename_ );
+	if( !outputFile.is_open() ) throw std::runtime_error( "Unable to write device scores to '"+filename_+"'" );
+	for( const auto& entry : entries_ )
+	{
+		outputFile << entry.second.transferBandwidth << "\t" << entry.second.deviceBandwidth << "\t" << entry.second.compute << "\t" << entry.first << "\n";
+	}
+}
+
+bool tools::DeviceScoreTable::lookup( const cl::Device& device, DeviceScores& scores ) const
+{
+	const auto iFindResult=entries_.find( key(device) );
+	if( iFindResult==entries_.end() ) return false;
+	scores=iFindResult->second;
+	return true;
+}
+
+void tools::DeviceScoreTable::set( const cl::Device& device, const DeviceScores& scores )
+{
+	entries_[key(device)]=scores;
+}
+
+const std::string& tools::DeviceScoreTable::filename() const
+{
+	return filename_;
+}
+
+std::string tools::DeviceScoreTable::defaultFilename()
+{
+	const char* home=std::getenv("HOME");
+	if( home==nullptr ) return ".checkOpenCL.devicescores";
+	else return std::string(home)+"/.checkOpenCL.devicescores";
+}
+
+std::string tools::DeviceScoreTable::key( const cl::Device& device )
+{
+	const cl::Platform platform( device.getInfo<CL_DEVICE_PLATFORM>() );
+	return platform.getInfo<CL_PLATFORM_NAME>()+"\t"+device.getInfo<CL_DEVICE_NAME>()+"\t"+device.getInfo<CL_DRIVER_VERSION>();
+}
+
+tools::DeviceScores tools::calibrateDevice( const cl::Device& device )
+{
+	size_t bytes=std::min<cl_ulong>( calibrationBytes, device.getInfo<CL_DEVICE_MAX_MEM_ALLOC_SIZE>() );
+	const std::vector<BandwidthResult> bandwidths=tools::measureBandwidth( device, bytes, bytes );
+	if( bandwidths.empty() ) throw std::runtime_error( "The bandwidth calibration gave no results" );
+
+	DeviceScores scores;
+	scores.transferBandwidth=( bandwidths.back().writeBlocking+bandwidths.back().readBlocking )/2;
+	scores.deviceBandwidth=bandwidths.back().copyBlocking;
+	scores.compute=tools::measurePeakCompute( device );
+	return scores;
+}
+
+tools::BenchmarkDeviceSelector::BenchmarkDeviceSelector( const WorkloadProfile& profile, const std::string& scoreFilename )
+	: profile_(profile), table_(scoreFilename)
+{
+	// No operation besides the initialiser list
+}
+
+int tools::BenchmarkDeviceSelector::operator()( const cl::Device& device ) const
+{
+	if( !device.getInfo<CL_DEVICE_AVAILABLE>() ) return -1;
+
+	DeviceScores deviceScores;
+	try{ deviceScores=scores( device ); }
+	catch( std::exception& error ) { return -1; }
+
+	const double megabytesPerSecond=profile_.predictedThroughput( deviceScores )*1e3;
+	return static_cast<int>( std::min<double>( megabytesPerSecond, std::numeric_limits<int>::max() ) );
+}
+
+std::vector<size_t> tools::BenchmarkDeviceSelector::rank( const std::vector<cl::Device>& devices ) const
+{
+	std::vector<std::pair<int,size_t> > scoredDevices;
+	for( size_t index=0; index<devices.size(); ++index )
+	{
+		const int score=(*this)( devices[index] );
+		if( score>=0 ) scoredDevices.push_back( std::make_pair( score, index ) );
+	}
+	// Stable so that equal scores keep the platform order
+	std::stable_sort( scoredDevices.begin(), scoredDevices.end(), []( const std::pair<int,size_t>& a, const std::pair<int,size_t>& b ){ return a.first>b.first; } );
+
+	std::vector<size_t> ranking;
+	for( const auto& scoredDevice : scoredDevices ) ranking.push_back( scoredDevice.second );
+	return ranking;
+}
+
+tools::DeviceScores tools::BenchmarkDeviceSelector::scores( const cl::Device& device ) const
+{
+	DeviceScores deviceScores;
+	if( !table_.lookup( device, deviceScores ) )
+	{
+		deviceScores=calibrateDevice( device );
+		table_.set( device, deviceScores );
+		// The table is only a cache, so not being able to save it just means calibrating again next time
+		try{ table_.save(); }
+		catch( std::exception& error ) { /* Ignore */ }
+	}
+	return deviceScores;
+}
+
+const tools::WorkloadProfile& tools::BenchmarkDeviceSelector::profile() const
+{
+	return profile_;
+}
+
+void tools::printDeviceRanking( const std::vector<cl::Device>& devices, const std::vector<size_t>& ranking, const BenchmarkDeviceSelector& selector,
+		std::ostream& output, const std::string& indent )
+{
+	std::ios::fmtflags previousFlags=output.flags();
+	std::streamsize previousPrecision=output.precision();
+
+	output << indent << std::setw(8) << "device" << std::setw(14) << "transfer GB/s" << std::setw(14) << "device GB/s" << std::setw(10) << "GFLOPS"
+			<< std::setw(16) << "predicted GB/s" << "   name" << "\n";
+	output << std::fixed << std::setprecision(1);
+	for( const auto index : ranking )
+	{
+		const DeviceScores deviceScores=selector.scores( devices[index] );
+		output << indent << std::setw(8) << index << std::setw(14) << deviceScores.transferBandwidth << std::setw(14) << deviceScores.deviceBandwidth
+				<< std::setw(10) << deviceScores.compute << std::setw(16) << selector.profile().predictedThroughput( deviceScores )
+				<< "   " << devices[index].getInfo<CL_DEVICE_NAME>() << "\n";
+	}
+	output.flags( previousFlags );
+	output.precision( previousPrecision );
+	output << std::flush;
+}
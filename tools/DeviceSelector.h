@@ -0,0 +1,109 @@
+#ifndef INCLUDEGUARD_tools_DeviceSelector_h
+#define INCLUDEGUARD_tools_DeviceSelector_h
+
+#include <vector>
+#include <string>
+#include <map>
+#include <iosfwd>
+#include <CL/cl.hpp>
+
+namespace tools
+{
+	/** @brief Results of the short calibration benchmarks for one device. */
+	struct DeviceScores
+	{
+		double transferBandwidth; ///< @brief GB/s, the mean of blocking host to device and device to host
+		double deviceBandwidth; ///< @brief GB/s, enqueueCopyBuffer between two device buffers
+		double compute; ///< @brief GFLOPS, from tools::measurePeakCompute
+	};
+
+	/** @brief The kind of work a device is being chosen for.
+	 *
+	 * The predicted throughput is from a simple model where moving the data and doing the arithmetic
+	 * don't overlap: the time per byte is 1/bandwidth + operationsPerByte/compute. The bandwidth is
+	 * the host transfer bandwidth if includeTransfers is true, otherwise the on device bandwidth.
+	 */
+	struct WorkloadProfile
+	{
+		std::string name;
+		double operationsPerByte;
+		bool includeTransfers; ///< @brief True if the data has to be copied to and from the host for every run
+
+		/** @brief Parses one of the named profiles, or "<operations per byte>" with an optional ":transfer" suffix.
+		 *
+		 * transfer  - 0.125 operations per byte including host transfers (e.g. the test kernel, one multiply per 8 bytes).
+		 * memory    - 0.125 operations per byte on data already on the device.
+		 * compute   - 64 operations per byte on data already on the device.
+		 * @throw std::runtime_error     If the string is not one of those forms.
+		 */
+		static WorkloadProfile fromString( const std::string& description );
+		/** @brief Predicted GB/s of input processed for a device with these scores. */
+		double predictedThroughput( const DeviceScores& scores ) const;
+	};
+
+	/** @brief DeviceScores for each platform, device and driver version, stored in a small text file.
+	 *
+	 * Each line of the file is tab separated: transfer bandwidth, device bandwidth, compute, platform name,
+	 * device name, driver version. The same device name can be on more than one platform, and keying on the
+	 * driver version means a driver upgrade gets recalibrated.
+	 */
+	class DeviceScoreTable
+	{
+	public:
+		/** @brief Loads the file if it exists. A missing file is just an empty table. */
+		explicit DeviceScoreTable( const std::string& filename );
+		/** @brief Writes the whole table back to the file.
+		 *
+		 * @throw std::runtime_error     If the file can't be written.
+		 */
+		void save() const;
+		/** @brief Returns true and sets "scores" if there is an entry, otherwise returns false. */
+		bool lookup( const cl::Device& device, DeviceScores& scores ) const;
+		void set( const cl::Device& device, const DeviceScores& scores );
+		const std::string& filename() const;
+		/** @brief Default file used if none is given on the command line, "$HOME/.checkOpenCL.devicescores". */
+		static std::string defaultFilename();
+	protected:
+		static std::string key( const cl::Device& device );
+		std::string filename_;
+		std::map<std::string,DeviceScores> entries_; ///< @brief Keyed by the tab separated platform name, device name and driver version.
+	};
+
+	/** @brief Runs the calibration benchmarks: one 16 MiB round of measureBandwidth plus measurePeakCompute.
+	 *
+	 * @throw std::runtime_error     If any of the benchmarks fail.
+	 */
+	DeviceScores calibrateDevice( const cl::Device& device );
+
+	/** @brief Ranks devices by their predicted throughput for a workload, calibrating any that aren't
+	 * in the score table yet.
+	 *
+	 * operator() follows the cl::sycl::device_selector convention (higher is better, negative means
+	 * never use) so that it can be wrapped for SYCL, see tools/SyclDeviceSelector.h.
+	 */
+	class BenchmarkDeviceSelector
+	{
+	public:
+		BenchmarkDeviceSelector( const WorkloadProfile& profile, const std::string& scoreFilename=DeviceScoreTable::defaultFilename() );
+		/** @brief The predicted throughput in MB/s, or -1 if the device is unavailable or couldn't be calibrated. */
+		int operator()( const cl::Device& device ) const;
+		/** @brief Indices into "devices" in order of decreasing score, leaving out devices that can't be used. */
+		std::vector<size_t> rank( const std::vector<cl::Device>& devices ) const;
+		/** @brief The scores from the table, calibrating and saving them first if needed.
+		 *
+		 * @throw std::runtime_error     If the device can't be calibrated.
+		 */
+		DeviceScores scores( const cl::Device& device ) const;
+		const WorkloadProfile& profile() const;
+	protected:
+		WorkloadProfile profile_;
+		mutable DeviceScoreTable table_; ///< @brief Mutable because scores are filled in lazily by the const selection methods
+	};
+
+	/** @brief Prints the scores and predicted throughput of the ranked devices as a table, best first. */
+	void printDeviceRanking( const std::vector<cl::Device>& devices, const std::vector<size_t>& ranking, const BenchmarkDeviceSelector& selector,
+			std::ostream& output, const std::string& indent="   " );
+
+} // end of the tools namespace
+
+#endif
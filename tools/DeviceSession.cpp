@@ -0,0 +1,340 @@
+#include "DeviceSession.h"
+
+#include <stdexcept>
+#include <cstring>
+#include "OpenCLEnums.h"
+#include "Timing.h"
+#include "Trace.h"
+#include "ProgramCache.h"
+#include "WorkGroupTuner.h"
+#include "KernelGenerator.h"
+
+//
+// Unnamed namespace for things only used in this file
+//
+namespace
+{
+	/// @brief Work groups per compute unit that grid stride kernels are launched with. More than one so
+	/// that a compute unit has something else to do while a group waits on memory.
+	const size_t gridStrideGroupsPerComputeUnit=4;
+} // end of the unnamed namespace
+
+const size_t tools::DeviceSession::ProgramSource::DeviceVectorWidth;
+
+
+tools::DeviceSession::DeviceSession( const cl::Device& device, const std::vector<ProgramSource>& programSources, size_t elementCount,
+		size_t bytesPerElement, const Settings& settings )
+	: device_(device), pBufferPool_(settings.pBufferPool), elementCount_(elementCount), bytesPerElement_(bytesPerElement),
+	  profilingEnabled_(settings.enableProfiling), transferStrategy_(settings.transferStrategy)
+{
+	cl_int error=CL_SUCCESS;
+
+	tools::StopWatch stopWatch;
+	if( pBufferPool_ ) context_=pBufferPool_->context( device_ );
+	else
+	{
+		context_=tools::trace::createContext( device_, &error );
+		if( error!=CL_SUCCESS ) throw std::runtime_error( "Error when creating context - "+tools::contextCreateError(error) );
+	}
+	if( settings.pTimings ) settings.pTimings->phase( "context" ).addSample( stopWatch.elapsed() );
+
+	queue_=cl::CommandQueue( context_, device_, settings.enableProfiling ? CL_QUEUE_PROFILING_ENABLE : 0, &error );
+	if( error!=CL_SUCCESS ) throw std::runtime_error( "Error when creating command queue - "+tools::createQueueError(error) );
+
+	cl_mem_flags extraFlags=0;
+	void* pInputHostMemory=nullptr;
+	void* pOutputHostMemory=nullptr;
+	if( transferStrategy_==UseHostPointer )
+	{
+		if( settings.pHostInput==nullptr || settings.pHostOutput==nullptr ) throw std::runtime_error( "DeviceSession was asked to use host pointers but none were supplied" );
+		extraFlags=CL_MEM_USE_HOST_PTR;
+		// OpenCL takes a non-const pointer, but it's only ever read from because the buffer is CL_MEM_READ_ONLY
+		pInputHostMemory=const_cast<void*>(settings.pHostInput);
+		pOutputHostMemory=settings.pHostOutput;
+	}
+	else if( transferStrategy_==AllocHostPointer || transferStrategy_==MapInvalidate ) extraFlags=CL_MEM_ALLOC_HOST_PTR;
+
+	input_=createBuffer( CL_MEM_READ_ONLY | extraFlags, bytesPerElement_*elementCount_, pInputHostMemory, &error );
+	if( error!=CL_SUCCESS ) throw std::runtime_error( "Error when creating the input buffer - "+tools::createBufferError(error) );
+	output_=createBuffer( CL_MEM_WRITE_ONLY | extraFlags, bytesPerElement_*elementCount_, pOutputHostMemory, &error );
+	if( error!=CL_SUCCESS ) throw std::runtime_error( "Error when creating the output buffer - "+tools::createBufferError(error) );
+
+	for( const auto& programSource : programSources )
+	{
+		Program newProgram;
+		newProgram.name=programSource.name;
+		newProgram.vectorWidth=1;
+		newProgram.maxWorkItems=0;
+
+		newProgram.buildOptions=programSource.buildOptions;
+		if( programSource.vectorWidth!=0 )
+		{
+			if( programSource.vectorWidth==ProgramSource::DeviceVectorWidth ) newProgram.vectorWidth=tools::preferredVectorWidth( device_ );
+			else newProgram.vectorWidth=programSource.vectorWidth;
+			newProgram.buildOptions+=" -D VECTOR_WIDTH="+std::to_string(newProgram.vectorWidth);
+		}
+		if( programSource.gridStride ) newProgram.buildOptions+=" -D GRID_STRIDE";
+
+		stopWatch.reset();
+		newProgram.program=buildProgram( context_, device_, programSource.source, programSource.binary, newProgram.buildOptions, newProgram.name, settings.pProgramCache );
+		if( settings.pTimings ) settings.pTimings->phase( "build "+newProgram.name ).addSample( stopWatch.elapsed() );
+
+		//
+		// Figure out the kernel name and get it
+		//
+		std::string kernelName=newProgram.program.getInfo<CL_PROGRAM_KERNEL_NAMES>(&error);
+		if( error!=CL_SUCCESS ) throw std::runtime_error( "Error getting the kernel name" );
+		newProgram.kernel=cl::Kernel( newProgram.program, kernelName.c_str(), &error );
+		if( error!=CL_SUCCESS ) throw std::runtime_error( "Error when creating kernel '"+kernelName+"' - "+tools::createKernelError(error) );
+
+		newProgram.kernelName=newProgram.name+":"+kernelName;
+		// A kernel built with reqd_work_group_size can only be run with that size
+		const cl::size_t<3> compileWorkGroupSize=newProgram.kernel.getWorkGroupInfo<CL_KERNEL_COMPILE_WORK_GROUP_SIZE>(device_);
+		if( compileWorkGroupSize[0]!=0 ) newProgram.workGroupSize=compileWorkGroupSize[0];
+		else
+		{
+			const size_t kernelWorkGroupSize=newProgram.kernel.getWorkGroupInfo<CL_KERNEL_WORK_GROUP_SIZE>(device_);
+			// A tuned size the kernel can't be run with (e.g. the kernel has been changed since) is ignored
+			size_t tunedSize=0;
+			if( settings.pWorkGroupSizes!=nullptr && settings.pWorkGroupSizes->lookup( device_, newProgram.kernelName, newProgram.buildOptions, elementCount_, tunedSize )
+					&& tunedSize<=kernelWorkGroupSize )
+			{
+				newProgram.workGroupSize=tunedSize;
+			}
+			else
+			{
+				newProgram.workGroupSize=kernelWorkGroupSize;
+				const size_t workItems=workItemCount( newProgram, elementCount_ );
+				if( newProgram.workGroupSize>workItems ) newProgram.workGroupSize=workItems;
+			}
+		}
+		if( programSource.gridStride )
+		{
+			// Enough work groups to fill the device. The kernel loops over the rest of the data.
+			const size_t groupSize=( newProgram.workGroupSize==0 ? newProgram.kernel.getWorkGroupInfo<CL_KERNEL_WORK_GROUP_SIZE>(device_) : newProgram.workGroupSize );
+			newProgram.maxWorkItems=device_.getInfo<CL_DEVICE_MAX_COMPUTE_UNITS>()*groupSize*gridStrideGroupsPerComputeUnit;
+		}
+
+		// These stay set for every subsequent enqueue
+		setKernelArguments( newProgram.kernel, input_.buffer(), output_.buffer(), elementCount_ );
+
+		programs_.push_back( std::move(newProgram) );
+	}
+}
+
+tools::DeviceSession::~DeviceSession()
+{
+	tools::trace::finish( queue_ );
+}
+
+const cl::Device& tools::DeviceSession::device() const
+{
+	return device_;
+}
+
+const cl::Context& tools::DeviceSession::context() const
+{
+	return context_;
+}
+
+const cl::CommandQueue& tools::DeviceSession::queue() const
+{
+	return queue_;
+}
+
+const cl::Buffer& tools::DeviceSession::input() const
+{
+	return input_.buffer();
+}
+
+const cl::Buffer& tools::DeviceSession::output() const
+{
+	return output_.buffer();
+}
+
+const std::vector<tools::DeviceSession::Program>& tools::DeviceSession::programs() const
+{
+	return programs_;
+}
+
+size_t tools::DeviceSession::elementCount() const
+{
+	return elementCount_;
+}
+
+size_t tools::DeviceSession::workItemCount( const Program& program, size_t elementCount )
+{
+	size_t workItems=(elementCount+program.vectorWidth-1)/program.vectorWidth;
+	if( program.maxWorkItems!=0 && workItems>program.maxWorkItems ) workItems=program.maxWorkItems;
+	return workItems;
+}
+
+cl::Program tools::DeviceSession::buildProgram( const cl::Context& context, const cl::Device& device, const std::string& source, const std::vector<char>& binary,
+		const std::string& buildOptions, const std::string& name, tools::ProgramCache* pProgramCache )
+{
+	if( pProgramCache ) return pProgramCache->build( context, device, source, binary, buildOptions );
+
+	cl_int error=CL_SUCCESS;
+	cl::Program program;
+	if( binary.empty() )
+	{
+		program=cl::Program( context, source, false, &error );
+		if( error!=CL_SUCCESS ) throw std::runtime_error( "Error when creating program from source - "+tools::createProgramError(error) );
+	}
+	else
+	{
+		cl::Program::Binaries clBinaries;
+		clBinaries.push_back( std::make_pair( static_cast<const void*>(binary.data()), binary.size() ) );
+		program=cl::Program( context, std::vector<cl::Device>(1,device), clBinaries, nullptr, &error );
+		if( error!=CL_SUCCESS ) throw std::runtime_error( "Error when creating program from binary - "+tools::createProgramError(error) );
+	}
+
+	error=tools::trace::build( program, std::vector<cl::Device>(1,device), buildOptions, name );
+	if( error!=CL_SUCCESS ) throw std::runtime_error( "Error when building program '"+name+"':\n "+program.getBuildInfo<CL_PROGRAM_BUILD_LOG>(device) );
+	return program;
+}
+
+void tools::DeviceSession::setKernelArguments( cl::Kernel& kernel, const cl::Buffer& input, const cl::Buffer& output, size_t elementCount )
+{
+	cl_int error=kernel.setArg( 0, input ); if( error!=CL_SUCCESS ) throw std::runtime_error( "Error when setting kernel argument 0: "+tools::setKernelArgError(error) );
+	error=kernel.setArg( 1, static_cast<unsigned long>(elementCount) ); if( error!=CL_SUCCESS ) throw std::runtime_error( "Error when setting kernel argument 1: "+tools::setKernelArgError(error) );
+	error=kernel.setArg( 2, output ); if( error!=CL_SUCCESS ) throw std::runtime_error( "Error when setting kernel argument 2: "+tools::setKernelArgError(error) );
+	error=kernel.setArg( 3, static_cast<unsigned long>(elementCount) ); if( error!=CL_SUCCESS ) throw std::runtime_error( "Error when setting kernel argument 3: "+tools::setKernelArgError(error) );
+}
+
+cl::NDRange tools::DeviceSession::globalRange( size_t elementCount, size_t workGroupSize )
+{
+	if( workGroupSize==0 ) return cl::NDRange( elementCount );
+	else return cl::NDRange( (elementCount+workGroupSize-1)/workGroupSize*workGroupSize );
+}
+
+cl::NDRange tools::DeviceSession::localRange( size_t workGroupSize )
+{
+	if( workGroupSize==0 ) return cl::NullRange;
+	else return cl::NDRange( workGroupSize );
+}
+
+size_t tools::DeviceSession::bytesPerElement() const
+{
+	return bytesPerElement_;
+}
+
+tools::DeviceSession::TransferStrategy tools::DeviceSession::transferStrategy() const
+{
+	return transferStrategy_;
+}
+
+cl::Kernel tools::DeviceSession::createKernel( size_t programIndex, const cl::Buffer& input, const cl::Buffer& output, size_t elementCount ) const
+{
+	cl_int error=CL_SUCCESS;
+	const Program& program=programs_.at(programIndex);
+	const std::string kernelName=program.kernel.getInfo<CL_KERNEL_FUNCTION_NAME>();
+	cl::Kernel kernel( program.program, kernelName.c_str(), &error );
+	if( error!=CL_SUCCESS ) throw std::runtime_error( "Error when creating kernel '"+kernelName+"' - "+tools::createKernelError(error) );
+	setKernelArguments( kernel, input, output, elementCount );
+	return kernel;
+}
+
+tools::PooledBuffer tools::DeviceSession::createBuffer( cl_mem_flags flags, size_t bytes, void* pHostMemory, cl_int* pError ) const
+{
+	if( pBufferPool_ ) return pBufferPool_->acquire( context_, flags, bytes, pHostMemory, pError, &queue_ );
+	else return tools::PooledBuffer( tools::trace::createBuffer( context_, flags, bytes, pHostMemory, pError ) );
+}
+
+double tools::DeviceSession::writeInput( const void* pInput ) const
+{
+	cl_int error=CL_SUCCESS;
+	const size_t bytes=bytesPerElement_*elementCount_;
+
+	if( transferStrategy_==CopyTransfer )
+	{
+		cl::Event writeEvent;
+		error=tools::trace::enqueueWriteBuffer( queue_, input_.buffer(), CL_TRUE, 0, bytes, pInput, nullptr, &writeEvent );
+		if( error!=CL_SUCCESS ) throw std::runtime_error( "Error when copying input in" );
+		return profilingEnabled_ ? tools::eventDuration(writeEvent) : 0;
+	}
+
+	// All of the other strategies map the buffer into host memory
+	cl_map_flags mapFlags=CL_MAP_WRITE;
+#ifdef CL_MAP_WRITE_INVALIDATE_REGION // OpenCL 1.2 and later
+	if( transferStrategy_==MapInvalidate ) mapFlags=CL_MAP_WRITE_INVALIDATE_REGION;
+#endif
+	cl::Event mapEvent;
+	void* pMapped=tools::trace::enqueueMapBuffer( queue_, input_.buffer(), CL_TRUE, mapFlags, 0, bytes, nullptr, &mapEvent, &error );
+	if( error!=CL_SUCCESS ) throw std::runtime_error( "Error when mapping the input buffer - "+tools::mapBufferError(error) );
+
+	tools::StopWatch copyTime;
+	// For CL_MEM_USE_HOST_PTR the mapped region is usually the host memory itself, in which case there's nothing to do
+	if( pMapped!=pInput ) std::memcpy( pMapped, pInput, bytes );
+	double hostCopyTime=copyTime.elapsed();
+
+	cl::Event unmapEvent;
+	error=tools::trace::enqueueUnmapMemObject( queue_, input_.buffer(), pMapped, nullptr, &unmapEvent );
+	if( error!=CL_SUCCESS ) throw std::runtime_error( "Error when unmapping the input buffer - "+tools::mapBufferError(error) );
+	unmapEvent.wait();
+
+	return profilingEnabled_ ? tools::eventDuration(mapEvent)+hostCopyTime+tools::eventDuration(unmapEvent) : 0;
+}
+
+double tools::DeviceSession::readOutput( void* pOutput ) const
+{
+	cl_int error=CL_SUCCESS;
+	const size_t bytes=bytesPerElement_*elementCount_;
+
+	if( transferStrategy_==CopyTransfer )
+	{
+		cl::Event readEvent;
+		error=tools::trace::enqueueReadBuffer( queue_, output_.buffer(), CL_TRUE, 0, bytes, pOutput, nullptr, &readEvent );
+		if( error!=CL_SUCCESS ) throw std::runtime_error( "Error when copying output out" );
+		return profilingEnabled_ ? tools::eventDuration(readEvent) : 0;
+	}
+
+	cl::Event mapEvent;
+	void* pMapped=tools::trace::enqueueMapBuffer( queue_, output_.buffer(), CL_TRUE, CL_MAP_READ, 0, bytes, nullptr, &mapEvent, &error );
+	if( error!=CL_SUCCESS ) throw std::runtime_error( "Error when mapping the output buffer - "+tools::mapBufferError(error) );
+
+	tools::StopWatch copyTime;
+	if( pMapped!=pOutput ) std::memcpy( pOutput, pMapped, bytes );
+	double hostCopyTime=copyTime.elapsed();
+
+	cl::Event unmapEvent;
+	error=tools::trace::enqueueUnmapMemObject( queue_, output_.buffer(), pMapped, nullptr, &unmapEvent );
+	if( error!=CL_SUCCESS ) throw std::runtime_error( "Error when unmapping the output buffer - "+tools::mapBufferError(error) );
+	unmapEvent.wait();
+
+	return profilingEnabled_ ? tools::eventDuration(mapEvent)+hostCopyTime+tools::eventDuration(unmapEvent) : 0;
+}
+
+void tools::DeviceSession::fillOutput() const
+{
+	cl::Event fillEvent;
+	cl_int error=tools::trace::enqueueFillBuffer( queue_, output_.buffer(), tools::BufferPool::sentinelByte, 0, bytesPerElement_*elementCount_, nullptr, &fillEvent );
+	if( error!=CL_SUCCESS ) throw std::runtime_error( "Error when filling the output buffer" );
+	fillEvent.wait();
+}
+
+std::string tools::DeviceSession::transferStrategyName( TransferStrategy strategy )
+{
+	switch( strategy )
+	{
+		case CopyTransfer : return "copy";
+		case UseHostPointer : return "usehostptr";
+		case AllocHostPointer : return "allochostptr";
+		case MapInvalidate : return "mapinvalidate";
+		default : return "<unknown>";
+	}
+}
+
+tools::DeviceSession::TransferStrategy tools::DeviceSession::transferStrategyFromName( const std::string& name )
+{
+	for( const auto strategy : allTransferStrategies() )
+	{
+		if( transferStrategyName(strategy)==name ) return strategy;
+	}
+	throw std::runtime_error( "Unknown transfer strategy '"+name+"'" );
+}
+
+std::vector<tools::DeviceSession::TransferStrategy> tools::DeviceSession::allTransferStrategies()
+{
+	return std::vector<TransferStrategy>{ CopyTransfer, UseHostPointer, AllocHostPointer, MapInvalidate };
+}
@@ -0,0 +1,188 @@
+#ifndef INCLUDEGUARD_tools_DeviceSession_h
+#define INCLUDEGUARD_tools_DeviceSession_h
+
+#include <vector>
+#include <string>
+#include <CL/cl.hpp>
+#include "BufferPool.h"
+
+//
+// Forward declarations
+//
+namespace tools
+{
+	class PhaseTimings;
+	class ProgramCache;
+	class WorkGroupSizeTable;
+}
+
+namespace tools
+{
+	/** @brief Holds everything needed to run the test programs on a single device, so that it can be reused.
+	 *
+	 * On construction the context, command queue, input and output buffers are created, and each
+	 * program is built with its kernel arguments set. Repeated executions then only need to enqueue
+	 * the work on queue(). Kernels are expected to have the signature
+	 * (__global T* input, unsigned long inputCount, __global T* output, unsigned long outputCount).
+	 */
+	class DeviceSession
+	{
+	public:
+		/** @brief How the input and output are moved between the host and the device.
+		 *
+		 * CopyTransfer         - plain buffers with enqueueWriteBuffer/enqueueReadBuffer.
+		 * UseHostPointer       - CL_MEM_USE_HOST_PTR buffers on the caller's memory, synchronised with map/unmap.
+		 *                        Zero copy on devices that share memory with the host if the memory is page aligned.
+		 * AllocHostPointer     - CL_MEM_ALLOC_HOST_PTR (usually pinned) buffers, filled and drained with map/unmap.
+		 * MapInvalidate        - as AllocHostPointer, but the input is mapped with CL_MAP_WRITE_INVALIDATE_REGION
+		 *                        so the runtime doesn't need to copy the old contents to the host first.
+		 */
+		enum TransferStrategy { CopyTransfer, UseHostPointer, AllocHostPointer, MapInvalidate };
+		/** @brief The name used on the command line, e.g. "copy" or "usehostptr". */
+		static std::string transferStrategyName( TransferStrategy strategy );
+		/** @brief Inverse of transferStrategyName.
+		 *
+		 * @throw std::runtime_error     If the name is not recognised.
+		 */
+		static TransferStrategy transferStrategyFromName( const std::string& name );
+		static std::vector<TransferStrategy> allTransferStrategies();
+
+		/** @brief The global size to use for elementCount work items, padded up to a multiple of workGroupSize.
+		 *
+		 * Kernels must check their bounds, since the padding work items will be run. A work group size of
+		 * zero means a NULL local size, in which case there is no padding.
+		 */
+		static cl::NDRange globalRange( size_t elementCount, size_t workGroupSize );
+		/** @brief NullRange if workGroupSize is zero, otherwise workGroupSize. */
+		static cl::NDRange localRange( size_t workGroupSize );
+
+		/** @brief Either OpenCL C source code or a precompiled binary (e.g. SPIR) for a program. */
+		struct ProgramSource
+		{
+			std::string name; ///< @brief Only used to label output
+			std::string source; ///< @brief OpenCL C source code. Only used if binary is empty.
+			std::vector<char> binary;
+			std::string buildOptions;
+			/// @brief Elements each work item handles. If not zero, "-D VECTOR_WIDTH=<n>" is added to the build options
+			/// (see tools::squareKernelSource). DeviceVectorWidth means tools::preferredVectorWidth of each device.
+			size_t vectorWidth;
+			/// @brief Adds "-D GRID_STRIDE" to the build options and launches at most a few work groups per compute unit.
+			/// The kernel must loop over the data with a stride of the global size.
+			bool gridStride;
+			static const size_t DeviceVectorWidth=static_cast<size_t>(-1); ///< @brief Special value for vectorWidth
+		};
+
+		/** @brief Optional behaviour when creating the session. */
+		struct Settings
+		{
+			Settings() : enableProfiling(false), pTimings(nullptr), pProgramCache(nullptr), transferStrategy(CopyTransfer), pHostInput(nullptr), pHostOutput(nullptr), pWorkGroupSizes(nullptr), pBufferPool(nullptr) {}
+			bool enableProfiling; ///< @brief Create the queue with CL_QUEUE_PROFILING_ENABLE
+			/// @brief If not null, host wall clock times for context creation and each program build
+			/// are added to the "context" and "build <name>" phases.
+			tools::PhaseTimings* pTimings;
+			tools::ProgramCache* pProgramCache; ///< @brief If not null, programs are loaded from and saved to this cache.
+			TransferStrategy transferStrategy;
+			/// @brief Host memory the buffers are created on for UseHostPointer. Must stay valid for the
+			/// lifetime of the session, and be what is later passed to writeInput and readOutput.
+			const void* pHostInput;
+			void* pHostOutput;
+			/// @brief If not null, any tuned work group size for the device, kernel and element count is used.
+			const tools::WorkGroupSizeTable* pWorkGroupSizes;
+			/// @brief If not null, the session uses the pool's context for the device and takes every buffer from the pool,
+			/// so that sessions one after the other reuse each other's buffers. Must outlive the session.
+			tools::BufferPool* pBufferPool;
+		};
+
+		/** @brief A built program and the kernel from it, ready to be enqueued. */
+		struct Program
+		{
+			std::string name;
+			std::string kernelName; ///< @brief The kernel function name, prefixed with the program name and a colon.
+			std::string buildOptions; ///< @brief The options it was built with, including any VECTOR_WIDTH and GRID_STRIDE defines.
+			cl::Program program;
+			cl::Kernel kernel;
+			/// @brief The size from reqd_work_group_size if the kernel has one, otherwise the tuned size if there is one no
+			/// larger than CL_KERNEL_WORK_GROUP_SIZE, otherwise CL_KERNEL_WORK_GROUP_SIZE clamped to the number of work items.
+			/// Zero means a NULL local size.
+			size_t workGroupSize;
+			size_t vectorWidth; ///< @brief Elements each work item handles, always at least one.
+			size_t maxWorkItems; ///< @brief Upper limit on the work items for grid stride kernels. Zero means no limit.
+		};
+
+		/** @brief The number of work items to launch "program" with for elementCount elements, before padding with globalRange. */
+		static size_t workItemCount( const Program& program, size_t elementCount );
+
+		/** @brief Creates a program from "binary", or from "source" if there is no binary, and builds it for the device.
+		 *
+		 * If pProgramCache is not null the program is loaded from or saved to the cache instead. "name" labels the trace.
+		 * @throw std::runtime_error     If the program can't be created, or with the build log if it doesn't build.
+		 */
+		static cl::Program buildProgram( const cl::Context& context, const cl::Device& device, const std::string& source, const std::vector<char>& binary,
+				const std::string& buildOptions, const std::string& name, tools::ProgramCache* pProgramCache=nullptr );
+		/** @brief Sets all four arguments of a kernel with the signature in the class description.
+		 *
+		 * @throw std::runtime_error     If any of the arguments can't be set.
+		 */
+		static void setKernelArguments( cl::Kernel& kernel, const cl::Buffer& input, const cl::Buffer& output, size_t elementCount );
+
+		/** @brief Creates all of the OpenCL objects and builds the programs.
+		 *
+		 * @throw std::runtime_error     If any of the OpenCL calls fail.
+		 */
+		DeviceSession( const cl::Device& device, const std::vector<ProgramSource>& programSources, size_t elementCount,
+				size_t bytesPerElement, const Settings& settings=Settings() );
+		/** @brief Waits for everything on the queue, so that the buffers are free for whoever the pool gives them to next. */
+		~DeviceSession();
+
+		const cl::Device& device() const;
+		const cl::Context& context() const;
+		const cl::CommandQueue& queue() const;
+		const cl::Buffer& input() const;
+		const cl::Buffer& output() const;
+		const std::vector<Program>& programs() const;
+		size_t elementCount() const;
+		size_t bytesPerElement() const;
+		TransferStrategy transferStrategy() const;
+		/** @brief A new kernel object for programs()[programIndex], with its own arguments set by setKernelArguments.
+		 *
+		 * For running a program on buffers other than input() and output() without changing the session's kernel.
+		 * @throw std::runtime_error     If the kernel can't be created or its arguments set.
+		 */
+		cl::Kernel createKernel( size_t programIndex, const cl::Buffer& input, const cl::Buffer& output, size_t elementCount ) const;
+		/** @brief A buffer in context(), from the pool if the session has one. Arguments and errors are as clCreateBuffer.
+		 * Buffers the pool reuses are filled with BufferPool::sentinelByte first. */
+		tools::PooledBuffer createBuffer( cl_mem_flags flags, size_t bytes, void* pHostMemory, cl_int* pError ) const;
+
+		/** @brief Moves elementCount() elements from pInput into the input buffer using the transfer strategy.
+		 *
+		 * Blocks until complete. If profiling is enabled returns the time taken in seconds, which is the
+		 * device time for the transfer commands plus the time for any host side memcpy. Otherwise returns 0.
+		 * @throw std::runtime_error     If any of the OpenCL calls fail.
+		 */
+		double writeInput( const void* pInput ) const;
+		/** @brief Moves elementCount() elements from the output buffer into pOutput. Returns as writeInput. */
+		double readOutput( void* pOutput ) const;
+		/** @brief Fills the output buffer with BufferPool::sentinelByte (NaN for floats), so that anything a kernel
+		 * doesn't write can't pass for a result from an earlier run. Waits for the fill to finish, so that it
+		 * can be called just before starting a timer.
+		 *
+		 * @throw std::runtime_error     If the fill can't be enqueued.
+		 */
+		void fillOutput() const;
+	protected:
+		cl::Device device_;
+		cl::Context context_;
+		cl::CommandQueue queue_;
+		tools::BufferPool* pBufferPool_;
+		tools::PooledBuffer input_;
+		tools::PooledBuffer output_;
+		std::vector<Program> programs_;
+		size_t elementCount_;
+		size_t bytesPerElement_;
+		bool profilingEnabled_;
+		TransferStrategy transferStrategy_;
+	};
+
+} // end of the tools namespace
+
+#endif
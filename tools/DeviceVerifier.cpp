@@ -0,0 +1,227 @@
+#include "DeviceVerifier.h"
+
+#include <stdexcept>
+#include <sstream>
+#include <algorithm>
+#include <cstring>
+#include <limits>
+#include "DeviceSession.h"
+#include "OpenCLEnums.h"
+#include "Timing.h"
+#include "Trace.h"
+
+//
+// Unnamed namespace for things only used in this file
+//
+namespace
+{
+	const size_t maxVerifyWorkGroupSize=256;
+	const size_t verifyGroupsPerComputeUnit=4; ///< @brief Enough work groups to fill the device, while keeping the partial results small
+	const size_t valuesPerGroup=4; ///< @brief Mismatches, max error bits, max error index and first mismatch
+
+	/** @brief The largest power of two that is no more than "value", or one if value is zero. */
+	size_t powerOfTwoBelow( size_t value )
+	{
+		size_t result=1;
+		while( result*2<=value ) result*=2;
+		return result;
+	}
+} // end of the unnamed namespace
+
+std::string tools::verificationKernelSource( const std::string& expectedExpression )
+{
+	std::ostringstream source;
+	source << "#define NO_MISMATCH ((ulong)-1)\n"
+		"\n"
+		"long orderedBits( float value )\n"
+		"{\n"
+		"	const int bits=as_int(value);\n"
+		"	return bits<0 ? (long)INT_MIN-bits : (long)bits;\n"
+		"}\n"
+		"\n"
+		"// ULP distances can be more than a float holds exactly, so they are kept as integers\n"
+		"#if TOLERANCE_MODE==3\n"
+		"typedef ulong ErrorType;\n"
+		"#define NAN_ERROR ULONG_MAX\n"
+		"#define ERROR_BITS(error) (error)\n"
+		"#else\n"
+		"typedef float ErrorType;\n"
+		"#define NAN_ERROR INFINITY\n"
+		"#define ERROR_BITS(error) as_uint(error)\n"
+		"#endif\n"
+		"\n"
+		"ErrorType elementError( float actual, float expected )\n"
+		"{\n"
+		"	if( actual==expected ) return 0;\n"
+		"	if( isnan(actual) || isnan(expected) ) return NAN_ERROR;\n"
+		"#if TOLERANCE_MODE==3\n"
+		"	return abs( orderedBits(actual)-orderedBits(expected) );\n"
+		"#elif TOLERANCE_MODE==2\n"
+		"	return fabs(actual-expected)/fabs(expected);\n"
+		"#else\n"
+		"	return fabs(actual-expected);\n"
+		"#endif\n"
+		"}\n"
+		"\n"
+		"__kernel void verifyOutput( __global const float* actual, __global const float* source, const ulong count, const ErrorType limit, __global ulong* groupResults,\n"
+		"		__local uint* localMismatches, __local ErrorType* localMaxErrors, __local ulong* localMaxErrorIndices, __local ulong* localFirstMismatches )\n"
+		"{\n"
+		"	uint mismatches=0;\n"
+		"	ErrorType maxError=0;\n"
+		"	ulong maxErrorIndex=0;\n"
+		"	ulong firstMismatch=NO_MISMATCH;\n"
+		"	for( ulong index=get_global_id(0); index<count; index+=get_global_size(0) )\n"
+		"	{\n"
+		"		const float x=source[index];\n"
+		"		const ErrorType error=elementError( actual[index], " << expectedExpression << " );\n"
+		"		if( error>limit )\n"
+		"		{\n"
+		"			++mismatches;\n"
+		"			if( firstMismatch==NO_MISMATCH ) firstMismatch=index;\n"
+		"		}\n"
+		"		if( error>maxError )\n"
+		"		{\n"
+		"			maxError=error;\n"
+		"			maxErrorIndex=index;\n"
+		"		}\n"
+		"	}\n"
+		"\n"
+		"	const size_t localIndex=get_local_id(0);\n"
+		"	localMismatches[localIndex]=mismatches;\n"
+		"	localMaxErrors[localIndex]=maxError;\n"
+		"	localMaxErrorIndices[localIndex]=maxErrorIndex;\n"
+		"	localFirstMismatches[localIndex]=firstMismatch;\n"
+		"	barrier( CLK_LOCAL_MEM_FENCE );\n"
+		"	for( size_t stride=get_local_size(0)/2; stride>0; stride/=2 )\n"
+		"	{\n"
+		"		if( localIndex<stride )\n"
+		"		{\n"
+		"			const size_t other=localIndex+stride;\n"
+		"			localMismatches[localIndex]+=localMismatches[other];\n"
+		"			// Ties go to the lowest index, as they do on the host\n"
+		"			if( localMaxErrors[other]>localMaxErrors[localIndex]\n"
+		"				|| ( localMaxErrors[other]>0 && localMaxErrors[other]==localMaxErrors[localIndex] && localMaxErrorIndices[other]<localMaxErrorIndices[localIndex] ) )\n"
+		"			{\n"
+		"				localMaxErrors[localIndex]=localMaxErrors[other];\n"
+		"				localMaxErrorIndices[localIndex]=localMaxErrorIndices[other];\n"
+		"			}\n"
+		"			localFirstMismatches[localIndex]=min( localFirstMismatches[localIndex], localFirstMismatches[other] );\n"
+		"		}\n"
+		"		barrier( CLK_LOCAL_MEM_FENCE );\n"
+		"	}\n"
+		"\n"
+		"	if( localIndex==0 )\n"
+		"	{\n"
+		"		__global ulong* pResult=groupResults+4*get_group_id(0);\n"
+		"		pResult[0]=localMismatches[0];\n"
+		"		pResult[1]=ERROR_BITS(localMaxErrors[0]);\n"
+		"		pResult[2]=localMaxErrorIndices[0];\n"
+		"		pResult[3]=localFirstMismatches[0];\n"
+		"	}\n"
+		"}\n";
+	return source.str();
+}
+
+tools::DeviceVerifier::DeviceVerifier( const tools::DeviceSession& session, const tools::Tolerance& tolerance, const std::string& expectedExpression )
+	: session_(session), tolerance_(tolerance), workGroupSize_(1), maxWorkGroups_(1)
+{
+	initialise( expectedExpression );
+}
+
+tools::DeviceVerifier::DeviceVerifier( const tools::DeviceSession& session, const tools::Tolerance& tolerance, const float* pReference )
+	: session_(session), tolerance_(tolerance), workGroupSize_(1), maxWorkGroups_(1)
+{
+	cl_int error=CL_SUCCESS;
+	const size_t bytes=sizeof(float)*session.elementCount();
+	reference_=session.createBuffer( CL_MEM_READ_ONLY, bytes, nullptr, &error );
+	if( error!=CL_SUCCESS ) throw std::runtime_error( "Error when creating the reference buffer - "+tools::createBufferError(error) );
+	error=tools::trace::enqueueWriteBuffer( session.queue(), reference_.buffer(), CL_TRUE, 0, bytes, pReference );
+	if( error!=CL_SUCCESS ) throw std::runtime_error( "Error when copying the reference to the device" );
+
+	// The source buffer is the reference, so it is the expected value itself
+	initialise( "x" );
+}
+
+void tools::DeviceVerifier::initialise( const std::string& expectedExpression )
+{
+	cl_int error=CL_SUCCESS;
+	const cl::Device& device=session_.device();
+
+	std::ostringstream options;
+	options << "-D TOLERANCE_MODE=" << static_cast<int>(tolerance_.mode);
+	const cl::Program program=tools::DeviceSession::buildProgram( session_.context(), device, verificationKernelSource(expectedExpression), std::vector<char>(),
+			options.str(), "verifyOutput" );
+	kernel_=cl::Kernel( program, "verifyOutput", &error );
+	if( error!=CL_SUCCESS ) throw std::runtime_error( "Error when creating kernel 'verifyOutput' - "+tools::createKernelError(error) );
+
+	// The reduction halves the group each step, so the size has to be a power of two
+	workGroupSize_=powerOfTwoBelow( std::min( maxVerifyWorkGroupSize, kernel_.getWorkGroupInfo<CL_KERNEL_WORK_GROUP_SIZE>(device) ) );
+	maxWorkGroups_=std::max<size_t>( 1, device.getInfo<CL_DEVICE_MAX_COMPUTE_UNITS>()*verifyGroupsPerComputeUnit );
+
+	groupResults_=session_.createBuffer( CL_MEM_WRITE_ONLY, sizeof(cl_ulong)*valuesPerGroup*maxWorkGroups_, nullptr, &error );
+	if( error!=CL_SUCCESS ) throw std::runtime_error( "Error when creating the verification results buffer - "+tools::createBufferError(error) );
+	hostGroupResults_.resize( valuesPerGroup*maxWorkGroups_ );
+
+	const cl::Buffer& source=( reference_.buffer()() ? reference_.buffer() : session_.input() );
+	error=kernel_.setArg( 1, source ); if( error!=CL_SUCCESS ) throw std::runtime_error( "Error when setting kernel argument 1: "+tools::setKernelArgError(error) );
+	if( tolerance_.mode==tools::Tolerance::Ulp )
+	{
+		// Whole ULPs, so "more than 1.5" is the same as "more than 1"
+		const cl_ulong limit=( tolerance_.value>=static_cast<double>(std::numeric_limits<cl_ulong>::max()) ? std::numeric_limits<cl_ulong>::max() : static_cast<cl_ulong>(tolerance_.value) );
+		error=kernel_.setArg( 3, limit );
+	}
+	else error=kernel_.setArg( 3, static_cast<cl_float>( tolerance_.mode==tools::Tolerance::Exact ? 0.0 : tolerance_.value ) );
+	if( error!=CL_SUCCESS ) throw std::runtime_error( "Error when setting kernel argument 3: "+tools::setKernelArgError(error) );
+	error=kernel_.setArg( 4, groupResults_.buffer() ); if( error!=CL_SUCCESS ) throw std::runtime_error( "Error when setting kernel argument 4: "+tools::setKernelArgError(error) );
+	error=kernel_.setArg( 5, sizeof(cl_uint)*workGroupSize_, nullptr ); if( error!=CL_SUCCESS ) throw std::runtime_error( "Error when setting kernel argument 5: "+tools::setKernelArgError(error) );
+	error=kernel_.setArg( 6, ( tolerance_.mode==tools::Tolerance::Ulp ? sizeof(cl_ulong) : sizeof(cl_float) )*workGroupSize_, nullptr ); if( error!=CL_SUCCESS ) throw std::runtime_error( "Error when setting kernel argument 6: "+tools::setKernelArgError(error) );
+	error=kernel_.setArg( 7, sizeof(cl_ulong)*workGroupSize_, nullptr ); if( error!=CL_SUCCESS ) throw std::runtime_error( "Error when setting kernel argument 7: "+tools::setKernelArgError(error) );
+	error=kernel_.setArg( 8, sizeof(cl_ulong)*workGroupSize_, nullptr ); if( error!=CL_SUCCESS ) throw std::runtime_error( "Error when setting kernel argument 8: "+tools::setKernelArgError(error) );
+}
+
+tools::VerificationResult tools::DeviceVerifier::verify( const cl::Buffer& actual, size_t count )
+{
+	tools::StopWatch stopWatch;
+	cl_int error=CL_SUCCESS;
+	count=std::min( count, session_.elementCount() );
+
+	error=kernel_.setArg( 0, actual ); if( error!=CL_SUCCESS ) throw std::runtime_error( "Error when setting kernel argument 0: "+tools::setKernelArgError(error) );
+	error=kernel_.setArg( 2, static_cast<cl_ulong>(count) ); if( error!=CL_SUCCESS ) throw std::runtime_error( "Error when setting kernel argument 2: "+tools::setKernelArgError(error) );
+
+	const size_t workGroups=std::max<size_t>( 1, std::min( maxWorkGroups_, (count+workGroupSize_-1)/workGroupSize_ ) );
+	error=tools::trace::enqueueNDRangeKernel( session_.queue(), kernel_, cl::NullRange, cl::NDRange(workGroups*workGroupSize_), cl::NDRange(workGroupSize_) );
+	if( error!=CL_SUCCESS ) throw std::runtime_error( "Error when enqueing the verification kernel - "+tools::enqueKernelError(error) );
+	error=tools::trace::enqueueReadBuffer( session_.queue(), groupResults_.buffer(), CL_TRUE, 0, sizeof(cl_ulong)*valuesPerGroup*workGroups, hostGroupResults_.data() );
+	if( error!=CL_SUCCESS ) throw std::runtime_error( "Error when copying the verification results from the device" );
+
+	// Combine the partial results of each group. Groups cover interleaved indices, so ties are settled by index.
+	VerificationResult result{ count, 0, 0, 0, std::vector<size_t>(), 0, 0 };
+	cl_ulong firstMismatch=static_cast<cl_ulong>(-1);
+	for( size_t group=0; group<workGroups; ++group )
+	{
+		const cl_ulong* pGroup=&hostGroupResults_[valuesPerGroup*group];
+		double groupMaxError;
+		if( tolerance_.mode==tools::Tolerance::Ulp )
+		{
+			groupMaxError=( pGroup[1]==std::numeric_limits<cl_ulong>::max() ? std::numeric_limits<double>::infinity() : static_cast<double>(pGroup[1]) );
+		}
+		else
+		{
+			const cl_uint errorBits=static_cast<cl_uint>( pGroup[1] );
+			float floatError;
+			std::memcpy( &floatError, &errorBits, sizeof(floatError) );
+			groupMaxError=floatError;
+		}
+
+		result.mismatches+=static_cast<size_t>( pGroup[0] );
+		if( groupMaxError>result.maxError || ( groupMaxError>0 && groupMaxError==result.maxError && pGroup[2]<result.maxErrorIndex ) )
+		{
+			result.maxError=groupMaxError;
+			result.maxErrorIndex=static_cast<size_t>( pGroup[2] );
+		}
+		firstMismatch=std::min( firstMismatch, pGroup[3] );
+	}
+	if( result.mismatches!=0 ) result.firstMismatches.push_back( static_cast<size_t>(firstMismatch) );
+	result.time=stopWatch.elapsed();
+	return result;
+}
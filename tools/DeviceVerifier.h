@@ -0,0 +1,82 @@
+#ifndef INCLUDEGUARD_tools_DeviceVerifier_h
+#define INCLUDEGUARD_tools_DeviceVerifier_h
+
+#include <string>
+#include <vector>
+#include <CL/cl.hpp>
+#include "BufferPool.h"
+#include "Verification.h"
+
+//
+// Forward declarations
+//
+namespace tools
+{
+	class DeviceSession;
+}
+
+namespace tools
+{
+	/** @brief OpenCL C source for a kernel called "verifyOutput" that checks float results on the device.
+	 *
+	 * Each work item goes through the elements with a stride of the global size, working out the expected value
+	 * from "expectedExpression". In that expression, "x" is element "index" of the source buffer, which is either
+	 * the kernel's input or a reference output. Errors are calculated as ResultVerifier does, but in float, apart
+	 * from ULP distances which are integers.
+	 * Each work group then reduces its mismatch count, maximum error (and the lowest index with it) and first
+	 * mismatching index in local memory, and writes them as four ulongs to groupResults[4*get_group_id(0)]. The
+	 * maximum error is the ULP count in ulp mode (ULONG_MAX for NaN), otherwise the bits of the float.
+	 * Build with "-D TOLERANCE_MODE=<n>", where n is a tools::Tolerance::Mode. The signature is
+	 * verifyOutput( __global const float* actual, __global const float* source, ulong count, ErrorType limit,
+	 * __global ulong* groupResults, __local uint*, __local ErrorType*, __local ulong*, __local ulong* ), with the
+	 * local buffers each holding one element per work item. ErrorType is ulong in ulp mode, otherwise float.
+	 */
+	std::string verificationKernelSource( const std::string& expectedExpression );
+
+	/** @brief Checks a DeviceSession's output on the device, so that only a few numbers need to come back to the host.
+	 *
+	 * The result has the same mismatch count and maximum error as ResultVerifier (apart from absolute and relative
+	 * errors being calculated in float), but only the first mismatching index. The verify commands go on the session's queue,
+	 * so they run after anything already enqueued there. If there are any mismatches, the caller can read the
+	 * output back and check it on the host for the details.
+	 */
+	class DeviceVerifier
+	{
+	public:
+		/** @brief Checks each element against "expectedExpression" of the session's input (see verificationKernelSource),
+		 * e.g. "x*x" for the square kernel.
+		 *
+		 * @throw std::runtime_error     If the kernel can't be built or its buffers created.
+		 */
+		DeviceVerifier( const tools::DeviceSession& session, const tools::Tolerance& tolerance, const std::string& expectedExpression );
+
+		/** @brief Checks each element against a reference output, which is uploaded once here.
+		 *
+		 * @param pReference   session.elementCount() expected values.
+		 * @throw std::runtime_error     If the kernel can't be built, or its buffers created or written.
+		 */
+		DeviceVerifier( const tools::DeviceSession& session, const tools::Tolerance& tolerance, const float* pReference );
+
+		/** @brief Checks the first "count" elements of "actual", and blocks until the result is back.
+		 *
+		 * The time in the result is the host wall clock time, and the number of threads is zero.
+		 * @throw std::runtime_error     If any of the OpenCL calls fail.
+		 */
+		tools::VerificationResult verify( const cl::Buffer& actual, size_t count );
+	protected:
+		/** @brief Builds the kernel and creates the group results buffer. Used by both constructors. */
+		void initialise( const std::string& expectedExpression );
+
+		const tools::DeviceSession& session_; ///< @brief Must outlive the verifier.
+		tools::Tolerance tolerance_;
+		cl::Kernel kernel_;
+		size_t workGroupSize_; ///< @brief Always a power of two, for the reduction.
+		size_t maxWorkGroups_;
+		tools::PooledBuffer reference_; ///< @brief Only used when comparing with a reference.
+		tools::PooledBuffer groupResults_;
+		std::vector<cl_ulong> hostGroupResults_;
+	};
+
+} // end of the tools namespace
+
+#endif
@@ -0,0 +1,48 @@
+#include "HostBaseline.h"
+
+#include <vector>
+#include <thread>
+#include <exception>
+#include <algorithm>
+#include "Timing.h"
+
+void tools::parallelFor( size_t count, size_t numberOfThreads, const std::function<void(size_t first, size_t count)>& function )
+{
+	const size_t threads=std::max<size_t>( 1, std::min( hostThreadCount(numberOfThreads), count ) );
+	const size_t countPerThread=(count+threads-1)/threads;
+
+	std::vector<std::exception_ptr> threadErrors( threads );
+	auto runPart=[&]( size_t threadIndex )
+	{
+		try
+		{
+			const size_t first=threadIndex*countPerThread;
+			if( first<count ) function( first, std::min( countPerThread, count-first ) );
+		}
+		catch( ... ) { threadErrors[threadIndex]=std::current_exception(); }
+	};
+
+	std::vector<std::thread> workers;
+	for( size_t threadIndex=1; threadIndex<threads; ++threadIndex ) workers.push_back( std::thread( runPart, threadIndex ) );
+	runPart( 0 );
+	for( auto& worker : workers ) worker.join();
+	for( const auto& error : threadErrors ) if( error ) std::rethrow_exception( error );
+}
+
+double tools::squareOnHost( const float* pInput, float* pOutput, size_t count, size_t numberOfThreads )
+{
+	tools::StopWatch stopWatch;
+	parallelFor( count, numberOfThreads, [pInput,pOutput]( size_t first, size_t partCount )
+		{
+			const float* pPartInput=pInput+first;
+			float* pPartOutput=pOutput+first;
+			for( size_t index=0; index<partCount; ++index ) pPartOutput[index]=pPartInput[index]*pPartInput[index];
+		} );
+	return stopWatch.elapsed();
+}
+
+size_t tools::hostThreadCount( size_t numberOfThreads )
+{
+	if( numberOfThreads!=0 ) return numberOfThreads;
+	return std::max( 1u, std::thread::hardware_concurrency() );
+}
@@ -0,0 +1,27 @@
+#ifndef INCLUDEGUARD_tools_HostBaseline_h
+#define INCLUDEGUARD_tools_HostBaseline_h
+
+#include <cstddef>
+#include <functional>
+
+namespace tools
+{
+	/** @brief Calls function(first, count) for contiguous parts of the range [0, count), one part per thread.
+	 *
+	 * The calling thread does the first part. A numberOfThreads of zero means std::thread::hardware_concurrency().
+	 * Any exception thrown by the function is rethrown once all of the threads have finished.
+	 */
+	void parallelFor( size_t count, size_t numberOfThreads, const std::function<void(size_t first, size_t count)>& function );
+
+	/** @brief Host equivalent of the square test kernel, split across numberOfThreads threads.
+	 *
+	 * The inner loop is simple enough for the compiler to vectorise. Returns the host wall clock time in seconds.
+	 */
+	double squareOnHost( const float* pInput, float* pOutput, size_t count, size_t numberOfThreads );
+
+	/** @brief The number of threads parallelFor will actually use for numberOfThreads. */
+	size_t hostThreadCount( size_t numberOfThreads );
+
+} // end of the tools namespace
+
+#endif
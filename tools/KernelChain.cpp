@@ -0,0 +1,95 @@
+#include "KernelChain.h"
+
+#include <stdexcept>
+#include <string>
+#include "DeviceSession.h"
+#include "OpenCLEnums.h"
+#include "Timing.h"
+#include "Trace.h"
+
+//
+// Unnamed namespace for things only used in this file
+//
+namespace
+{
+	/** @brief The device time between the start of one event and the end of another. */
+	double eventSpan( const cl::Event& first, const cl::Event& last )
+	{
+		cl_ulong start=first.getProfilingInfo<CL_PROFILING_COMMAND_START>();
+		cl_ulong end=last.getProfilingInfo<CL_PROFILING_COMMAND_END>();
+		return ( end>start ? (end-start)*1e-9 : 0 );
+	}
+} // end of the unnamed namespace
+
+tools::KernelChain::KernelChain( const tools::DeviceSession& session )
+	: session_( session )
+{
+	cl_int error=CL_SUCCESS;
+	if( session.programs().empty() ) throw std::runtime_error( "KernelChain needs at least one program" );
+
+	const bool outOfOrder=( session.device().getInfo<CL_DEVICE_QUEUE_PROPERTIES>() & CL_QUEUE_OUT_OF_ORDER_EXEC_MODE_ENABLE )!=0;
+	queue_=cl::CommandQueue( session.context(), session.device(), CL_QUEUE_PROFILING_ENABLE | (outOfOrder ? CL_QUEUE_OUT_OF_ORDER_EXEC_MODE_ENABLE : 0), &error );
+	if( error!=CL_SUCCESS ) throw std::runtime_error( "Error when creating chain command queue - "+tools::createQueueError(error) );
+
+	const size_t bytes=session.bytesPerElement()*session.elementCount();
+	for( auto& buffer : buffers_ )
+	{
+		buffer=session.createBuffer( CL_MEM_READ_WRITE, bytes, nullptr, &error );
+		if( error!=CL_SUCCESS ) throw std::runtime_error( "Error when creating a chain buffer - "+tools::createBufferError(error) );
+	}
+
+	for( size_t stage=0; stage<session.programs().size(); ++stage )
+	{
+		const cl::Buffer& input=( stage==0 ? session.input() : buffers_[(stage+1)%2].buffer() );
+		kernels_.push_back( session.createKernel( stage, input, buffers_[stage%2].buffer(), session.elementCount() ) );
+	}
+}
+
+tools::KernelChain::Result tools::KernelChain::run( const void* pInput, void* pOutput, const std::vector<void*>& intermediateOutputs )
+{
+	cl_int error=CL_SUCCESS;
+	const size_t stages=kernels_.size();
+	const size_t elementCount=session_.elementCount();
+	const size_t bytes=session_.bytesPerElement()*elementCount;
+	std::vector<cl::Event> kernelEvents(stages);
+	std::vector<cl::Event> readEvents(stages); // Only set for the stages that are read back
+
+	tools::StopWatch wallClock;
+	cl::Event writeEvent;
+	error=tools::trace::enqueueWriteBuffer( queue_, session_.input(), CL_FALSE, 0, bytes, pInput, nullptr, &writeEvent );
+	if( error!=CL_SUCCESS ) throw std::runtime_error( "Error when copying input to the device" );
+
+	for( size_t stage=0; stage<stages; ++stage )
+	{
+		const tools::DeviceSession::Program& program=session_.programs()[stage];
+		std::vector<cl::Event> waitList( 1, stage==0 ? writeEvent : kernelEvents[stage-1] );
+		// This stage overwrites the output of two stages ago, which might still be being read back
+		if( stage>=2 && readEvents[stage-2]() ) waitList.push_back( readEvents[stage-2] );
+		error=tools::trace::enqueueNDRangeKernel( queue_, kernels_[stage], 0, tools::DeviceSession::globalRange( tools::DeviceSession::workItemCount( program, elementCount ), program.workGroupSize ),
+				tools::DeviceSession::localRange( program.workGroupSize ), &waitList, &kernelEvents[stage] );
+		if( error!=CL_SUCCESS ) throw std::runtime_error( "Error when enqueing kernel - "+tools::enqueKernelError(error) );
+
+		void* pStageOutput=( stage+1==stages ? pOutput : ( stage<intermediateOutputs.size() ? intermediateOutputs[stage] : nullptr ) );
+		if( pStageOutput!=nullptr )
+		{
+			const std::vector<cl::Event> readWaitList( 1, kernelEvents[stage] );
+			error=tools::trace::enqueueReadBuffer( queue_, buffers_[stage%2].buffer(), CL_FALSE, 0, bytes, pStageOutput, &readWaitList, &readEvents[stage] );
+			if( error!=CL_SUCCESS ) throw std::runtime_error( "Error when copying output from the device" );
+		}
+		queue_.flush();
+	}
+	tools::trace::finish( queue_ );
+
+	Result result;
+	result.wallTime=wallClock.elapsed();
+	result.writeTime=tools::eventDuration( writeEvent );
+	result.chainTime=eventSpan( kernelEvents.front(), kernelEvents.back() );
+	for( const auto& kernelEvent : kernelEvents ) result.stageTimes.push_back( tools::eventDuration(kernelEvent) );
+	result.readTime=tools::eventDuration( readEvents.back() );
+	return result;
+}
+
+size_t tools::KernelChain::numberOfStages() const
+{
+	return kernels_.size();
+}
@@ -0,0 +1,64 @@
+#ifndef INCLUDEGUARD_tools_KernelChain_h
+#define INCLUDEGUARD_tools_KernelChain_h
+
+#include <vector>
+#include <CL/cl.hpp>
+#include "BufferPool.h"
+
+//
+// Forward declarations
+//
+namespace tools
+{
+	class DeviceSession;
+}
+
+namespace tools
+{
+	/** @brief Runs all of a DeviceSession's programs as one chain on the device, each taking the previous one's output as its input.
+	 *
+	 * The first stage reads the session's input buffer. After that the stages ping-pong between two device
+	 * buffers, so nothing goes back to the host between stages. Each stage is linked to the one before by its
+	 * event rather than by queue order, and the command queue is out-of-order if the device supports it. Only
+	 * the last stage's output is read back, plus any intermediate stages that are asked for. Reading an
+	 * intermediate stage holds back the stage that would overwrite its buffer until the read is done.
+	 *
+	 * Every program must take and produce elements of the session's bytesPerElement().
+	 */
+	class KernelChain
+	{
+	public:
+		struct Result
+		{
+			double wallTime; ///< @brief Host seconds from the first enqueue until the last read has finished.
+			double writeTime; ///< @brief Device seconds for the input upload.
+			double chainTime; ///< @brief Device seconds from the start of the first kernel to the end of the last.
+			std::vector<double> stageTimes; ///< @brief Device seconds for each kernel.
+			double readTime; ///< @brief Device seconds for reading back the last stage.
+		};
+
+		/** @brief Creates the queue, the ping-pong buffers (from the session's pool if it has one) and a kernel for each stage.
+		 *
+		 * @throw std::runtime_error     If the session has no programs, or any of the OpenCL calls fail.
+		 */
+		explicit KernelChain( const tools::DeviceSession& session );
+
+		/** @brief Runs the chain once on elementCount() elements from pInput, writing the last stage's output to pOutput.
+		 *
+		 * @param intermediateOutputs   Optional, one entry per stage. Any stage with a non null entry (apart from the
+		 *                              last) also has its output read back into that memory.
+		 * @throw std::runtime_error     If anything can't be enqueued.
+		 */
+		Result run( const void* pInput, void* pOutput, const std::vector<void*>& intermediateOutputs=std::vector<void*>() );
+
+		size_t numberOfStages() const;
+	protected:
+		const tools::DeviceSession& session_; ///< @brief Must outlive the chain.
+		cl::CommandQueue queue_;
+		tools::PooledBuffer buffers_[2]; ///< @brief Stage n writes buffers_[n%2] and, after the first, reads the other one.
+		std::vector<cl::Kernel> kernels_; ///< @brief One per stage, with the arguments for its place in the chain.
+	};
+
+} // end of the tools namespace
+
+#endif
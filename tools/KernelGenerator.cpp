@@ -0,0 +1,60 @@
+#include "KernelGenerator.h"
+
+#include <algorithm>
+
+std::string tools::squareKernelSource()
+{
+	return "\n"
+		"#ifndef VECTOR_WIDTH\n"
+		"	#define VECTOR_WIDTH 1\n"
+		"#endif\n"
+		"#define CONCATENATE_(a,b) a##b\n"
+		"#define CONCATENATE(a,b) CONCATENATE_(a,b)\n"
+		"#if VECTOR_WIDTH==1\n"
+		"	#define SQUARE_VECTOR(block) output[block]=input[block]*input[block]\n"
+		"#else\n"
+		"	#define SQUARE_VECTOR(block) { CONCATENATE(float,VECTOR_WIDTH) value=CONCATENATE(vload,VECTOR_WIDTH)( block, input ); CONCATENATE(vstore,VECTOR_WIDTH)( value*value, block, output ); }\n"
+		"#endif\n"
+		"#ifdef WORK_GROUP_SIZE\n"
+		"	#define KERNEL_ATTRIBUTES __attribute__((reqd_work_group_size(WORK_GROUP_SIZE,1,1)))\n"
+		"#else\n"
+		"	#define KERNEL_ATTRIBUTES\n"
+		"#endif\n"
+		"\n"
+		"__kernel KERNEL_ATTRIBUTES void square( __global float* input, const unsigned long inputCount, __global float* output, const unsigned long outputCount )\n"
+		"{\n"
+		"#ifdef ELEMENT_COUNT\n"
+		"	const unsigned long count=ELEMENT_COUNT;\n"
+		"#else\n"
+		"	const unsigned long count=min( inputCount, outputCount );\n"
+		"#endif\n"
+		"	const unsigned long blocks=count/VECTOR_WIDTH; // Whole vectors. The scalar tail is whatever is left over.\n"
+		"#ifdef GRID_STRIDE\n"
+		"	for( unsigned long block=get_global_id(0); block<blocks; block+=get_global_size(0) ) SQUARE_VECTOR(block);\n"
+		"	const unsigned long tailWorkItem=0;\n"
+		"#else\n"
+		"	const unsigned long block=get_global_id(0);\n"
+		"	if( block<blocks ) SQUARE_VECTOR(block);\n"
+		"	const unsigned long tailWorkItem=blocks;\n"
+		"#endif\n"
+		"	if( get_global_id(0)==tailWorkItem )\n"
+		"	{\n"
+		"		for( unsigned long index=blocks*VECTOR_WIDTH; index<count; ++index ) output[index]=input[index]*input[index];\n"
+		"	}\n"
+		"}\n";
+}
+
+size_t tools::preferredVectorWidth( const cl::Device& device )
+{
+	size_t width=std::max( device.getInfo<CL_DEVICE_PREFERRED_VECTOR_WIDTH_FLOAT>(), device.getInfo<CL_DEVICE_NATIVE_VECTOR_WIDTH_FLOAT>() );
+	if( width>16 ) width=16;
+	// Round down to a power of two, since e.g. float3 or float12 don't exist
+	size_t validWidth=1;
+	while( validWidth*2<=width ) validWidth*=2;
+	return validWidth;
+}
+
+bool tools::isValidVectorWidth( size_t width )
+{
+	return width==1 || width==2 || width==4 || width==8 || width==16;
+}
@@ -0,0 +1,35 @@
+#ifndef INCLUDEGUARD_tools_KernelGenerator_h
+#define INCLUDEGUARD_tools_KernelGenerator_h
+
+#include <string>
+#include <CL/cl.hpp>
+
+namespace tools
+{
+	/** @brief OpenCL C source for the "square" test kernel, as a template specialised with build options.
+	 *
+	 * The signature is square( __global float* input, unsigned long inputCount, __global float* output, unsigned long outputCount ).
+	 * Building with "-D VECTOR_WIDTH=<n>" (1, 2, 4, 8 or 16, default 1) makes each work item square
+	 * n consecutive elements with floatn loads and stores, and the work item just past the last whole
+	 * vector does the left over elements one at a time. Launch it with (count+n-1)/n work items.
+	 * Building with "-D GRID_STRIDE" as well makes each work item loop over the vectors with a stride
+	 * of the global size, so any number of work items covers all of the data.
+	 * Building with "-D ELEMENT_COUNT=<n>UL" uses that as the element count instead of the arguments, and
+	 * "-D WORK_GROUP_SIZE=<n>" adds reqd_work_group_size(n,1,1), so the compiler knows both in advance.
+	 */
+	std::string squareKernelSource();
+
+	/** @brief The float vector width to use on the device.
+	 *
+	 * The larger of CL_DEVICE_PREFERRED_VECTOR_WIDTH_FLOAT and CL_DEVICE_NATIVE_VECTOR_WIDTH_FLOAT, rounded
+	 * down to a valid OpenCL vector width (1, 2, 4, 8 or 16). GPUs typically report 1, CPU runtimes the
+	 * SIMD width.
+	 */
+	size_t preferredVectorWidth( const cl::Device& device );
+
+	/** @brief True if width is 1, 2, 4, 8 or 16. */
+	bool isValidVectorWidth( size_t width );
+
+} // end of the tools namespace
+
+#endif
@@ -0,0 +1,350 @@
+#include "KernelSpec.h"
+
+#include <stdexcept>
+#include <fstream>
+#include <sstream>
+#include <ostream>
+#include <random>
+#include <cmath>
+#include <type_traits>
+#include "OpenCLEnums.h"
+#include "Timing.h"
+#include "Trace.h"
+#include "ProgramCache.h"
+#include "DeviceSession.h"
+
+//
+// Unnamed namespace for things only used in this file
+//
+namespace
+{
+	std::vector<char> readFile( const std::string& filename )
+	{
+		std::ifstream file( filename, std::ios::binary | std::ios::ate ); // Open at end to get the length
+		if( !file.is_open() ) throw std::runtime_error( "Unable to open file '"+filename+"'" );
+		std::vector<char> contents( file.tellg() );
+		file.seekg( 0, std::ios::beg );
+		file.read( contents.data(), contents.size() );
+		return contents;
+	}
+
+	/** @brief Relative filenames in a spec file are relative to the directory the spec file is in. */
+	std::string resolvePath( const std::string& specFilename, const std::string& filename )
+	{
+		if( filename.empty() || filename[0]=='/' ) return filename;
+		size_t slashPosition=specFilename.find_last_of('/');
+		if( slashPosition==std::string::npos ) return filename;
+		return specFilename.substr( 0, slashPosition+1 )+filename;
+	}
+
+	/** @brief Fills data with elements of type T. Random values always use the same seed so that runs can be compared. */
+	template<typename T>
+	void fillElements( std::vector<char>& data, const std::string& pattern, const std::string& value )
+	{
+		T* pElements=reinterpret_cast<T*>( data.data() );
+		const size_t count=data.size()/sizeof(T);
+		if( pattern=="random" )
+		{
+			std::mt19937 generator( 0 );
+			typename std::conditional<std::is_floating_point<T>::value, std::uniform_real_distribution<T>, std::uniform_int_distribution<T> >::type distribution;
+			for( size_t index=0; index<count; ++index ) pElements[index]=distribution(generator);
+		}
+		else if( pattern=="sequence" )
+		{
+			for( size_t index=0; index<count; ++index ) pElements[index]=static_cast<T>(index);
+		}
+		else if( pattern=="value" )
+		{
+			std::istringstream valueStream( value );
+			T parsedValue;
+			if( !(valueStream >> parsedValue) ) throw std::runtime_error( "'"+value+"' is not a valid value" );
+			for( size_t index=0; index<count; ++index ) pElements[index]=parsedValue;
+		}
+		else throw std::runtime_error( "Unknown initialisation '"+pattern+"'" );
+	}
+
+	void fillTyped( std::vector<char>& data, const std::string& type, const std::string& pattern, const std::string& value )
+	{
+		if( type=="int" ) fillElements<cl_int>( data, pattern, value );
+		else if( type=="uint" ) fillElements<cl_uint>( data, pattern, value );
+		else if( type=="long" ) fillElements<cl_long>( data, pattern, value );
+		else if( type=="ulong" ) fillElements<cl_ulong>( data, pattern, value );
+		else if( type=="float" ) fillElements<cl_float>( data, pattern, value );
+		else if( type=="double" ) fillElements<cl_double>( data, pattern, value );
+		else throw std::runtime_error( "Unknown type '"+type+"'" );
+	}
+
+	size_t typeSize( const std::string& type )
+	{
+		if( type=="int" || type=="uint" || type=="float" ) return 4;
+		else if( type=="long" || type=="ulong" || type=="double" ) return 8;
+		else throw std::runtime_error( "Unknown type '"+type+"'" );
+	}
+
+	std::vector<size_t> readSizes( std::istringstream& tokens )
+	{
+		std::vector<size_t> sizes;
+		size_t size;
+		while( tokens >> size ) sizes.push_back( size );
+		if( sizes.empty() || sizes.size()>3 ) throw std::runtime_error( "expected one to three sizes" );
+		return sizes;
+	}
+
+	cl::NDRange makeRange( const std::vector<size_t>& sizes )
+	{
+		if( sizes.size()==1 ) return cl::NDRange( sizes[0] );
+		else if( sizes.size()==2 ) return cl::NDRange( sizes[0], sizes[1] );
+		else return cl::NDRange( sizes[0], sizes[1], sizes[2] );
+	}
+} // end of the unnamed namespace
+
+tools::KernelSpec tools::KernelSpec::load( const std::string& filename )
+{
+	std::ifstream file( filename );
+	if( !file.is_open() ) throw std::runtime_error( "Unable to open kernel spec file '"+filename+"'" );
+
+	KernelSpec spec;
+	spec.filename=filename;
+	spec.referenceArgument=-1;
+	spec.tolerance=-1;
+	bool hasProgram=false;
+	std::string referenceFilename;
+
+	std::string line;
+	for( size_t lineNumber=1; std::getline( file, line ); ++lineNumber )
+	{
+		try
+		{
+			line=line.substr( 0, line.find('#') );
+			std::istringstream tokens( line );
+			std::string directive;
+			if( !(tokens >> directive) ) continue; // Blank line
+
+			if( directive=="program" )
+			{
+				std::string programFilename;
+				if( !(tokens >> programFilename) ) throw std::runtime_error( "expected a filename" );
+				programFilename=resolvePath( filename, programFilename );
+				std::vector<char> contents=readFile( programFilename );
+				if( programFilename.size()>3 && programFilename.substr(programFilename.size()-3)==".cl" ) spec.programSource.assign( contents.begin(), contents.end() );
+				else spec.programBinary=contents;
+				hasProgram=true;
+			}
+			else if( directive=="options" ) std::getline( tokens >> std::ws, spec.buildOptions );
+			else if( directive=="kernel" ) tokens >> spec.kernelName;
+			else if( directive=="global" ) spec.globalSize=readSizes( tokens );
+			else if( directive=="local" ) spec.localSize=readSizes( tokens );
+			else if( directive=="arg" )
+			{
+				Argument argument;
+				argument.bytes=0;
+				argument.memoryFlags=0;
+				std::string kind;
+				tokens >> kind;
+				if( kind=="buffer" )
+				{
+					std::string access, initialisation;
+					if( !(tokens >> argument.bytes >> access >> initialisation) ) throw std::runtime_error( "expected 'arg buffer <bytes> <access> <initialisation>'" );
+					if( argument.bytes==0 ) throw std::runtime_error( "buffer size must be greater than zero" );
+					argument.kind=Argument::Buffer;
+					if( access=="read" ) argument.memoryFlags=CL_MEM_READ_ONLY;
+					else if( access=="write" ) argument.memoryFlags=CL_MEM_WRITE_ONLY;
+					else if( access=="readwrite" ) argument.memoryFlags=CL_MEM_READ_WRITE;
+					else throw std::runtime_error( "unknown access '"+access+"', expected read, write or readwrite" );
+
+					argument.initialData.resize( argument.bytes, 0 );
+					if( initialisation=="file" )
+					{
+						std::string dataFilename;
+						tokens >> dataFilename;
+						std::vector<char> contents=readFile( resolvePath( filename, dataFilename ) );
+						if( contents.size()>argument.bytes ) throw std::runtime_error( "'"+dataFilename+"' is larger than the buffer" );
+						std::copy( contents.begin(), contents.end(), argument.initialData.begin() );
+					}
+					else if( initialisation!="zero" )
+					{
+						std::string type, value;
+						tokens >> type >> value;
+						fillTyped( argument.initialData, type, initialisation, value );
+					}
+				}
+				else if( kind=="scalar" )
+				{
+					std::string type, value;
+					if( !(tokens >> type >> value) ) throw std::runtime_error( "expected 'arg scalar <type> <value>'" );
+					argument.kind=Argument::Scalar;
+					argument.bytes=typeSize( type );
+					argument.initialData.resize( argument.bytes );
+					fillTyped( argument.initialData, type, "value", value );
+				}
+				else if( kind=="local" )
+				{
+					if( !(tokens >> argument.bytes) ) throw std::runtime_error( "expected 'arg local <bytes>'" );
+					argument.kind=Argument::Local;
+				}
+				else throw std::runtime_error( "unknown argument kind '"+kind+"', expected buffer, scalar or local" );
+				spec.arguments.push_back( std::move(argument) );
+			}
+			else if( directive=="reference" )
+			{
+				if( !(tokens >> spec.referenceArgument >> referenceFilename) ) throw std::runtime_error( "expected 'reference <argument index> <filename> [<tolerance>]'" );
+				tokens >> spec.tolerance; // Optional, left negative if not there
+				spec.referenceData=readFile( resolvePath( filename, referenceFilename ) );
+			}
+			else throw std::runtime_error( "unknown directive '"+directive+"'" );
+		}
+		catch( std::exception& error )
+		{
+			throw std::runtime_error( filename+":"+std::to_string(lineNumber)+": "+error.what() );
+		}
+	}
+
+	if( !hasProgram ) throw std::runtime_error( filename+": no 'program' given" );
+	if( spec.globalSize.empty() ) throw std::runtime_error( filename+": no 'global' size given" );
+	if( !spec.localSize.empty() && spec.localSize.size()!=spec.globalSize.size() ) throw std::runtime_error( filename+": 'local' has a different number of dimensions to 'global'" );
+	if( spec.referenceArgument>=0 )
+	{
+		if( static_cast<size_t>(spec.referenceArgument)>=spec.arguments.size() || spec.arguments[spec.referenceArgument].kind!=Argument::Buffer )
+		{
+			throw std::runtime_error( filename+": the reference must be for a buffer argument" );
+		}
+		if( spec.referenceData.size()>spec.arguments[spec.referenceArgument].bytes ) throw std::runtime_error( filename+": '"+referenceFilename+"' is larger than the buffer" );
+	}
+	return spec;
+}
+
+tools::KernelHarness::KernelHarness( const cl::Device& device, const KernelSpec& spec, bool enableProfiling, tools::ProgramCache* pProgramCache, tools::PhaseTimings* pTimings,
+		tools::BufferPool* pBufferPool )
+	: spec_(spec), device_(device), profilingEnabled_(enableProfiling)
+{
+	cl_int error=CL_SUCCESS;
+
+	tools::StopWatch stopWatch;
+	if( pBufferPool ) context_=pBufferPool->context( device_ );
+	else
+	{
+		context_=tools::trace::createContext( device_, &error );
+		if( error!=CL_SUCCESS ) throw std::runtime_error( "Error when creating context - "+tools::contextCreateError(error) );
+	}
+	if( pTimings ) pTimings->phase( "context" ).addSample( stopWatch.elapsed() );
+
+	queue_=cl::CommandQueue( context_, device_, enableProfiling ? CL_QUEUE_PROFILING_ENABLE : 0, &error );
+	if( error!=CL_SUCCESS ) throw std::runtime_error( "Error when creating command queue - "+tools::createQueueError(error) );
+
+	stopWatch.reset();
+	program_=tools::DeviceSession::buildProgram( context_, device_, spec_.programSource, spec_.programBinary, spec_.buildOptions, spec_.filename, pProgramCache );
+
+	kernelName_=spec_.kernelName;
+	if( kernelName_.empty() )
+	{
+		kernelName_=program_.getInfo<CL_PROGRAM_KERNEL_NAMES>(&error);
+		if( error!=CL_SUCCESS ) throw std::runtime_error( "Error getting the kernel name" );
+		if( kernelName_.find(';')!=std::string::npos ) throw std::runtime_error( spec_.filename+": the program has several kernels ("+kernelName_+"), choose one with 'kernel'" );
+	}
+	if( pTimings ) pTimings->phase( "build "+kernelName_ ).addSample( stopWatch.elapsed() );
+
+	kernel_=cl::Kernel( program_, kernelName_.c_str(), &error );
+	if( error!=CL_SUCCESS ) throw std::runtime_error( "Error when creating kernel '"+kernelName_+"' - "+tools::createKernelError(error) );
+
+	//
+	// Create the buffers and set the arguments. These stay set for every run.
+	//
+	buffers_.resize( spec_.arguments.size() );
+	for( size_t index=0; index<spec_.arguments.size(); ++index )
+	{
+		const KernelSpec::Argument& argument=spec_.arguments[index];
+		if( argument.kind==KernelSpec::Argument::Buffer )
+		{
+			if( pBufferPool ) buffers_[index]=pBufferPool->acquire( context_, argument.memoryFlags, argument.bytes, nullptr, &error );
+			else buffers_[index]=tools::PooledBuffer( tools::trace::createBuffer( context_, argument.memoryFlags, argument.bytes, nullptr, &error ) );
+			if( error!=CL_SUCCESS ) throw std::runtime_error( "Error when creating the buffer for argument "+std::to_string(index)+" - "+tools::createBufferError(error) );
+			error=kernel_.setArg( index, buffers_[index].buffer() );
+		}
+		else if( argument.kind==KernelSpec::Argument::Scalar ) error=kernel_.setArg( index, argument.bytes, argument.initialData.data() );
+		else error=kernel_.setArg( index, argument.bytes, nullptr ); // A null pointer means local memory of that size
+		if( error!=CL_SUCCESS ) throw std::runtime_error( "Error when setting kernel argument "+std::to_string(index)+": "+tools::setKernelArgError(error) );
+	}
+}
+
+void tools::KernelHarness::run( tools::PhaseTimings* pTimings )
+{
+	cl_int error=CL_SUCCESS;
+
+	// Reset every buffer, even write only ones, in case the kernel doesn't write all of its output
+	std::vector<cl::Event> writeEvents;
+	size_t bytesWritten=0;
+	for( size_t index=0; index<spec_.arguments.size(); ++index )
+	{
+		const KernelSpec::Argument& argument=spec_.arguments[index];
+		if( argument.kind!=KernelSpec::Argument::Buffer ) continue;
+		writeEvents.push_back( cl::Event() );
+		error=tools::trace::enqueueWriteBuffer( queue_, buffers_[index].buffer(), CL_FALSE, 0, argument.bytes, argument.initialData.data(), nullptr, &writeEvents.back() );
+		if( error!=CL_SUCCESS ) throw std::runtime_error( "Error when initialising the buffer for argument "+std::to_string(index) );
+		bytesWritten+=argument.bytes;
+	}
+
+	cl::Event kernelEvent;
+	error=tools::trace::enqueueNDRangeKernel( queue_, kernel_, cl::NullRange, makeRange(spec_.globalSize), spec_.localSize.empty() ? cl::NullRange : makeRange(spec_.localSize), nullptr, &kernelEvent );
+	if( error!=CL_SUCCESS ) throw std::runtime_error( "Error when enqueing kernel - "+tools::enqueKernelError(error) );
+
+	cl::Event readEvent;
+	if( spec_.referenceArgument>=0 )
+	{
+		output_.resize( spec_.referenceData.size() );
+		error=tools::trace::enqueueReadBuffer( queue_, buffers_[spec_.referenceArgument].buffer(), CL_FALSE, 0, output_.size(), output_.data(), nullptr, &readEvent );
+		if( error!=CL_SUCCESS ) throw std::runtime_error( "Error when copying output out" );
+	}
+	tools::trace::finish( queue_ );
+
+	if( pTimings && profilingEnabled_ )
+	{
+		size_t workItems=1;
+		for( const auto size : spec_.globalSize ) workItems*=size;
+
+		double writeTime=0;
+		for( const auto& event : writeEvents ) writeTime+=tools::eventDuration(event);
+		if( !writeEvents.empty() ) pTimings->phase( "write "+kernelName_, bytesWritten ).addSample( writeTime );
+		pTimings->phase( "kernel "+kernelName_, 0, workItems ).addSample( tools::eventDuration(kernelEvent) );
+		if( spec_.referenceArgument>=0 ) pTimings->phase( "read "+kernelName_, output_.size() ).addSample( tools::eventDuration(readEvent) );
+	}
+}
+
+bool tools::KernelHarness::matchesReference( std::ostream* pReport ) const
+{
+	if( spec_.referenceArgument<0 ) return true;
+
+	const std::vector<char>& expected=spec_.referenceData;
+	size_t mismatches=0, elements=0, firstMismatch=0;
+	if( spec_.tolerance<0 )
+	{
+		elements=expected.size();
+		for( size_t index=0; index<elements; ++index )
+		{
+			if( output_[index]!=expected[index] && mismatches++==0 ) firstMismatch=index;
+		}
+		if( pReport && mismatches ) *pReport << "   " << mismatches << "/" << elements << " bytes differ from the reference, the first at byte " << firstMismatch << std::endl;
+	}
+	else
+	{
+		const cl_float* pExpected=reinterpret_cast<const cl_float*>( expected.data() );
+		const cl_float* pOutput=reinterpret_cast<const cl_float*>( output_.data() );
+		elements=expected.size()/sizeof(cl_float);
+		for( size_t index=0; index<elements; ++index )
+		{
+			// Written so that NaNs count as mismatches
+			if( !(std::fabs( pOutput[index]-pExpected[index] )<=spec_.tolerance) && mismatches++==0 ) firstMismatch=index;
+		}
+		if( pReport && mismatches )
+		{
+			*pReport << "   " << mismatches << "/" << elements << " elements differ from the reference by more than " << spec_.tolerance
+					<< ", the first is element " << firstMismatch << " (" << pOutput[firstMismatch] << " instead of " << pExpected[firstMismatch] << ")" << std::endl;
+		}
+	}
+	if( pReport && mismatches==0 ) *pReport << "   Output matches the reference." << std::endl;
+	return mismatches==0;
+}
+
+const std::string& tools::KernelHarness::kernelName() const
+{
+	return kernelName_;
+}
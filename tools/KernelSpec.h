@@ -0,0 +1,115 @@
+#ifndef INCLUDEGUARD_tools_KernelSpec_h
+#define INCLUDEGUARD_tools_KernelSpec_h
+
+#include <vector>
+#include <string>
+#include <iosfwd>
+#include <CL/cl.hpp>
+#include "BufferPool.h"
+
+//
+// Forward declarations
+//
+namespace tools
+{
+	class PhaseTimings;
+	class ProgramCache;
+}
+
+namespace tools
+{
+	/** @brief Describes how to run an arbitrary kernel: the program, the kernel arguments, the NDRange and the expected output.
+	 *
+	 * Loaded from a text file with one directive per line. Blank lines and anything after a '#' are ignored.
+	 * @code
+	 *   program   <filename>               # OpenCL C source if it ends in ".cl", otherwise a binary such as SPIR
+	 *   options   <build options...>       # Optional
+	 *   kernel    <name>                   # Optional if the program only has one kernel
+	 *   global    <x> [<y> [<z>]]
+	 *   local     <x> [<y> [<z>]]          # Optional, the default lets the runtime choose
+	 *   arg buffer <bytes> <read|write|readwrite> <initialisation>
+	 *   arg scalar <type> <value>
+	 *   arg local  <bytes>
+	 *   reference <argument index> <filename> [<tolerance>]
+	 * @endcode
+	 * The "arg" lines are for argument 0, 1, 2 and so on in order. Buffer initialisation is one of "zero",
+	 * "random <type>", "sequence <type>" (0, 1, 2...), "value <type> <value>" or "file <filename>". Types are
+	 * int, uint, long, ulong, float or double. Relative filenames are relative to the spec file. The reference
+	 * file is compared byte for byte with the buffer argument after the kernel has run, or element by
+	 * element as floats if a tolerance is given.
+	 */
+	struct KernelSpec
+	{
+		struct Argument
+		{
+			enum Kind { Buffer, Scalar, Local };
+			Kind kind;
+			size_t bytes; ///< @brief Size of a buffer or local memory argument
+			cl_mem_flags memoryFlags; ///< @brief CL_MEM_READ_ONLY, CL_MEM_WRITE_ONLY or CL_MEM_READ_WRITE for buffers
+			std::vector<char> initialData; ///< @brief Initial contents of a buffer, or the value of a scalar
+		};
+
+		/** @brief Reads and checks a spec file, including loading the program and any initialisation files.
+		 *
+		 * @throw std::runtime_error     If the file can't be read or has errors. The message gives the line number.
+		 */
+		static KernelSpec load( const std::string& filename );
+
+		std::string filename; ///< @brief The spec file, only used to label output
+		std::string programSource; ///< @brief OpenCL C source. Empty if programBinary is used.
+		std::vector<char> programBinary;
+		std::string buildOptions;
+		std::string kernelName; ///< @brief Empty to use the only kernel in the program
+		std::vector<size_t> globalSize;
+		std::vector<size_t> localSize; ///< @brief Empty for a NULL local size
+		std::vector<Argument> arguments;
+		int referenceArgument; ///< @brief Negative if there is no reference output
+		std::vector<char> referenceData;
+		double tolerance; ///< @brief Negative for an exact comparison
+	};
+
+	/** @brief Runs the kernel described by a KernelSpec on one device, so that it can be repeated and timed. */
+	class KernelHarness
+	{
+	public:
+		/** @brief Creates the context, queue and buffers, builds the program and sets the arguments.
+		 *
+		 * The spec must outlive the harness.
+		 * @param pTimings      If not null, the "context" and "build <kernel>" phases are filled.
+		 * @param pBufferPool   If not null, the pool's context for the device is used and the buffers come from the pool.
+		 * @throw std::runtime_error     If any of the OpenCL calls fail.
+		 */
+		KernelHarness( const cl::Device& device, const KernelSpec& spec, bool enableProfiling, tools::ProgramCache* pProgramCache=nullptr, tools::PhaseTimings* pTimings=nullptr,
+				tools::BufferPool* pBufferPool=nullptr );
+
+		/** @brief Resets the buffers to their initial contents and runs the kernel once.
+		 *
+		 * If pTimings is not null the "write <kernel>", "kernel <kernel>" and "read <kernel>" phases are
+		 * filled (profiling must be enabled). The read is of the reference argument, if there is one.
+		 * @throw std::runtime_error     If any of the OpenCL calls fail.
+		 */
+		void run( tools::PhaseTimings* pTimings=nullptr );
+
+		/** @brief Compares the output of the last run with the reference. Always true if there is no reference.
+		 *
+		 * If pReport is not null the number of mismatches and the first one are printed to it.
+		 */
+		bool matchesReference( std::ostream* pReport=nullptr ) const;
+
+		const std::string& kernelName() const;
+	protected:
+		const KernelSpec& spec_;
+		cl::Device device_;
+		cl::Context context_;
+		cl::CommandQueue queue_;
+		cl::Program program_;
+		cl::Kernel kernel_;
+		std::string kernelName_;
+		std::vector<tools::PooledBuffer> buffers_; ///< @brief One for each argument, only valid for buffer arguments.
+		std::vector<char> output_; ///< @brief The reference argument read back after the last run
+		bool profilingEnabled_;
+	};
+
+} // end of the tools namespace
+
+#endif
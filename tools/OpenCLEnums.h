@@ -1,3 +1,7 @@
+#ifndef INCLUDEGUARD_tools_OpenCLEnums_h
+#define INCLUDEGUARD_tools_OpenCLEnums_h
+
+#include <string>
 #include <CL/cl.hpp>
 
 //
@@ -18,7 +22,7 @@ namespace cl{ namespace detail {
 
 namespace tools
 {
-	std::string deviceType( cl_device_type type )
+	inline std::string deviceType( cl_device_type type )
 	{
 		switch( type )
 		{
@@ -39,7 +43,7 @@ namespace tools
 		}
 	}
 
-	std::string kernelEnqueError( cl_int error )
+	inline std::string kernelEnqueError( cl_int error )
 	{
         switch( error )
         {
@@ -61,7 +65,7 @@ namespace tools
         }
 	}
 
-	std::string contextCreateError( cl_int error )
+	inline std::string contextCreateError( cl_int error )
 	{
         switch( error )
         {
@@ -79,20 +83,86 @@ namespace tools
         }
 	}
 
-	std::string createProgramError( cl_int error )
+	inline std::string createSubDevicesError( cl_int error )
+	{
+        switch( error )
+        {
+        	case CL_SUCCESS : return "CL_SUCCESS";
+        	case CL_INVALID_DEVICE : return "CL_INVALID_DEVICE";
+        	case CL_INVALID_VALUE : return "CL_INVALID_VALUE";
+        	case CL_DEVICE_PARTITION_FAILED : return "CL_DEVICE_PARTITION_FAILED";
+        	case CL_INVALID_DEVICE_PARTITION_COUNT : return "CL_INVALID_DEVICE_PARTITION_COUNT";
+        	case CL_OUT_OF_RESOURCES : return "CL_OUT_OF_RESOURCES";
+        	case CL_OUT_OF_HOST_MEMORY : return "CL_OUT_OF_HOST_MEMORY";
+        	default : return "<unknown>";
+        }
+	}
+
+	inline std::string createQueueError( cl_int error )
 	{
         switch( error )
         {
         	case CL_SUCCESS : return "CL_SUCCESS";
         	case CL_INVALID_CONTEXT : return "CL_INVALID_CONTEXT";
+        	case CL_INVALID_DEVICE : return "CL_INVALID_DEVICE";
         	case CL_INVALID_VALUE : return "CL_INVALID_VALUE";
+        	case CL_INVALID_QUEUE_PROPERTIES : return "CL_INVALID_QUEUE_PROPERTIES";
         	case CL_OUT_OF_RESOURCES : return "CL_OUT_OF_RESOURCES";
         	case CL_OUT_OF_HOST_MEMORY : return "CL_OUT_OF_HOST_MEMORY";
         	default : return "<unknown>";
         }
 	}
 
-	std::string createKernelError( cl_int error )
+	inline std::string createBufferError( cl_int error )
+	{
+        switch( error )
+        {
+        	case CL_SUCCESS : return "CL_SUCCESS";
+        	case CL_INVALID_CONTEXT : return "CL_INVALID_CONTEXT";
+        	case CL_INVALID_VALUE : return "CL_INVALID_VALUE";
+        	case CL_INVALID_BUFFER_SIZE : return "CL_INVALID_BUFFER_SIZE";
+        	case CL_INVALID_HOST_PTR : return "CL_INVALID_HOST_PTR";
+        	case CL_MEM_OBJECT_ALLOCATION_FAILURE : return "CL_MEM_OBJECT_ALLOCATION_FAILURE";
+        	case CL_OUT_OF_RESOURCES : return "CL_OUT_OF_RESOURCES";
+        	case CL_OUT_OF_HOST_MEMORY : return "CL_OUT_OF_HOST_MEMORY";
+        	default : return "<unknown>";
+        }
+	}
+
+	inline std::string mapBufferError( cl_int error )
+	{
+        switch( error )
+        {
+        	case CL_SUCCESS : return "CL_SUCCESS";
+        	case CL_INVALID_COMMAND_QUEUE : return "CL_INVALID_COMMAND_QUEUE";
+        	case CL_INVALID_CONTEXT : return "CL_INVALID_CONTEXT";
+        	case CL_INVALID_MEM_OBJECT : return "CL_INVALID_MEM_OBJECT";
+        	case CL_INVALID_VALUE : return "CL_INVALID_VALUE";
+        	case CL_INVALID_EVENT_WAIT_LIST : return "CL_INVALID_EVENT_WAIT_LIST";
+        	case CL_MISALIGNED_SUB_BUFFER_OFFSET : return "CL_MISALIGNED_SUB_BUFFER_OFFSET";
+        	case CL_MAP_FAILURE : return "CL_MAP_FAILURE";
+        	case CL_INVALID_OPERATION : return "CL_INVALID_OPERATION";
+        	case CL_MEM_OBJECT_ALLOCATION_FAILURE : return "CL_MEM_OBJECT_ALLOCATION_FAILURE";
+        	case CL_OUT_OF_RESOURCES : return "CL_OUT_OF_RESOURCES";
+        	case CL_OUT_OF_HOST_MEMORY : return "CL_OUT_OF_HOST_MEMORY";
+        	default : return "<unknown>";
+        }
+	}
+
+	inline std::string createProgramError( cl_int error )
+	{
+        switch( error )
+        {
+        	case CL_SUCCESS : return "CL_SUCCESS";
+        	case CL_INVALID_CONTEXT : return "CL_INVALID_CONTEXT";
+        	case CL_INVALID_VALUE : return "CL_INVALID_VALUE";
+        	case CL_OUT_OF_RESOURCES : return "CL_OUT_OF_RESOURCES";
+        	case CL_OUT_OF_HOST_MEMORY : return "CL_OUT_OF_HOST_MEMORY";
+        	default : return "<unknown>";
+        }
+	}
+
+	inline std::string createKernelError( cl_int error )
 	{
         switch( error )
         {
@@ -108,7 +178,7 @@ namespace tools
         }
 	}
 
-	std::string setKernelArgError( cl_int error )
+	inline std::string setKernelArgError( cl_int error )
 	{
         switch( error )
         {
@@ -125,7 +195,7 @@ namespace tools
         }
 	}
 
-	std::string enqueKernelError( cl_int error )
+	inline std::string enqueKernelError( cl_int error )
 	{
         switch( error )
         {
@@ -148,3 +218,5 @@ namespace tools
 	}
 
 } // end of namespace tools
+
+#endif
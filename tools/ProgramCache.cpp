@@ -0,0 +1,190 @@
+#include "ProgramCache.h"
+
+#include <stdexcept>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <iterator>
+#include <cstdio>
+#include <cstdlib>
+#include <cerrno>
+#include <cstring>
+#include <thread>
+#include <functional>
+#include <sys/stat.h>
+#include "OpenCLEnums.h"
+#include "Timing.h"
+#include "Trace.h"
+#include "DeviceSession.h"
+
+//
+// Unnamed namespace for things only used in this file
+//
+namespace
+{
+	/** @brief 64 bit FNV-1a hash. Not cryptographic, but plenty to tell programs apart. */
+	uint64_t fnv1a( const char* data, size_t size, uint64_t hash=14695981039346656037ULL )
+	{
+		for( size_t index=0; index<size; ++index )
+		{
+			hash^=static_cast<unsigned char>(data[index]);
+			hash*=1099511628211ULL;
+		}
+		return hash;
+	}
+
+	std::string toHex( uint64_t value )
+	{
+		std::stringstream stream;
+		stream << std::hex << std::setw(16) << std::setfill('0') << value;
+		return stream.str();
+	}
+
+	/** @brief Equivalent of "mkdir -p". Throws if any part of the path can't be created. */
+	void makeDirectories( const std::string& path )
+	{
+		size_t position=0;
+		do
+		{
+			position=path.find( '/', position+1 );
+			std::string partialPath=path.substr( 0, position );
+			if( partialPath.empty() ) continue;
+			if( ::mkdir( partialPath.c_str(), 0755 )!=0 && errno!=EEXIST )
+			{
+				throw std::runtime_error( "Unable to create directory '"+partialPath+"' - "+std::strerror(errno) );
+			}
+		} while( position!=std::string::npos );
+	}
+
+	/** @brief Writes to a temporary file and then renames it, so that other processes never see a partial file. */
+	bool writeFile( const std::string& filename, const char* data, size_t size )
+	{
+		std::stringstream temporaryName;
+		temporaryName << filename << ".tmp" << std::hash<std::thread::id>()( std::this_thread::get_id() );
+		{ // Limit the scope so that the file is closed before renaming
+			std::ofstream outputFile( temporaryName.str(), std::ios::binary );
+			if( !outputFile.is_open() ) return false;
+			outputFile.write( data, size );
+			if( !outputFile.good() ) return false;
+		}
+		return std::rename( temporaryName.str().c_str(), filename.c_str() )==0;
+	}
+
+	/** @brief Gets the binary for the (single) device the program was built for. */
+	std::vector<char> programBinary( const cl::Program& program )
+	{
+		size_t binarySize=0;
+		cl_int error=clGetProgramInfo( program(), CL_PROGRAM_BINARY_SIZES, sizeof(size_t), &binarySize, nullptr );
+		if( error!=CL_SUCCESS || binarySize==0 ) return std::vector<char>();
+
+		std::vector<char> binary( binarySize );
+		char* pBinary=binary.data();
+		error=clGetProgramInfo( program(), CL_PROGRAM_BINARIES, sizeof(char*), &pBinary, nullptr );
+		if( error!=CL_SUCCESS ) return std::vector<char>();
+		return binary;
+	}
+} // end of the unnamed namespace
+
+tools::ProgramCache::ProgramCache( const std::string& directory )
+	: directory_(directory), hits_(0), misses_(0), timeSaved_(0)
+{
+	while( directory_.size()>1 && directory_.back()=='/' ) directory_.pop_back();
+	makeDirectories( directory_ );
+}
+
+cl::Program tools::ProgramCache::build( const cl::Context& context, const cl::Device& device, const std::string& source,
+		const std::vector<char>& binary, const std::string& options, bool* pFromCache )
+{
+	//
+	// Work out the key. The full text is kept in the info file to guard against hash collisions.
+	//
+	std::stringstream keyText;
+	keyText << "device " << device.getInfo<CL_DEVICE_NAME>() << "\n"
+			<< "driver " << device.getInfo<CL_DRIVER_VERSION>() << "\n"
+			<< "options " << options << "\n"
+			<< "content " << ( binary.empty() ? toHex( fnv1a(source.data(),source.size()) ) : toHex( fnv1a(binary.data(),binary.size()) ) ) << "\n";
+	const std::string key=keyText.str();
+	const std::string basename=directory_+"/"+toHex( fnv1a(key.data(),key.size()) );
+
+	//
+	// See if there is already an entry
+	//
+	std::ifstream infoFile( basename+".info" );
+	std::ifstream binaryFile( basename+".bin", std::ios::binary );
+	if( infoFile.is_open() && binaryFile.is_open() )
+	{
+		std::string storedKey;
+		std::string line;
+		double originalBuildTime=0;
+		while( std::getline( infoFile, line ) )
+		{
+			if( line.compare( 0, 10, "buildTime " )==0 ) originalBuildTime=std::atof( line.c_str()+10 );
+			else storedKey+=line+"\n";
+		}
+
+		if( storedKey==key )
+		{
+			tools::StopWatch stopWatch;
+			std::vector<char> cachedBinary( (std::istreambuf_iterator<char>(binaryFile)), std::istreambuf_iterator<char>() );
+			try
+			{
+				cl::Program program=tools::DeviceSession::buildProgram( context, device, "", cachedBinary, options, "(cache hit)" );
+				double loadTime=stopWatch.elapsed();
+				if( pFromCache ) *pFromCache=true;
+				std::lock_guard<std::mutex> lock(mutex_);
+				++hits_;
+				timeSaved_+=originalBuildTime-loadTime;
+				return program;
+			}
+			catch( std::exception& error )
+			{
+				// The runtime didn't like the cached binary (maybe it's been corrupted). Just
+				// continue and treat it as a miss, so that it gets overwritten.
+			}
+		}
+	}
+
+	//
+	// Not in the cache, so build normally and store the result
+	//
+	tools::StopWatch stopWatch;
+	cl::Program program=tools::DeviceSession::buildProgram( context, device, source, binary, options, "(cache miss)" );
+	double buildTime=stopWatch.elapsed();
+
+	std::vector<char> builtBinary=programBinary( program );
+	if( !builtBinary.empty() && writeFile( basename+".bin", builtBinary.data(), builtBinary.size() ) )
+	{
+		std::stringstream infoText;
+		infoText << key << "buildTime " << std::setprecision(9) << buildTime << "\n";
+		const std::string info=infoText.str();
+		writeFile( basename+".info", info.data(), info.size() );
+	}
+
+	if( pFromCache ) *pFromCache=false;
+	std::lock_guard<std::mutex> lock(mutex_);
+	++misses_;
+	return program;
+}
+
+const std::string& tools::ProgramCache::directory() const
+{
+	return directory_;
+}
+
+size_t tools::ProgramCache::hits() const
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+	return hits_;
+}
+
+size_t tools::ProgramCache::misses() const
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+	return misses_;
+}
+
+double tools::ProgramCache::timeSaved() const
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+	return timeSaved_;
+}
@@ -0,0 +1,53 @@
+#ifndef INCLUDEGUARD_tools_ProgramCache_h
+#define INCLUDEGUARD_tools_ProgramCache_h
+
+#include <vector>
+#include <string>
+#include <mutex>
+#include <CL/cl.hpp>
+
+namespace tools
+{
+	/** @brief Stores built program binaries (CL_PROGRAM_BINARIES) on disk so that later runs can skip compilation.
+	 *
+	 * Entries are keyed by a hash of the device name, CL_DRIVER_VERSION, the build options and a hash of
+	 * the source or binary (e.g. SPIR) bytes. Each entry is two files in the cache directory: "<key>.bin"
+	 * with the program binary, and "<key>.info" with the full key text and how long the original build
+	 * took, so that the time saved by each hit can be reported. Safe to use from several threads at once.
+	 */
+	class ProgramCache
+	{
+	public:
+		/** @brief The directory is created (including parents) if it doesn't exist.
+		 *
+		 * @throw std::runtime_error     If the directory can't be created.
+		 */
+		explicit ProgramCache( const std::string& directory );
+
+		/** @brief Returns a built program for the device, loading it from the cache if possible.
+		 *
+		 * If "binary" is empty the program is created from "source", otherwise from "binary". On a
+		 * cache miss (or if the cached binary is rejected by the runtime) the program is built normally
+		 * and the result saved in the cache.
+		 * @param pFromCache   If not null, set to whether the program was loaded from the cache.
+		 * @throw std::runtime_error     If the program can't be created or built.
+		 */
+		cl::Program build( const cl::Context& context, const cl::Device& device, const std::string& source,
+				const std::vector<char>& binary, const std::string& options, bool* pFromCache=nullptr );
+
+		const std::string& directory() const;
+		size_t hits() const;
+		size_t misses() const;
+		/** @brief Total seconds saved over all hits, i.e. the original build times minus the load times. */
+		double timeSaved() const;
+	protected:
+		std::string directory_;
+		mutable std::mutex mutex_; ///< @brief Protects the statistics below.
+		size_t hits_;
+		size_t misses_;
+		double timeSaved_;
+	};
+
+} // end of the tools namespace
+
+#endif
@@ -0,0 +1,379 @@
+#include "ResultsReport.h"
+
+#include <stdexcept>
+#include <fstream>
+#include <sstream>
+#include <ostream>
+#include <iomanip>
+#include <limits>
+#include <map>
+#include <cmath>
+#include <cstdlib>
+#include <cstdio>
+#include <cctype>
+#include "Timing.h"
+#include "stringTools.h"
+
+//
+// Unnamed namespace for things only used in this file
+//
+namespace
+{
+	/** @brief Quotes the field if it has commas, quotes or newlines in it. */
+	std::string csvEscape( const std::string& text )
+	{
+		if( text.find_first_of( ",\"\n" )==std::string::npos ) return text;
+		std::string escaped="\"";
+		for( const char character : text )
+		{
+			if( character=='"' ) escaped+="\"\"";
+			else escaped+=character;
+		}
+		return escaped+"\"";
+	}
+
+	/** @brief Non-finite samples (e.g. a bandwidth from a zero time) are left out. */
+	tools::TimingStatistics statisticsOf( const tools::ResultsReport::Measurement& measurement )
+	{
+		tools::TimingStatistics statistics;
+		for( const auto sample : measurement.samples )
+		{
+			if( std::isfinite(sample) ) statistics.addSample( sample );
+		}
+		return statistics;
+	}
+
+	/** @brief JSON has no infinity or NaN, so those are written as null. */
+	void writeJsonNumber( std::ostream& output, double value )
+	{
+		if( std::isfinite(value) ) output << value;
+		else output << "null";
+	}
+
+	/** @brief The key measurements are matched with the baseline on. */
+	std::string comparisonKey( const tools::ResultsReport::Measurement& measurement )
+	{
+		return measurement.device+"\t"+measurement.name+"\t"+std::to_string(measurement.elements)+"\t"+std::to_string(measurement.bytes);
+	}
+
+	/** @brief Of the finite samples, as statisticsOf. */
+	double variance( const std::vector<double>& samples, double mean )
+	{
+		double sum=0;
+		size_t count=0;
+		for( const auto sample : samples )
+		{
+			if( !std::isfinite(sample) ) continue;
+			sum+=(sample-mean)*(sample-mean);
+			++count;
+		}
+		if( count<2 ) return 0;
+		return sum/(count-1);
+	}
+
+	/** @brief Just enough of a JSON parser to read back what writeJson writes. Numbers are kept as doubles. */
+	struct JsonValue
+	{
+		enum Type { Null, Boolean, Number, String, Array, Object };
+		Type type;
+		bool boolean;
+		double number;
+		std::string string;
+		std::vector<JsonValue> array;
+		std::map<std::string,JsonValue> object;
+
+		const JsonValue& member( const std::string& name ) const
+		{
+			auto iFind=object.find(name);
+			if( type!=Object || iFind==object.end() ) throw std::runtime_error( "missing '"+name+"'" );
+			return iFind->second;
+		}
+	};
+
+	class JsonParser
+	{
+	public:
+		explicit JsonParser( const std::string& text ) : text_(text), position_(0) {}
+		JsonValue parseDocument()
+		{
+			JsonValue value=parseValue();
+			skipWhitespace();
+			if( position_!=text_.size() ) fail( "unexpected text after the end" );
+			return value;
+		}
+	protected:
+		void fail( const std::string& message ) const
+		{
+			throw std::runtime_error( "JSON error at character "+std::to_string(position_)+": "+message );
+		}
+		void skipWhitespace()
+		{
+			while( position_<text_.size() && std::isspace( static_cast<unsigned char>(text_[position_]) ) ) ++position_;
+		}
+		void expect( char character )
+		{
+			skipWhitespace();
+			if( position_>=text_.size() || text_[position_]!=character ) fail( std::string("expected '")+character+"'" );
+			++position_;
+		}
+		bool consume( char character )
+		{
+			skipWhitespace();
+			if( position_<text_.size() && text_[position_]==character ) { ++position_; return true; }
+			return false;
+		}
+		bool consumeWord( const std::string& word )
+		{
+			if( text_.compare( position_, word.size(), word )!=0 ) return false;
+			position_+=word.size();
+			return true;
+		}
+		std::string parseString()
+		{
+			expect( '"' );
+			std::string result;
+			while( position_<text_.size() && text_[position_]!='"' )
+			{
+				char character=text_[position_++];
+				if( character=='\\' )
+				{
+					if( position_>=text_.size() ) break;
+					character=text_[position_++];
+					if( character=='n' ) character='\n';
+					else if( character=='t' ) character='\t';
+					else if( character=='r' ) character='\r';
+					else if( character=='u' )
+					{
+						// Only control characters are written this way, so a single byte is enough
+						character=static_cast<char>( std::strtol( text_.substr( position_, 4 ).c_str(), nullptr, 16 ) );
+						position_+=4;
+					}
+				}
+				result+=character;
+			}
+			expect( '"' );
+			return result;
+		}
+		JsonValue parseValue()
+		{
+			JsonValue value;
+			value.type=JsonValue::Null;
+			skipWhitespace();
+			if( position_>=text_.size() ) fail( "unexpected end" );
+
+			const char character=text_[position_];
+			if( character=='{' )
+			{
+				++position_;
+				value.type=JsonValue::Object;
+				if( consume('}') ) return value;
+				do
+				{
+					skipWhitespace();
+					std::string name=parseString();
+					expect( ':' );
+					value.object[name]=parseValue();
+				} while( consume(',') );
+				expect( '}' );
+			}
+			else if( character=='[' )
+			{
+				++position_;
+				value.type=JsonValue::Array;
+				if( consume(']') ) return value;
+				do { value.array.push_back( parseValue() ); } while( consume(',') );
+				expect( ']' );
+			}
+			else if( character=='"' )
+			{
+				value.type=JsonValue::String;
+				value.string=parseString();
+			}
+			else if( consumeWord("true") ) { value.type=JsonValue::Boolean; value.boolean=true; }
+			else if( consumeWord("false") ) { value.type=JsonValue::Boolean; value.boolean=false; }
+			else if( consumeWord("null") ) value.type=JsonValue::Null;
+			else
+			{
+				const char* pStart=text_.c_str()+position_;
+				char* pEnd;
+				value.type=JsonValue::Number;
+				value.number=std::strtod( pStart, &pEnd );
+				if( pEnd==pStart ) fail( "unexpected character" );
+				position_+=pEnd-pStart;
+			}
+			return value;
+		}
+
+		const std::string& text_;
+		size_t position_;
+	};
+} // end of the unnamed namespace
+
+void tools::ResultsReport::addTimings( const std::string& device, const std::string& driver, const tools::PhaseTimings& timings )
+{
+	for( const auto& phase : timings.phases() )
+	{
+		measurements_.push_back( Measurement{ device, driver, phase.name, "s", false, phase.elements, phase.bytes, phase.statistics.samples() } );
+	}
+}
+
+void tools::ResultsReport::addSamples( const std::string& device, const std::string& driver, const std::string& name, const std::string& unit,
+		bool higherIsBetter, const std::vector<double>& samples, uint64_t elements, uint64_t bytes )
+{
+	measurements_.push_back( Measurement{ device, driver, name, unit, higherIsBetter, elements, bytes, samples } );
+}
+
+void tools::ResultsReport::addValue( const std::string& device, const std::string& driver, const std::string& name, const std::string& unit,
+		bool higherIsBetter, double value, uint64_t elements, uint64_t bytes )
+{
+	addSamples( device, driver, name, unit, higherIsBetter, std::vector<double>(1,value), elements, bytes );
+}
+
+const std::vector<tools::ResultsReport::Measurement>& tools::ResultsReport::measurements() const
+{
+	return measurements_;
+}
+
+bool tools::ResultsReport::empty() const
+{
+	return measurements_.empty();
+}
+
+void tools::ResultsReport::writeJson( std::ostream& output ) const
+{
+	std::ios::fmtflags previousFlags=output.flags();
+	std::streamsize previousPrecision=output.precision();
+	output << std::setprecision( std::numeric_limits<double>::max_digits10 );
+
+	output << "{\n"
+			<< "  \"measurements\": [";
+	for( size_t index=0; index<measurements_.size(); ++index )
+	{
+		const Measurement& measurement=measurements_[index];
+		tools::TimingStatistics statistics=statisticsOf( measurement );
+		output << ( index==0 ? "\n" : ",\n" )
+				<< "    {\"device\": \"" << tools::jsonEscape(measurement.device) << "\", \"driver\": \"" << tools::jsonEscape(measurement.driver)
+				<< "\", \"name\": \"" << tools::jsonEscape(measurement.name) << "\", \"unit\": \"" << tools::jsonEscape(measurement.unit)
+				<< "\", \"higherIsBetter\": " << ( measurement.higherIsBetter ? "true" : "false" )
+				<< ", \"elements\": " << measurement.elements << ", \"bytes\": " << measurement.bytes;
+		if( !statistics.empty() )
+		{
+			output << ", \"min\": "; writeJsonNumber( output, statistics.min() );
+			output << ", \"median\": "; writeJsonNumber( output, statistics.median() );
+			output << ", \"mean\": "; writeJsonNumber( output, statistics.mean() );
+			output << ", \"p99\": "; writeJsonNumber( output, statistics.percentile(99) );
+			output << ", \"max\": "; writeJsonNumber( output, statistics.max() );
+		}
+		output << ", \"samples\": [";
+		for( size_t sampleIndex=0; sampleIndex<measurement.samples.size(); ++sampleIndex )
+		{
+			if( sampleIndex!=0 ) output << ", ";
+			writeJsonNumber( output, measurement.samples[sampleIndex] );
+		}
+		output << "]}";
+	}
+	output << "\n  ]\n"
+			<< "}" << std::endl;
+
+	output.flags( previousFlags );
+	output.precision( previousPrecision );
+}
+
+void tools::ResultsReport::writeCsv( std::ostream& output ) const
+{
+	std::ios::fmtflags previousFlags=output.flags();
+	std::streamsize previousPrecision=output.precision();
+	output << std::setprecision( std::numeric_limits<double>::max_digits10 );
+
+	output << "device,driver,name,unit,elements,bytes,samples,min,median,mean,p99,max" << "\n";
+	for( const auto& measurement : measurements_ )
+	{
+		tools::TimingStatistics statistics=statisticsOf( measurement );
+		output << csvEscape(measurement.device) << "," << csvEscape(measurement.driver) << "," << csvEscape(measurement.name) << ","
+				<< csvEscape(measurement.unit) << "," << measurement.elements << "," << measurement.bytes << "," << statistics.size();
+		if( statistics.empty() ) output << ",,,,,";
+		else
+		{
+			output << "," << statistics.min() << "," << statistics.median() << "," << statistics.mean() << "," << statistics.percentile(99) << "," << statistics.max();
+		}
+		output << "\n";
+	}
+	output << std::flush;
+
+	output.flags( previousFlags );
+	output.precision( previousPrecision );
+}
+
+tools::ResultsReport tools::ResultsReport::loadJson( const std::string& filename )
+{
+	std::ifstream file( filename );
+	if( !file.is_open() ) throw std::runtime_error( "Unable to open results file '"+filename+"'" );
+	std::stringstream contents;
+	contents << file.rdbuf();
+	const std::string text=contents.str();
+
+	ResultsReport report;
+	try
+	{
+		JsonValue document=JsonParser( text ).parseDocument();
+		for( const auto& entry : document.member("measurements").array )
+		{
+			Measurement measurement;
+			measurement.device=entry.member("device").string;
+			measurement.driver=entry.member("driver").string;
+			measurement.name=entry.member("name").string;
+			measurement.unit=entry.member("unit").string;
+			measurement.higherIsBetter=entry.member("higherIsBetter").boolean;
+			measurement.elements=static_cast<uint64_t>( entry.member("elements").number );
+			measurement.bytes=static_cast<uint64_t>( entry.member("bytes").number );
+			for( const auto& sample : entry.member("samples").array )
+			{
+				// Null is a sample that wasn't finite when written
+				measurement.samples.push_back( sample.type==JsonValue::Number ? sample.number : std::numeric_limits<double>::quiet_NaN() );
+			}
+			report.measurements_.push_back( std::move(measurement) );
+		}
+	}
+	catch( std::exception& error )
+	{
+		throw std::runtime_error( filename+": "+error.what() );
+	}
+	return report;
+}
+
+std::vector<tools::ResultsReport::Regression> tools::ResultsReport::compare( const ResultsReport& baseline, double threshold, double tCritical ) const
+{
+	// Measurements are matched on device, name and size, where the size is the elements and bytes since
+	// some measurements (e.g. bandwidths) only have a byte count
+	std::map<std::string,const Measurement*> baselineMeasurements;
+	for( const auto& measurement : baseline.measurements_ ) baselineMeasurements[comparisonKey(measurement)]=&measurement;
+
+	std::vector<Regression> regressions;
+	for( const auto& current : measurements_ )
+	{
+		auto iFind=baselineMeasurements.find( comparisonKey(current) );
+		if( iFind==baselineMeasurements.end() ) continue;
+		const Measurement& previous=*iFind->second;
+
+		tools::TimingStatistics currentStatistics=statisticsOf( current );
+		tools::TimingStatistics previousStatistics=statisticsOf( previous );
+		if( currentStatistics.empty() || previousStatistics.empty() ) continue;
+		// Positive is worse, whichever direction is better
+		const double sign=( current.higherIsBetter ? -1.0 : 1.0 );
+		if( previousStatistics.median()==0 ) continue;
+		const double change=sign*(currentStatistics.median()-previousStatistics.median())/previousStatistics.median();
+		if( !(change>threshold) ) continue;
+
+		if( currentStatistics.size()>=2 && previousStatistics.size()>=2 )
+		{
+			const double standardError=std::sqrt( variance( current.samples, currentStatistics.mean() )/currentStatistics.size()
+					+ variance( previous.samples, previousStatistics.mean() )/previousStatistics.size() );
+			const double difference=sign*(currentStatistics.mean()-previousStatistics.mean());
+			// Zero spread in both means any difference is real
+			if( standardError>0 && difference/standardError<=tCritical ) continue;
+			if( standardError==0 && difference<=0 ) continue;
+		}
+		regressions.push_back( Regression{ current.device, current.name, current.elements, current.unit, previousStatistics.median(), currentStatistics.median(), change } );
+	}
+	return regressions;
+}
@@ -0,0 +1,85 @@
+#ifndef INCLUDEGUARD_tools_ResultsReport_h
+#define INCLUDEGUARD_tools_ResultsReport_h
+
+#include <vector>
+#include <string>
+#include <cstdint>
+#include <iosfwd>
+
+//
+// Forward declarations
+//
+namespace tools
+{
+	class PhaseTimings;
+}
+
+namespace tools
+{
+	/** @brief Every measurement from a run, for writing out as JSON or CSV and comparing with an earlier run.
+	 *
+	 * The JSON written is an object with a "measurements" array, each entry having the fields of Measurement
+	 * plus summary statistics of the samples. loadJson reads the same format back.
+	 */
+	class ResultsReport
+	{
+	public:
+		struct Measurement
+		{
+			std::string device; ///< @brief Device name, type and platform
+			std::string driver; ///< @brief CL_DRIVER_VERSION, or empty for the host
+			std::string name; ///< @brief What was measured, e.g. "kernel TestKernel" or "bandwidth write blocking"
+			std::string unit; ///< @brief "s" for times, otherwise e.g. "GB/s"
+			bool higherIsBetter; ///< @brief False for times, true for throughputs
+			uint64_t elements;
+			uint64_t bytes;
+			std::vector<double> samples;
+		};
+
+		/** @brief A measurement that is significantly worse than the baseline. */
+		struct Regression
+		{
+			std::string device;
+			std::string name;
+			uint64_t elements;
+			std::string unit;
+			double baselineMedian;
+			double currentMedian;
+			double change; ///< @brief Fractional change in the bad direction, e.g. 0.1 for 10% slower.
+		};
+
+		/** @brief Adds every phase as a measurement in seconds. */
+		void addTimings( const std::string& device, const std::string& driver, const tools::PhaseTimings& timings );
+		void addSamples( const std::string& device, const std::string& driver, const std::string& name, const std::string& unit,
+				bool higherIsBetter, const std::vector<double>& samples, uint64_t elements=0, uint64_t bytes=0 );
+		/** @brief For single numbers such as a bandwidth, which will be compared on the threshold alone. */
+		void addValue( const std::string& device, const std::string& driver, const std::string& name, const std::string& unit,
+				bool higherIsBetter, double value, uint64_t elements=0, uint64_t bytes=0 );
+		const std::vector<Measurement>& measurements() const;
+		bool empty() const;
+
+		void writeJson( std::ostream& output ) const;
+		/** @brief One row per measurement with summary statistics, but not the individual samples. */
+		void writeCsv( std::ostream& output ) const;
+
+		/** @brief Reads a file written by writeJson.
+		 *
+		 * @throw std::runtime_error     If the file can't be read or isn't in the expected format.
+		 */
+		static ResultsReport loadJson( const std::string& filename );
+
+		/** @brief Finds measurements that are worse than the same device, name, elements and bytes in the baseline.
+		 *
+		 * A measurement has regressed if its median is worse by more than "threshold" (a fraction, so 0.05
+		 * is 5%) and, when both have at least two samples, Welch's t statistic for the difference in means
+		 * is above tCritical. With fewer samples there isn't enough information for a significance test, so
+		 * only the threshold is used.
+		 */
+		std::vector<Regression> compare( const ResultsReport& baseline, double threshold, double tCritical=2.0 ) const;
+	protected:
+		std::vector<Measurement> measurements_;
+	};
+
+} // end of the tools namespace
+
+#endif
@@ -0,0 +1,158 @@
+#include "SizeSweep.h"
+
+#include <stdexcept>
+#include <ostream>
+#include <iomanip>
+#include <limits>
+#include <cctype>
+
+//
+// Unnamed namespace for things only used in this file
+//
+namespace
+{
+	/** @brief The size after "size" in the sweep. */
+	uint64_t nextSize( const tools::SizeSweep& sweep, uint64_t size )
+	{
+		uint64_t next=( sweep.step!=0 ? size+sweep.step : static_cast<uint64_t>(size*sweep.factor) );
+		if( next<=size ) next=size+1; // Make sure small sizes with small factors still move on
+		return next;
+	}
+} // end of the unnamed namespace
+
+uint64_t tools::parseSize( const std::string& text )
+{
+	size_t digits=0;
+	while( digits<text.size() && std::isdigit( static_cast<unsigned char>(text[digits]) ) ) ++digits;
+	if( digits==0 ) throw std::runtime_error( "'"+text+"' is not a valid size" );
+
+	uint64_t multiplier=1;
+	const std::string suffix=text.substr( digits );
+	if( suffix=="K" || suffix=="k" ) multiplier=1ull<<10;
+	else if( suffix=="M" || suffix=="m" ) multiplier=1ull<<20;
+	else if( suffix=="G" || suffix=="g" ) multiplier=1ull<<30;
+	else if( suffix=="T" || suffix=="t" ) multiplier=1ull<<40;
+	else if( !suffix.empty() ) throw std::runtime_error( "'"+text+"' has an unknown size suffix, expected K, M, G or T" );
+
+	uint64_t value;
+	try{ value=std::stoull( text.substr( 0, digits ) ); }
+	catch( std::exception& error ) { throw std::runtime_error( "'"+text+"' is too large" ); }
+	if( value==0 ) throw std::runtime_error( "'"+text+"' must be greater than zero" );
+	if( value>std::numeric_limits<uint64_t>::max()/multiplier ) throw std::runtime_error( "'"+text+"' is too large" );
+	return value*multiplier;
+}
+
+std::string tools::formatSize( uint64_t size )
+{
+	const char* suffixes[]={ "T", "G", "M", "K" };
+	for( size_t index=0; index<4; ++index )
+	{
+		const uint64_t multiplier=1ull<<(10*(4-index));
+		if( size>=multiplier && size%multiplier==0 ) return std::to_string(size/multiplier)+suffixes[index];
+	}
+	return std::to_string(size);
+}
+
+tools::SizeSweep tools::SizeSweep::fromString( const std::string& description )
+{
+	size_t firstColon=description.find(':');
+	if( firstColon==std::string::npos ) throw std::runtime_error( "Sweep '"+description+"' should be of the form <first>:<last>[:x<factor>|:+<step>]" );
+	size_t secondColon=description.find( ':', firstColon+1 );
+
+	SizeSweep sweep;
+	sweep.first=parseSize( description.substr( 0, firstColon ) );
+	sweep.last=parseSize( description.substr( firstColon+1, secondColon==std::string::npos ? std::string::npos : secondColon-firstColon-1 ) );
+	sweep.factor=2;
+	sweep.step=0;
+	if( secondColon!=std::string::npos )
+	{
+		const std::string step=description.substr( secondColon+1 );
+		if( step.size()>1 && step[0]=='x' )
+		{
+			try{ sweep.factor=std::stod( step.substr(1) ); }
+			catch( std::exception& error ) { throw std::runtime_error( "Invalid sweep factor '"+step+"'" ); }
+			if( !(sweep.factor>1) ) throw std::runtime_error( "Sweep factor '"+step+"' must be greater than one" );
+		}
+		else if( step.size()>1 && step[0]=='+' ) sweep.step=parseSize( step.substr(1) );
+		else throw std::runtime_error( "Sweep step '"+step+"' should be x<factor> or +<step>" );
+	}
+	if( sweep.last<sweep.first ) throw std::runtime_error( "Sweep '"+description+"' ends before it starts" );
+
+	// Each point is a full run on every device, so a small step over a large range would never finish
+	size_t points=1;
+	for( uint64_t size=sweep.first; size<sweep.last && points<=maximumPoints; size=nextSize( sweep, size ) ) ++points;
+	if( points>maximumPoints )
+	{
+		throw std::runtime_error( "Sweep '"+description+"' has more than "+std::to_string(maximumPoints)+" sizes, use a larger step or factor" );
+	}
+	return sweep;
+}
+
+std::vector<uint64_t> tools::SizeSweep::sizes() const
+{
+	std::vector<uint64_t> returnValue;
+	for( uint64_t size=first; size<last; )
+	{
+		returnValue.push_back( size );
+		size=nextSize( *this, size );
+	}
+	returnValue.push_back( last );
+	return returnValue;
+}
+
+tools::SweepAnalysis tools::analyseSweep( const std::vector<SweepPoint>& points, double saturationFraction )
+{
+	SweepAnalysis analysis{ 0, 0, 0 };
+	for( const auto& point : points )
+	{
+		if( point.deviceTime>0 && point.elements/point.deviceTime>analysis.bestThroughput ) analysis.bestThroughput=point.elements/point.deviceTime;
+	}
+	for( const auto& point : points )
+	{
+		if( point.deviceTime>0 && point.elements/point.deviceTime>=saturationFraction*analysis.bestThroughput )
+		{
+			analysis.saturation=point.elements;
+			break;
+		}
+	}
+	// Work back from the largest size for as long as the device is winning, skipping any size that wasn't measured
+	for( auto iPoint=points.rbegin(); iPoint!=points.rend(); ++iPoint )
+	{
+		if( iPoint->deviceTime<=0 || iPoint->hostTime<=0 ) continue;
+		if( iPoint->deviceTime>=iPoint->hostTime ) break;
+		analysis.crossover=iPoint->elements;
+	}
+	return analysis;
+}
+
+void tools::printSweep( const std::vector<SweepPoint>& points, size_t hostThreads, std::ostream& output, const std::string& indent )
+{
+	std::ios::fmtflags previousFlags=output.flags();
+	std::streamsize previousPrecision=output.precision();
+
+	output << indent << std::setw(10) << "elements" << std::setw(14) << "device ms" << std::setw(14) << "Melements/s" << std::setw(14) << "host ms" << std::setw(10) << "speedup" << "\n";
+	output << std::fixed << std::setprecision(3);
+	for( const auto& point : points )
+	{
+		output << indent << std::setw(10) << formatSize(point.elements);
+		if( point.deviceTime>0 ) output << std::setw(14) << point.deviceTime*1e3 << std::setw(14) << point.elements/point.deviceTime/1e6;
+		else output << std::setw(14) << "-" << std::setw(14) << "-";
+		if( point.hostTime>0 ) output << std::setw(14) << point.hostTime*1e3;
+		else output << std::setw(14) << "-";
+		if( point.hostTime>0 && point.deviceTime>0 ) output << std::setw(10) << point.hostTime/point.deviceTime;
+		else output << std::setw(10) << "-";
+		output << "\n";
+	}
+	output.flags( previousFlags );
+	output.precision( previousPrecision );
+
+	SweepAnalysis analysis=analyseSweep( points );
+	if( analysis.crossover!=0 ) output << indent << "Device is faster than the " << hostThreads << "-thread host from " << formatSize(analysis.crossover) << " elements upwards" << "\n";
+	else output << indent << "Device is not faster than the " << hostThreads << "-thread host at the largest size" << "\n";
+	if( analysis.saturation!=0 )
+	{
+		output << indent << "Throughput saturates at " << formatSize(analysis.saturation) << " elements (within 10% of the best, "
+				<< analysis.bestThroughput/1e6 << " Melements/s)" << "\n";
+	}
+	output << std::flush;
+}
@@ -0,0 +1,66 @@
+#ifndef INCLUDEGUARD_tools_SizeSweep_h
+#define INCLUDEGUARD_tools_SizeSweep_h
+
+#include <vector>
+#include <string>
+#include <cstdint>
+#include <iosfwd>
+
+namespace tools
+{
+	/** @brief Parses a size such as "4096", "64K", "16M" or "1G". The suffixes are powers of 1024, and can be lower case.
+	 *
+	 * @throw std::runtime_error     If the string isn't a positive integer with an optional suffix, or overflows.
+	 */
+	uint64_t parseSize( const std::string& text );
+
+	/** @brief The inverse of parseSize, using the largest suffix that divides the size exactly. */
+	std::string formatSize( uint64_t size );
+
+	/** @brief A range of sizes to sweep through, e.g. "1K:1G:x2" for 1K, 2K, 4K... 1G or "1M:8M:+1M" for 1M, 2M... 8M. */
+	struct SizeSweep
+	{
+		/** @brief Parses "<first>:<last>:x<factor>" or "<first>:<last>:+<step>". The step defaults to "x2" if left off.
+		 *
+		 * @throw std::runtime_error     If the string is not in that form, the range is empty, or there would be more
+		 *                               than maximumPoints sizes.
+		 */
+		static SizeSweep fromString( const std::string& description );
+		/** @brief All of the sizes in the range, including "last" even if the steps don't land on it exactly. */
+		std::vector<uint64_t> sizes() const;
+
+		static const size_t maximumPoints=1000;
+
+		uint64_t first;
+		uint64_t last;
+		double factor; ///< @brief Multiply by this each step. Only used if step is zero.
+		uint64_t step; ///< @brief Add this each step. Zero to multiply by factor instead.
+	};
+
+	/** @brief One size from a sweep. Times are seconds, and zero or less if not measured. */
+	struct SweepPoint
+	{
+		uint64_t elements;
+		double deviceTime;
+		double hostTime;
+	};
+
+	/** @brief The interesting sizes from a sweep. */
+	struct SweepAnalysis
+	{
+		/// @brief The smallest size from which the device is faster than the host for every larger measured size. Zero if it never is.
+		uint64_t crossover;
+		/// @brief The smallest size with device throughput within saturationFraction of the best throughput.
+		uint64_t saturation;
+		double bestThroughput; ///< @brief Elements per second
+	};
+
+	/** @brief Finds the crossover with the host and where the device throughput stops improving. Points must be in increasing size. */
+	SweepAnalysis analyseSweep( const std::vector<SweepPoint>& points, double saturationFraction=0.9 );
+
+	/** @brief Prints the throughput curve as a table, followed by the analysis. */
+	void printSweep( const std::vector<SweepPoint>& points, size_t hostThreads, std::ostream& output, const std::string& indent="   " );
+
+} // end of the tools namespace
+
+#endif
@@ -0,0 +1,152 @@
+#include "StreamingPipeline.h"
+
+#include <stdexcept>
+#include <algorithm>
+#include "DeviceSession.h"
+#include "OpenCLEnums.h"
+#include "Timing.h"
+#include "Trace.h"
+
+
+tools::StreamingPipeline::StreamingPipeline( const tools::DeviceSession& session, size_t programIndex, size_t numberOfBufferSets )
+	: chunkElements_( session.elementCount() ), bytesPerElement_( session.bytesPerElement() ), session_( session ), programIndex_( programIndex )
+{
+	cl_int error=CL_SUCCESS;
+	if( numberOfBufferSets<1 ) throw std::runtime_error( "StreamingPipeline needs at least one buffer set" );
+
+	uploadQueue_=cl::CommandQueue( session.context(), session.device(), CL_QUEUE_PROFILING_ENABLE, &error );
+	if( error!=CL_SUCCESS ) throw std::runtime_error( "Error when creating upload command queue - "+tools::createQueueError(error) );
+	computeQueue_=cl::CommandQueue( session.context(), session.device(), CL_QUEUE_PROFILING_ENABLE, &error );
+	if( error!=CL_SUCCESS ) throw std::runtime_error( "Error when creating compute command queue - "+tools::createQueueError(error) );
+	downloadQueue_=cl::CommandQueue( session.context(), session.device(), CL_QUEUE_PROFILING_ENABLE, &error );
+	if( error!=CL_SUCCESS ) throw std::runtime_error( "Error when creating download command queue - "+tools::createQueueError(error) );
+
+	for( size_t index=0; index<numberOfBufferSets; ++index )
+	{
+		BufferSet bufferSet;
+		if( index==0 )
+		{
+			bufferSet.input=tools::PooledBuffer( session.input() );
+			bufferSet.output=tools::PooledBuffer( session.output() );
+		}
+		else
+		{
+			bufferSet.input=session.createBuffer( CL_MEM_READ_ONLY, bytesPerElement_*chunkElements_, nullptr, &error );
+			if( error!=CL_SUCCESS ) throw std::runtime_error( "Error when creating a streaming input buffer - "+tools::createBufferError(error) );
+			bufferSet.output=session.createBuffer( CL_MEM_WRITE_ONLY, bytesPerElement_*chunkElements_, nullptr, &error );
+			if( error!=CL_SUCCESS ) throw std::runtime_error( "Error when creating a streaming output buffer - "+tools::createBufferError(error) );
+		}
+
+		bufferSet.kernel=session.createKernel( programIndex, bufferSet.input.buffer(), bufferSet.output.buffer(), chunkElements_ );
+		bufferSet.elementCount=chunkElements_;
+
+		bufferSets_.push_back( std::move(bufferSet) );
+	}
+}
+
+tools::StreamingPipeline::Result tools::StreamingPipeline::run( const void* pInput, void* pOutput, size_t elementCount )
+{
+	cl_int error=CL_SUCCESS;
+	const size_t chunks=(elementCount+chunkElements_-1)/chunkElements_;
+	const size_t sets=bufferSets_.size();
+	std::vector<cl::Event> uploads(chunks), kernels(chunks), downloads(chunks);
+
+	tools::StopWatch wallClock;
+	for( size_t chunk=0; chunk<chunks; ++chunk )
+	{
+		BufferSet& bufferSet=bufferSets_[chunk%sets];
+		const size_t offset=chunk*chunkElements_;
+		const size_t count=std::min( chunkElements_, elementCount-offset );
+
+		// The input buffer is free once the kernel that last used this set has finished
+		std::vector<cl::Event> uploadWaitList;
+		if( chunk>=sets ) uploadWaitList.push_back( kernels[chunk-sets] );
+		error=tools::trace::enqueueWriteBuffer( uploadQueue_, bufferSet.input.buffer(), CL_FALSE, 0, count*bytesPerElement_, static_cast<const char*>(pInput)+offset*bytesPerElement_,
+				uploadWaitList.empty() ? nullptr : &uploadWaitList, &uploads[chunk] );
+		if( error!=CL_SUCCESS ) throw std::runtime_error( "Error when copying input chunk in" );
+
+		// The kernel needs its input uploaded, and the output buffer to have been downloaded from last time
+		std::vector<cl::Event> kernelWaitList( 1, uploads[chunk] );
+		if( chunk>=sets ) kernelWaitList.push_back( downloads[chunk-sets] );
+		setElementCount( bufferSet, count ); // Argument values are captured at enqueue, so this doesn't affect earlier chunks
+		error=enqueueKernel( bufferSet, count, &kernelWaitList, &kernels[chunk] );
+		if( error!=CL_SUCCESS ) throw std::runtime_error( "Error when enqueing kernel - "+tools::enqueKernelError(error) );
+
+		std::vector<cl::Event> downloadWaitList( 1, kernels[chunk] );
+		error=tools::trace::enqueueReadBuffer( downloadQueue_, bufferSet.output.buffer(), CL_FALSE, 0, count*bytesPerElement_, static_cast<char*>(pOutput)+offset*bytesPerElement_,
+				&downloadWaitList, &downloads[chunk] );
+		if( error!=CL_SUCCESS ) throw std::runtime_error( "Error when copying output chunk out" );
+
+		// Make sure the runtime starts on the commands straight away rather than batching them up
+		uploadQueue_.flush();
+		computeQueue_.flush();
+		downloadQueue_.flush();
+	}
+	tools::trace::finish( uploadQueue_ );
+	tools::trace::finish( computeQueue_ );
+	tools::trace::finish( downloadQueue_ );
+
+	return summarise( chunks, wallClock.elapsed(), uploads, kernels, downloads );
+}
+
+tools::StreamingPipeline::Result tools::StreamingPipeline::runSerial( const void* pInput, void* pOutput, size_t elementCount )
+{
+	cl_int error=CL_SUCCESS;
+	const size_t chunks=(elementCount+chunkElements_-1)/chunkElements_;
+	std::vector<cl::Event> uploads(chunks), kernels(chunks), downloads(chunks);
+	BufferSet& bufferSet=bufferSets_.front();
+
+	tools::StopWatch wallClock;
+	for( size_t chunk=0; chunk<chunks; ++chunk )
+	{
+		const size_t offset=chunk*chunkElements_;
+		const size_t count=std::min( chunkElements_, elementCount-offset );
+
+		error=tools::trace::enqueueWriteBuffer( computeQueue_, bufferSet.input.buffer(), CL_TRUE, 0, count*bytesPerElement_, static_cast<const char*>(pInput)+offset*bytesPerElement_, nullptr, &uploads[chunk] );
+		if( error!=CL_SUCCESS ) throw std::runtime_error( "Error when copying input chunk in" );
+
+		setElementCount( bufferSet, count );
+		error=enqueueKernel( bufferSet, count, nullptr, &kernels[chunk] );
+		if( error!=CL_SUCCESS ) throw std::runtime_error( "Error when enqueing kernel - "+tools::enqueKernelError(error) );
+		tools::trace::finish( computeQueue_ );
+
+		error=tools::trace::enqueueReadBuffer( computeQueue_, bufferSet.output.buffer(), CL_TRUE, 0, count*bytesPerElement_, static_cast<char*>(pOutput)+offset*bytesPerElement_, nullptr, &downloads[chunk] );
+		if( error!=CL_SUCCESS ) throw std::runtime_error( "Error when copying output chunk out" );
+	}
+
+	return summarise( chunks, wallClock.elapsed(), uploads, kernels, downloads );
+}
+
+size_t tools::StreamingPipeline::chunkElements() const
+{
+	return chunkElements_;
+}
+
+size_t tools::StreamingPipeline::numberOfBufferSets() const
+{
+	return bufferSets_.size();
+}
+
+void tools::StreamingPipeline::setElementCount( BufferSet& bufferSet, size_t elementCount )
+{
+	if( bufferSet.elementCount==elementCount ) return;
+	tools::DeviceSession::setKernelArguments( bufferSet.kernel, bufferSet.input.buffer(), bufferSet.output.buffer(), elementCount );
+	bufferSet.elementCount=elementCount;
+}
+
+cl_int tools::StreamingPipeline::enqueueKernel( const BufferSet& bufferSet, size_t elementCount, const std::vector<cl::Event>* pWaitList, cl::Event* pEvent ) const
+{
+	const tools::DeviceSession::Program& program=session_.programs()[programIndex_];
+	return tools::trace::enqueueNDRangeKernel( computeQueue_, bufferSet.kernel, 0, tools::DeviceSession::globalRange( tools::DeviceSession::workItemCount(program,elementCount), program.workGroupSize ),
+			tools::DeviceSession::localRange( program.workGroupSize ), pWaitList, pEvent );
+}
+
+tools::StreamingPipeline::Result tools::StreamingPipeline::summarise( size_t chunks, double wallTime, const std::vector<cl::Event>& uploads,
+		const std::vector<cl::Event>& kernels, const std::vector<cl::Event>& downloads ) const
+{
+	Result result{ chunks, wallTime, 0, 0, 0 };
+	for( const auto& event : uploads ) result.uploadTime+=tools::eventDuration(event);
+	for( const auto& event : kernels ) result.kernelTime+=tools::eventDuration(event);
+	for( const auto& event : downloads ) result.downloadTime+=tools::eventDuration(event);
+	return result;
+}
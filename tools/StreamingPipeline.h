@@ -0,0 +1,82 @@
+#ifndef INCLUDEGUARD_tools_StreamingPipeline_h
+#define INCLUDEGUARD_tools_StreamingPipeline_h
+
+#include <vector>
+#include <CL/cl.hpp>
+#include "BufferPool.h"
+
+//
+// Forward declarations
+//
+namespace tools
+{
+	class DeviceSession;
+}
+
+namespace tools
+{
+	/** @brief Streams data through one of a DeviceSession's kernels in fixed size chunks.
+	 *
+	 * Several sets of chunk sized input/output buffers are rotated through, with uploads, kernels and
+	 * downloads on three separate in-order queues linked by events. So while chunk N is being processed,
+	 * chunk N+1 can be uploaded and chunk N-1 downloaded. Only the chunk buffers need to fit on the
+	 * device, so datasets larger than CL_DEVICE_MAX_MEM_ALLOC_SIZE can be processed.
+	 *
+	 * The session's own input and output buffers are used as the first buffer set, so the session
+	 * should have been created with elementCount() equal to the chunk size, and must outlive the pipeline.
+	 */
+	class StreamingPipeline
+	{
+	public:
+		/** @brief Timing for a complete run over all of the data. All values are in seconds. */
+		struct Result
+		{
+			size_t chunks;
+			double wallTime; ///< @brief Host wall clock time from the first enqueue until everything has finished.
+			double uploadTime; ///< @brief Sum of device times for all uploads.
+			double kernelTime; ///< @brief Sum of device times for all kernels.
+			double downloadTime; ///< @brief Sum of device times for all downloads.
+		};
+
+		/** @brief Creates the extra buffers and queues.
+		 *
+		 * @param numberOfBufferSets   How many chunks can be in flight at once. 2 is double buffering, 3 triple buffering.
+		 * @throw std::runtime_error     If any of the OpenCL calls fail.
+		 */
+		StreamingPipeline( const tools::DeviceSession& session, size_t programIndex, size_t numberOfBufferSets=2 );
+
+		/** @brief Processes elementCount elements from pInput into pOutput with uploads, kernels and downloads overlapping. */
+		Result run( const void* pInput, void* pOutput, size_t elementCount );
+		/** @brief Processes the data chunk by chunk, blocking on each step, for comparison with run(). */
+		Result runSerial( const void* pInput, void* pOutput, size_t elementCount );
+
+		size_t chunkElements() const;
+		size_t numberOfBufferSets() const;
+	protected:
+		struct BufferSet
+		{
+			tools::PooledBuffer input; ///< @brief The first set uses the session's buffers, the others come from its pool.
+			tools::PooledBuffer output;
+			cl::Kernel kernel; ///< @brief Separate kernel for each set so that the buffer arguments only need setting once.
+			size_t elementCount; ///< @brief The count arguments currently set on the kernel.
+		};
+		/** @brief Sets the count arguments on the kernel if they're not already "elementCount". */
+		void setElementCount( BufferSet& bufferSet, size_t elementCount );
+		/** @brief Enqueues the kernel for a chunk of elementCount elements on computeQueue_. */
+		cl_int enqueueKernel( const BufferSet& bufferSet, size_t elementCount, const std::vector<cl::Event>* pWaitList, cl::Event* pEvent ) const;
+		Result summarise( size_t chunks, double wallTime, const std::vector<cl::Event>& uploads,
+				const std::vector<cl::Event>& kernels, const std::vector<cl::Event>& downloads ) const;
+
+		size_t chunkElements_;
+		size_t bytesPerElement_;
+		const tools::DeviceSession& session_; ///< @brief Must outlive the pipeline.
+		size_t programIndex_;
+		cl::CommandQueue uploadQueue_;
+		cl::CommandQueue computeQueue_;
+		cl::CommandQueue downloadQueue_;
+		std::vector<BufferSet> bufferSets_;
+	};
+
+} // end of the tools namespace
+
+#endif
@@ -0,0 +1,193 @@
+#include "SubDevices.h"
+
+#include <stdexcept>
+#include <ostream>
+#include <iomanip>
+#include <algorithm>
+#include "OpenCLEnums.h"
+
+//
+// Unnamed namespace for things only used in this file
+//
+namespace
+{
+	struct AffinityDomain
+	{
+		const char* name;
+		cl_device_affinity_domain domain;
+	};
+
+	/** @brief Largest to smallest, which is the order they are tried in. */
+	const AffinityDomain affinityDomains[]={
+		{ "numa", CL_DEVICE_AFFINITY_DOMAIN_NUMA },
+		{ "l4", CL_DEVICE_AFFINITY_DOMAIN_L4_CACHE },
+		{ "l3", CL_DEVICE_AFFINITY_DOMAIN_L3_CACHE },
+		{ "l2", CL_DEVICE_AFFINITY_DOMAIN_L2_CACHE },
+		{ "l1", CL_DEVICE_AFFINITY_DOMAIN_L1_CACHE },
+		{ "next", CL_DEVICE_AFFINITY_DOMAIN_NEXT_PARTITIONABLE }
+	};
+
+	/** @brief A positive number of compute units from part of a scheme description. */
+	cl_device_partition_property parseUnits( const std::string& units, const std::string& description )
+	{
+		int value=0;
+		try{ value=std::stoi( units ); }
+		catch( std::exception& error ) { value=0; }
+		if( value<=0 ) throw std::runtime_error( "'"+units+"' in partition scheme '"+description+"' must be a positive number of compute units" );
+		return static_cast<cl_device_partition_property>(value);
+	}
+
+	tools::PartitionScheme equallyScheme( cl_uint units )
+	{
+		return tools::PartitionScheme{ "equally:"+std::to_string(units), { CL_DEVICE_PARTITION_EQUALLY, static_cast<cl_device_partition_property>(units), 0 } };
+	}
+
+	tools::PartitionScheme affinityScheme( const AffinityDomain& affinityDomain )
+	{
+		return tools::PartitionScheme{ std::string("affinity:")+affinityDomain.name,
+				{ CL_DEVICE_PARTITION_BY_AFFINITY_DOMAIN, static_cast<cl_device_partition_property>(affinityDomain.domain), 0 } };
+	}
+
+	tools::PartitionScheme parsePartitionScheme( const std::string& description )
+	{
+		const size_t colonPosition=description.find(':');
+		const std::string type=description.substr( 0, colonPosition );
+		const std::string argument=( colonPosition==std::string::npos ? "" : description.substr(colonPosition+1) );
+
+		if( type=="equally" ) return equallyScheme( static_cast<cl_uint>( parseUnits( argument, description ) ) );
+		else if( type=="counts" )
+		{
+			tools::PartitionScheme scheme{ "counts:", { CL_DEVICE_PARTITION_BY_COUNTS } };
+			size_t start=0;
+			while( start<=argument.size() )
+			{
+				size_t plus=argument.find( '+', start );
+				if( plus==std::string::npos ) plus=argument.size();
+				const cl_device_partition_property units=parseUnits( argument.substr( start, plus-start ), description );
+				scheme.name+=( scheme.properties.size()>1 ? "+" : "" )+std::to_string(units);
+				scheme.properties.push_back( units );
+				start=plus+1;
+			}
+			scheme.properties.push_back( CL_DEVICE_PARTITION_BY_COUNTS_LIST_END );
+			scheme.properties.push_back( 0 );
+			return scheme;
+		}
+		else if( type=="affinity" )
+		{
+			for( const auto& affinityDomain : affinityDomains )
+			{
+				if( argument==affinityDomain.name ) return affinityScheme( affinityDomain );
+			}
+			throw std::runtime_error( "Unknown affinity domain in partition scheme '"+description+"', expected numa, l4, l3, l2, l1 or next" );
+		}
+		throw std::runtime_error( "Partition scheme '"+description+"' should be 'equally:<units>', 'counts:<units>+<units>...' or 'affinity:<domain>'" );
+	}
+
+	bool supportsPartitionType( const cl::Device& device, cl_device_partition_property type )
+	{
+		const std::vector<cl_device_partition_property> types=device.getInfo<CL_DEVICE_PARTITION_PROPERTIES>();
+		return std::find( types.begin(), types.end(), type )!=types.end();
+	}
+} // end of the unnamed namespace
+
+std::vector<tools::PartitionScheme> tools::partitionSchemesFromString( const std::string& descriptions )
+{
+	std::vector<PartitionScheme> schemes;
+	if( descriptions.empty() || descriptions=="all" ) return schemes;
+
+	size_t start=0;
+	while( start<=descriptions.size() )
+	{
+		size_t comma=descriptions.find( ',', start );
+		if( comma==std::string::npos ) comma=descriptions.size();
+		const std::string description=descriptions.substr( start, comma-start );
+		start=comma+1;
+		if( !description.empty() ) schemes.push_back( parsePartitionScheme( description ) );
+	}
+	return schemes;
+}
+
+std::vector<tools::PartitionScheme> tools::supportedPartitionSchemes( const cl::Device& device )
+{
+	std::vector<PartitionScheme> schemes;
+	const cl_uint computeUnits=device.getInfo<CL_DEVICE_MAX_COMPUTE_UNITS>();
+	const cl_uint maxSubDevices=device.getInfo<CL_DEVICE_PARTITION_MAX_SUB_DEVICES>();
+	if( computeUnits<2 || maxSubDevices<2 ) return schemes;
+
+	if( supportsPartitionType( device, CL_DEVICE_PARTITION_EQUALLY ) )
+	{
+		for( cl_uint parts=2; parts<=maxSubDevices && parts<=computeUnits; parts*=2 ) schemes.push_back( equallyScheme( computeUnits/parts ) );
+	}
+	if( supportsPartitionType( device, CL_DEVICE_PARTITION_BY_COUNTS ) )
+	{
+		schemes.push_back( PartitionScheme{ "counts:"+std::to_string(computeUnits-1),
+				{ CL_DEVICE_PARTITION_BY_COUNTS, static_cast<cl_device_partition_property>(computeUnits-1), CL_DEVICE_PARTITION_BY_COUNTS_LIST_END, 0 } } );
+	}
+	if( supportsPartitionType( device, CL_DEVICE_PARTITION_BY_AFFINITY_DOMAIN ) )
+	{
+		const cl_device_affinity_domain domains=device.getInfo<CL_DEVICE_PARTITION_AFFINITY_DOMAIN>();
+		for( const auto& affinityDomain : affinityDomains )
+		{
+			if( domains & affinityDomain.domain ) schemes.push_back( affinityScheme( affinityDomain ) );
+		}
+	}
+	return schemes;
+}
+
+std::vector<cl::Device> tools::createSubDevices( const cl::Device& device, const PartitionScheme& scheme )
+{
+	if( scheme.properties.empty() || !supportsPartitionType( device, scheme.properties.front() ) )
+	{
+		throw std::runtime_error( "The device doesn't support partitioning '"+scheme.name+"'" );
+	}
+	cl::Device parent( device ); // cl::Device::createSubDevices isn't const
+	std::vector<cl::Device> subDevices;
+	cl_int error=parent.createSubDevices( scheme.properties.data(), &subDevices );
+	if( error!=CL_SUCCESS ) throw std::runtime_error( "Error when creating sub-devices '"+scheme.name+"' - "+tools::createSubDevicesError(error) );
+	return subDevices;
+}
+
+const tools::PartitionResult* tools::bestPartition( const std::vector<PartitionResult>& results )
+{
+	const PartitionResult* pBest=nullptr;
+	for( const auto& result : results )
+	{
+		if( !result.failure.empty() || result.time<0 || result.mismatches!=0 ) continue;
+		if( pBest==nullptr || result.elementsPerSecond>pBest->elementsPerSecond ) pBest=&result;
+	}
+	return pBest;
+}
+
+void tools::printPartitions( const std::vector<PartitionResult>& results, std::ostream& output, const std::string& indent )
+{
+	std::ios::fmtflags previousFlags=output.flags();
+	std::streamsize previousPrecision=output.precision();
+
+	const double referenceThroughput=( results.empty() || results.front().time<0 ? -1 : results.front().elementsPerSecond );
+	output << indent << std::left << std::setw(18) << "scheme" << std::setw(22) << "compute units" << std::right
+			<< std::setw(12) << "time ms" << std::setw(14) << "Melements/s" << std::setw(10) << "scaling" << std::setw(12) << "mismatches" << "\n";
+	output << std::fixed;
+	for( const auto& result : results )
+	{
+		std::string units;
+		for( const auto computeUnits : result.computeUnits ) units+=( units.empty() ? "" : "+" )+std::to_string(computeUnits);
+		if( units.size()>20 ) units=std::to_string(result.computeUnits.size())+" x "+std::to_string(result.computeUnits.front());
+		output << indent << std::left << std::setw(18) << result.scheme << std::setw(22) << units << std::right;
+		if( !result.failure.empty() )
+		{
+			output << "   " << result.failure << "\n";
+			continue;
+		}
+		output << std::setprecision(2) << std::setw(12) << result.time*1e3 << std::setprecision(1) << std::setw(14) << result.elementsPerSecond/1e6;
+		if( referenceThroughput>0 ) output << std::setprecision(2) << std::setw(10) << result.elementsPerSecond/referenceThroughput;
+		else output << std::setw(10) << "-";
+		output << std::setw(12) << result.mismatches << "\n";
+	}
+
+	const PartitionResult* pBest=bestPartition( results );
+	if( pBest==nullptr ) output << indent << "No partitioning passed verification" << "\n";
+	else output << indent << "Best throughput: " << pBest->scheme << "\n";
+	output.flags( previousFlags );
+	output.precision( previousPrecision );
+	output << std::flush;
+}
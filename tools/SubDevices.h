@@ -0,0 +1,64 @@
+#ifndef INCLUDEGUARD_tools_SubDevices_h
+#define INCLUDEGUARD_tools_SubDevices_h
+
+#include <vector>
+#include <string>
+#include <iosfwd>
+#include <CL/cl.hpp>
+
+namespace tools
+{
+	/** @brief One way of splitting a device into sub-devices with clCreateSubDevices. */
+	struct PartitionScheme
+	{
+		std::string name; ///< @brief In the form partitionSchemesFromString takes, e.g. "equally:4"
+		std::vector<cl_device_partition_property> properties; ///< @brief Zero terminated, ready to pass to clCreateSubDevices
+	};
+
+	/** @brief Parses a comma separated list of partition schemes, each one of:
+	 *     equally:<units>             - as many sub-devices of that many compute units as fit
+	 *     counts:<units>+<units>...   - one sub-device with each number of compute units
+	 *     affinity:<domain>           - one sub-device per numa, l4, l3, l2 or l1 domain, or "next" for the
+	 *                                   next level the device can partition by
+	 *
+	 * An empty string or "all" gives an empty list, meaning supportedPartitionSchemes for each device.
+	 * @throw std::runtime_error     If a scheme isn't in one of those forms.
+	 */
+	std::vector<PartitionScheme> partitionSchemesFromString( const std::string& descriptions );
+
+	/** @brief The schemes worth trying on the device, of those it says it supports:
+	 *     equally into 2, 4, 8... sub-devices, up to CL_DEVICE_PARTITION_MAX_SUB_DEVICES
+	 *     by counts into one sub-device with all but one compute unit, leaving one for the host
+	 *     by each affinity domain the device reports, e.g. one sub-device per NUMA node or L3 cache
+	 *
+	 * Empty if the device can't be partitioned.
+	 */
+	std::vector<PartitionScheme> supportedPartitionSchemes( const cl::Device& device );
+
+	/** @brief Splits the device into sub-devices.
+	 *
+	 * @throw std::runtime_error     If the device doesn't support the scheme's partition type, or clCreateSubDevices fails.
+	 */
+	std::vector<cl::Device> createSubDevices( const cl::Device& device, const PartitionScheme& scheme );
+
+	/** @brief How running the workload on the sub-devices of one scheme did, all at the same time. */
+	struct PartitionResult
+	{
+		std::string scheme; ///< @brief Name of the PartitionScheme, or "whole device" for the unpartitioned device
+		std::vector<cl_uint> computeUnits; ///< @brief Of each sub-device
+		double time; ///< @brief Median host wall clock seconds for all of the programs, including transfers. Negative if it wasn't run.
+		double elementsPerSecond; ///< @brief Elements taken through all of the programs per second, i.e. the element count over the time
+		size_t mismatches; ///< @brief Wrong results, compared with the host.
+		std::string failure; ///< @brief Why the scheme couldn't be created or run, empty if it could.
+	};
+
+	/** @brief The result with the highest throughput that ran and had no mismatches. Null if none did. */
+	const PartitionResult* bestPartition( const std::vector<PartitionResult>& results );
+
+	/** @brief Prints one row per scheme, with the scaling relative to the first (whole device) result,
+	 * followed by which scheme has the best throughput. */
+	void printPartitions( const std::vector<PartitionResult>& results, std::ostream& output, const std::string& indent="   " );
+
+} // end of the tools namespace
+
+#endif
@@ -0,0 +1,162 @@
+#include "SubmissionBenchmark.h"
+
+#include <stdexcept>
+#include <ostream>
+#include <iomanip>
+#include <algorithm>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include "OpenCLEnums.h"
+#include "Timing.h"
+#include "Trace.h"
+#include "DeviceSession.h"
+
+//
+// Unnamed namespace for things only used in this file
+//
+namespace
+{
+	const size_t tinyGlobalSize=64; ///< @brief Work items per submission, small enough that the device is never the bottleneck
+	const size_t flushInterval=64; ///< @brief Submissions between each clFlush, so the queues don't grow without limit
+
+	const char* tinyKernelSource=
+			"__kernel void tiny( __global int* output )\n"
+			"{\n"
+			"	output[get_global_id(0)]+=1;\n"
+			"}\n";
+
+	/** @brief Everything one submitting thread uses, and what it measured. */
+	struct SubmitterThread
+	{
+		cl::CommandQueue queue;
+		cl::Kernel kernel;
+		cl::Buffer output;
+		std::vector<double> enqueueTimes;
+		std::string failure; ///< @brief Set if anything went wrong on the thread
+	};
+
+	/** @brief Enqueues "submissions" kernels once "start" is set, timing each enqueue call. */
+	void submitLoop( SubmitterThread& submitter, size_t submissions, const std::atomic<bool>& start )
+	{
+		submitter.enqueueTimes.reserve( submissions );
+		while( !start.load( std::memory_order_acquire ) ) std::this_thread::yield();
+		for( size_t submission=0; submission<submissions; ++submission )
+		{
+			const auto before=std::chrono::steady_clock::now();
+			cl_int error=tools::trace::enqueueNDRangeKernel( submitter.queue, submitter.kernel, cl::NullRange, cl::NDRange(tinyGlobalSize), cl::NullRange );
+			const auto after=std::chrono::steady_clock::now();
+			if( error!=CL_SUCCESS )
+			{
+				submitter.failure="Error when enqueing kernel - "+tools::enqueKernelError(error);
+				break;
+			}
+			submitter.enqueueTimes.push_back( std::chrono::duration<double>(after-before).count() );
+			if( (submission+1)%flushInterval==0 ) submitter.queue.flush();
+		}
+		// With a shared queue this also waits for the other threads' kernels, which have to be waited for anyway
+		tools::trace::finish( submitter.queue );
+	}
+
+	/** @brief Runs one configuration with "threads" threads, filling in everything except the scaling. */
+	tools::SubmissionResult runThreads( const cl::Context& context, const cl::Device& device, const cl::Program& program,
+			size_t threads, bool sharedQueue, size_t submissionsPerThread )
+	{
+		cl_int error=CL_SUCCESS;
+		std::vector<SubmitterThread> submitters( threads );
+		cl::CommandQueue sharedCommandQueue;
+		if( sharedQueue )
+		{
+			sharedCommandQueue=cl::CommandQueue( context, device, 0, &error );
+			if( error!=CL_SUCCESS ) throw std::runtime_error( "Error when creating command queue - "+tools::createQueueError(error) );
+		}
+		for( auto& submitter : submitters )
+		{
+			if( sharedQueue ) submitter.queue=sharedCommandQueue;
+			else
+			{
+				submitter.queue=cl::CommandQueue( context, device, 0, &error );
+				if( error!=CL_SUCCESS ) throw std::runtime_error( "Error when creating command queue - "+tools::createQueueError(error) );
+			}
+			// A kernel each, since clSetKernelArg on a shared kernel isn't thread safe
+			submitter.kernel=cl::Kernel( program, "tiny", &error );
+			if( error!=CL_SUCCESS ) throw std::runtime_error( "Error when creating kernel 'tiny' - "+tools::createKernelError(error) );
+			const std::vector<int> zeros( tinyGlobalSize, 0 );
+			submitter.output=tools::trace::createBuffer( context, CL_MEM_READ_WRITE | CL_MEM_COPY_HOST_PTR, tinyGlobalSize*sizeof(int), const_cast<int*>(zeros.data()), &error );
+			if( error!=CL_SUCCESS ) throw std::runtime_error( "Error when creating the output buffer - "+tools::createBufferError(error) );
+			error=submitter.kernel.setArg( 0, submitter.output );
+			if( error!=CL_SUCCESS ) throw std::runtime_error( "Error when setting kernel argument 0: "+tools::setKernelArgError(error) );
+
+			// Warm up, so that any lazy initialisation in the runtime isn't timed
+			error=tools::trace::enqueueNDRangeKernel( submitter.queue, submitter.kernel, cl::NullRange, cl::NDRange(tinyGlobalSize), cl::NullRange );
+			if( error!=CL_SUCCESS ) throw std::runtime_error( "Error when enqueing kernel - "+tools::enqueKernelError(error) );
+			tools::trace::finish( submitter.queue );
+		}
+
+		std::atomic<bool> start( false );
+		std::vector<std::thread> workers;
+		for( auto& submitter : submitters ) workers.push_back( std::thread( submitLoop, std::ref(submitter), submissionsPerThread, std::cref(start) ) );
+		// Give the threads a chance to all be waiting, so that they start together
+		std::this_thread::sleep_for( std::chrono::milliseconds(10) );
+
+		tools::StopWatch wallClock;
+		start.store( true, std::memory_order_release );
+		for( auto& worker : workers ) worker.join();
+		const double wallTime=wallClock.elapsed();
+
+		tools::TimingStatistics enqueueStatistics;
+		for( const auto& submitter : submitters )
+		{
+			if( !submitter.failure.empty() ) throw std::runtime_error( submitter.failure );
+			for( const double time : submitter.enqueueTimes ) enqueueStatistics.addSample( time );
+		}
+		const size_t submissions=threads*submissionsPerThread;
+		return tools::SubmissionResult{ threads, sharedQueue, submissions, submissions/wallTime,
+				enqueueStatistics.median(), enqueueStatistics.percentile(99), enqueueStatistics.max(), 1 };
+	}
+} // end of the unnamed namespace
+
+std::vector<tools::SubmissionResult> tools::measureSubmission( const cl::Device& device, size_t maxThreads, bool sharedQueue, size_t submissionsPerThread )
+{
+	cl_int error=CL_SUCCESS;
+	if( maxThreads==0 ) maxThreads=std::max( 1u, std::thread::hardware_concurrency() );
+	if( submissionsPerThread==0 ) throw std::runtime_error( "measureSubmission needs at least one submission per thread" );
+
+	cl::Context context=tools::trace::createContext( device, &error );
+	if( error!=CL_SUCCESS ) throw std::runtime_error( "Error when creating context - "+tools::contextCreateError(error) );
+	const cl::Program program=tools::DeviceSession::buildProgram( context, device, tinyKernelSource, std::vector<char>(), "", "tiny" );
+
+	// Powers of two, plus maxThreads itself if it isn't one
+	std::vector<size_t> threadCounts;
+	for( size_t threads=1; threads<maxThreads; threads*=2 ) threadCounts.push_back( threads );
+	threadCounts.push_back( maxThreads );
+
+	std::vector<SubmissionResult> results;
+	for( const size_t threads : threadCounts )
+	{
+		results.push_back( runThreads( context, device, program, threads, sharedQueue, submissionsPerThread ) );
+		results.back().scaling=results.back().submissionsPerSecond/results.front().submissionsPerSecond;
+	}
+	return results;
+}
+
+void tools::printSubmission( const std::vector<SubmissionResult>& results, std::ostream& output, const std::string& indent )
+{
+	std::ios::fmtflags previousFlags=output.flags();
+	std::streamsize previousPrecision=output.precision();
+
+	if( !results.empty() ) output << indent << ( results.front().sharedQueue ? "All threads sharing one queue" : "One queue per thread" ) << "\n";
+	output << indent << std::setw(8) << "threads" << std::setw(14) << "submits/s" << std::setw(10) << "scaling"
+			<< std::setw(14) << "enqueue med" << std::setw(12) << "p99" << std::setw(12) << "max" << "   (microseconds)" << "\n";
+	for( const auto& result : results )
+	{
+		output << indent << std::setw(8) << result.threads
+				<< std::fixed << std::setprecision(0) << std::setw(14) << result.submissionsPerSecond
+				<< std::setprecision(2) << std::setw(10) << result.scaling
+				<< std::setprecision(1) << std::setw(14) << result.medianEnqueue*1e6 << std::setw(12) << result.p99Enqueue*1e6 << std::setw(12) << result.maxEnqueue*1e6
+				<< "\n";
+	}
+	output.flags( previousFlags );
+	output.precision( previousPrecision );
+	output << std::flush;
+}
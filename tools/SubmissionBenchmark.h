@@ -0,0 +1,43 @@
+#ifndef INCLUDEGUARD_tools_SubmissionBenchmark_h
+#define INCLUDEGUARD_tools_SubmissionBenchmark_h
+
+#include <vector>
+#include <string>
+#include <iosfwd>
+#include <CL/cl.hpp>
+
+namespace tools
+{
+	/** @brief Submission throughput and enqueue latency for one number of host threads. */
+	struct SubmissionResult
+	{
+		size_t threads;
+		bool sharedQueue; ///< @brief True if every thread enqueued on the same queue, false if each had its own.
+		size_t submissions; ///< @brief Total over all threads.
+		double submissionsPerSecond; ///< @brief From the first enqueue until every queue has finished.
+		double medianEnqueue; ///< @brief Host seconds spent in one clEnqueueNDRangeKernel call, over all threads.
+		double p99Enqueue;
+		double maxEnqueue;
+		double scaling; ///< @brief submissionsPerSecond divided by that with one thread. 1 would mean no gain at all.
+	};
+
+	/** @brief Has 1, 2, 4... up to "maxThreads" host threads submit tiny kernels to the device as fast as they can.
+	 *
+	 * Each thread has its own kernel and output buffer, and either its own command queue or one queue shared
+	 * by all of them. The kernels do next to no work, so what is measured is how well the runtime copes with
+	 * enqueues from several threads at once. If submissions per second stops increasing (or drops) as threads are
+	 * added, and the tail enqueue latency grows, threads are contending for a lock inside the runtime. Comparing
+	 * a shared queue with one queue per thread shows whether that lock is per queue or per context/device.
+	 *
+	 * @param maxThreads            The largest number of threads. Zero means the number of hardware threads.
+	 * @param submissionsPerThread  Kernels each thread enqueues (after one untimed warm up).
+	 * @throw std::runtime_error     If the context, queues, kernels or buffers can't be created, or an enqueue fails.
+	 */
+	std::vector<SubmissionResult> measureSubmission( const cl::Device& device, size_t maxThreads, bool sharedQueue, size_t submissionsPerThread=2000 );
+
+	/** @brief Prints the results as a table, one row per number of threads. */
+	void printSubmission( const std::vector<SubmissionResult>& results, std::ostream& output, const std::string& indent="   " );
+
+} // end of the tools namespace
+
+#endif
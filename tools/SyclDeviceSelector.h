@@ -0,0 +1,38 @@
+#ifndef INCLUDEGUARD_tools_SyclDeviceSelector_h
+#define INCLUDEGUARD_tools_SyclDeviceSelector_h
+
+#include <string>
+#include <CL/sycl.hpp>
+#include "DeviceSelector.h"
+
+namespace tools
+{
+	/** @brief Wraps a BenchmarkDeviceSelector so that SYCL queues can be created from it.
+	 *
+	 * Header only so that the OpenCL only tools don't need SYCL to build. The SYCL host device has no
+	 * OpenCL device to benchmark, so it gets a score of zero and is only used if nothing else can be.
+	 */
+	class SyclDeviceSelector : public cl::sycl::device_selector
+	{
+	public:
+		/** @brief If requiredExtension is not empty, devices without it are never chosen (e.g. "cl_khr_spir"). */
+		explicit SyclDeviceSelector( const tools::BenchmarkDeviceSelector& selector, const std::string& requiredExtension="" )
+			: selector_(selector), requiredExtension_(requiredExtension)
+		{
+			// No operation besides the initialiser list
+		}
+
+		virtual int operator()( const cl::sycl::device& device ) const override
+		{
+			if( device.is_host() ) return 0;
+			if( !requiredExtension_.empty() && !device.has_extension(requiredExtension_) ) return -1;
+			return selector_( cl::Device( device.get() ) );
+		}
+	protected:
+		const tools::BenchmarkDeviceSelector& selector_;
+		std::string requiredExtension_;
+	};
+
+} // end of the tools namespace
+
+#endif
@@ -0,0 +1,160 @@
+#include "Timing.h"
+
+#include <stdexcept>
+#include <algorithm>
+#include <numeric>
+#include <cmath>
+#include <ostream>
+#include <iomanip>
+
+
+tools::StopWatch::StopWatch()
+	: startTime_( std::chrono::steady_clock::now() )
+{
+}
+
+void tools::StopWatch::reset()
+{
+	startTime_=std::chrono::steady_clock::now();
+}
+
+double tools::StopWatch::elapsed() const
+{
+	return std::chrono::duration<double>( std::chrono::steady_clock::now()-startTime_ ).count();
+}
+
+double tools::eventDuration( const cl::Event& event )
+{
+	cl_int error=CL_SUCCESS;
+	cl_ulong start=event.getProfilingInfo<CL_PROFILING_COMMAND_START>(&error);
+	if( error!=CL_SUCCESS ) throw std::runtime_error( "Profiling information is not available for the event (was the queue created with CL_QUEUE_PROFILING_ENABLE?)" );
+	cl_ulong end=event.getProfilingInfo<CL_PROFILING_COMMAND_END>(&error);
+	if( error!=CL_SUCCESS ) throw std::runtime_error( "Profiling information is not available for the event (was the queue created with CL_QUEUE_PROFILING_ENABLE?)" );
+	// Values are in nanoseconds. Some implementations have been known to give an end before
+	// the start for very short commands, so don't let that go negative.
+	return end>start ? (end-start)*1e-9 : 0;
+}
+
+void tools::TimingStatistics::addSample( double seconds )
+{
+	samples_.push_back( seconds );
+}
+
+size_t tools::TimingStatistics::size() const
+{
+	return samples_.size();
+}
+
+bool tools::TimingStatistics::empty() const
+{
+	return samples_.empty();
+}
+
+double tools::TimingStatistics::min() const
+{
+	if( samples_.empty() ) return 0;
+	return sorted().front();
+}
+
+double tools::TimingStatistics::max() const
+{
+	if( samples_.empty() ) return 0;
+	return sorted().back();
+}
+
+double tools::TimingStatistics::mean() const
+{
+	if( samples_.empty() ) return 0;
+	return std::accumulate( samples_.begin(), samples_.end(), 0.0 )/samples_.size();
+}
+
+double tools::TimingStatistics::median() const
+{
+	if( samples_.empty() ) return 0;
+	const auto& values=sorted();
+	size_t middle=values.size()/2;
+	if( values.size()%2==1 ) return values[middle];
+	else return (values[middle-1]+values[middle])/2;
+}
+
+double tools::TimingStatistics::percentile( double percent ) const
+{
+	if( samples_.empty() ) return 0;
+	const auto& values=sorted();
+	// Nearest rank method
+	size_t rank=static_cast<size_t>( std::ceil( percent/100.0*values.size() ) );
+	if( rank<1 ) rank=1;
+	if( rank>values.size() ) rank=values.size();
+	return values[rank-1];
+}
+
+const std::vector<double>& tools::TimingStatistics::samples() const
+{
+	return samples_;
+}
+
+const std::vector<double>& tools::TimingStatistics::sorted() const
+{
+	if( sorted_.size()!=samples_.size() )
+	{
+		sorted_=samples_;
+		std::sort( sorted_.begin(), sorted_.end() );
+	}
+	return sorted_;
+}
+
+tools::TimingStatistics& tools::PhaseTimings::phase( const std::string& name, size_t bytes, size_t elements )
+{
+	for( auto& existingPhase : phases_ )
+	{
+		if( existingPhase.name==name ) return existingPhase.statistics;
+	}
+	phases_.push_back( Phase{ name, bytes, elements, TimingStatistics() } );
+	return phases_.back().statistics;
+}
+
+const std::vector<tools::PhaseTimings::Phase>& tools::PhaseTimings::phases() const
+{
+	return phases_;
+}
+
+bool tools::PhaseTimings::empty() const
+{
+	return phases_.empty();
+}
+
+void tools::PhaseTimings::print( std::ostream& output, const std::string& indent ) const
+{
+	size_t nameWidth=5;
+	for( const auto& phase : phases_ ) nameWidth=std::max( nameWidth, phase.name.size() );
+
+	std::ios::fmtflags previousFlags=output.flags();
+	output << indent << std::left << std::setw(nameWidth) << "phase" << std::right
+			<< std::setw(8) << "samples"
+			<< std::setw(12) << "min(ms)"
+			<< std::setw(12) << "median(ms)"
+			<< std::setw(12) << "p99(ms)"
+			<< std::setw(12) << "max(ms)"
+			<< std::setw(10) << "GB/s"
+			<< std::setw(14) << "Melements/s" << "\n";
+	output << std::fixed;
+	for( const auto& phase : phases_ )
+	{
+		const auto& statistics=phase.statistics;
+		output << indent << std::left << std::setw(nameWidth) << phase.name << std::right
+				<< std::setw(8) << statistics.size()
+				<< std::setprecision(3)
+				<< std::setw(12) << statistics.min()*1e3
+				<< std::setw(12) << statistics.median()*1e3
+				<< std::setw(12) << statistics.percentile(99)*1e3
+				<< std::setw(12) << statistics.max()*1e3;
+		double median=statistics.median();
+		if( phase.bytes!=0 && median>0 ) output << std::setw(10) << std::setprecision(2) << phase.bytes/median/1e9;
+		else output << std::setw(10) << "-";
+		if( phase.elements!=0 && median>0 ) output << std::setw(14) << std::setprecision(2) << phase.elements/median/1e6;
+		else output << std::setw(14) << "-";
+		output << "\n";
+	}
+	output.flags( previousFlags );
+	output << std::flush;
+}
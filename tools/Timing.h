@@ -0,0 +1,78 @@
+#ifndef INCLUDEGUARD_tools_Timing_h
+#define INCLUDEGUARD_tools_Timing_h
+
+#include <vector>
+#include <string>
+#include <chrono>
+#include <iosfwd>
+#include <CL/cl.hpp>
+
+namespace tools
+{
+	/** @brief Simple host side wall clock timer. Starts timing when constructed. */
+	class StopWatch
+	{
+	public:
+		StopWatch();
+		void reset();
+		/** @brief The time in seconds since construction or the last call to reset(). */
+		double elapsed() const;
+	protected:
+		std::chrono::steady_clock::time_point startTime_;
+	};
+
+	/** @brief The time in seconds between CL_PROFILING_COMMAND_START and CL_PROFILING_COMMAND_END.
+	 *
+	 * The queue the event was enqueued on must have been created with CL_QUEUE_PROFILING_ENABLE.
+	 * @throw std::runtime_error     If the profiling information is not available.
+	 */
+	double eventDuration( const cl::Event& event );
+
+	/** @brief Collects timing samples (in seconds) and provides summary statistics on them. */
+	class TimingStatistics
+	{
+	public:
+		void addSample( double seconds );
+		size_t size() const;
+		bool empty() const;
+		double min() const;
+		double max() const;
+		double mean() const;
+		double median() const;
+		/** @brief Nearest rank percentile, "percent" should be in the range 0 to 100. */
+		double percentile( double percent ) const;
+		const std::vector<double>& samples() const;
+	protected:
+		std::vector<double> samples_;
+		mutable std::vector<double> sorted_; ///< @brief Sorted copy of samples_, only rebuilt when the sizes differ.
+		const std::vector<double>& sorted() const;
+	};
+
+	/** @brief A set of named TimingStatistics, kept in the order the phases were first added.
+	 *
+	 * Each phase can optionally be told how many bytes and elements it processes each time
+	 * it runs, in which case the throughput is included when printed.
+	 */
+	class PhaseTimings
+	{
+	public:
+		struct Phase
+		{
+			std::string name;
+			size_t bytes;
+			size_t elements;
+			TimingStatistics statistics;
+		};
+		/** @brief Get the phase with the given name, creating it if it doesn't exist yet. */
+		TimingStatistics& phase( const std::string& name, size_t bytes=0, size_t elements=0 );
+		const std::vector<Phase>& phases() const;
+		bool empty() const;
+		/** @brief Print min/median/p99/max for each phase, plus throughput using the median time. */
+		void print( std::ostream& output, const std::string& indent="   " ) const;
+	protected:
+		std::vector<Phase> phases_;
+	};
+
+} // end of the tools namespace
+
+#endif
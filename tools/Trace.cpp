@@ -0,0 +1,305 @@
+#include "Trace.h"
+
+#include <atomic>
+#include <mutex>
+#include <memory>
+#include <chrono>
+#include <map>
+#include <cstring>
+#include <cstdio>
+#include <ostream>
+#include <iomanip>
+#include "stringTools.h"
+
+//
+// Unnamed namespace for things only used in this file
+//
+namespace
+{
+	/** @brief One traced call. Fixed size so that recording never allocates once the ring buffer exists. */
+	struct Record
+	{
+		const char* category; ///< @brief Always a string literal
+		char name[64]; ///< @brief Truncated if longer
+		uint64_t hostStart; ///< @brief Nanoseconds since tracing was enabled
+		uint64_t hostEnd;
+		uint64_t bytes;
+		cl_command_queue queue; ///< @brief Only used to pick the device track, null for host only records
+		cl::Event event; ///< @brief Null if there is no device side to the record
+	};
+
+	/** @brief A ring buffer written by only one thread. "written" is the total ever written, so the
+	 * most recent records are at written-capacity to written-1 (modulo the capacity). */
+	struct ThreadBuffer
+	{
+		std::vector<Record> records;
+		std::atomic<uint64_t> written;
+		size_t threadIndex;
+	};
+
+	std::atomic<bool> tracingEnabled( false );
+	std::chrono::steady_clock::time_point epoch;
+	size_t recordsPerThread=0;
+
+	// Only locked when a thread records for the first time, and when the trace is written
+	std::mutex registryMutex;
+	std::vector<std::unique_ptr<ThreadBuffer> > threadBuffers; ///< @brief Never freed, since threads can finish before the trace is written
+	thread_local ThreadBuffer* pThisThreadBuffer=nullptr;
+
+	uint64_t now()
+	{
+		return std::chrono::duration_cast<std::chrono::nanoseconds>( std::chrono::steady_clock::now()-epoch ).count();
+	}
+
+	ThreadBuffer& thisThreadBuffer()
+	{
+		if( pThisThreadBuffer==nullptr )
+		{
+			std::lock_guard<std::mutex> lock( registryMutex );
+			std::unique_ptr<ThreadBuffer> pNewBuffer( new ThreadBuffer );
+			pNewBuffer->records.resize( recordsPerThread );
+			pNewBuffer->written.store( 0 );
+			pNewBuffer->threadIndex=threadBuffers.size();
+			pThisThreadBuffer=pNewBuffer.get();
+			threadBuffers.push_back( std::move(pNewBuffer) );
+		}
+		return *pThisThreadBuffer;
+	}
+
+	void record( const char* category, const std::string& name, uint64_t hostStart, uint64_t hostEnd, uint64_t bytes=0,
+			cl_command_queue queue=nullptr, const cl::Event* pEvent=nullptr )
+	{
+		ThreadBuffer& buffer=thisThreadBuffer();
+		const uint64_t index=buffer.written.load( std::memory_order_relaxed );
+		Record& newRecord=buffer.records[index%buffer.records.size()];
+		newRecord.category=category;
+		std::strncpy( newRecord.name, name.c_str(), sizeof(newRecord.name)-1 );
+		newRecord.name[sizeof(newRecord.name)-1]='\0';
+		newRecord.hostStart=hostStart;
+		newRecord.hostEnd=hostEnd;
+		newRecord.bytes=bytes;
+		newRecord.queue=queue;
+		newRecord.event=( pEvent ? *pEvent : cl::Event() );
+		// Release so that the writer of the trace sees the whole record
+		buffer.written.store( index+1, std::memory_order_release );
+	}
+
+	/** @brief Chrome trace timestamps are in microseconds. */
+	double microseconds( uint64_t nanoseconds )
+	{
+		return nanoseconds*1e-3;
+	}
+
+	/** @brief Records an enqueue call, using a local event if the caller didn't ask for one. */
+	template<class T_enqueueFunction>
+	cl_int tracedEnqueue( const char* category, const std::string& name, uint64_t bytes, const cl::CommandQueue& queue, cl::Event* pEvent, T_enqueueFunction enqueue )
+	{
+		if( !tracingEnabled.load( std::memory_order_relaxed ) ) return enqueue( pEvent );
+
+		cl::Event localEvent;
+		cl::Event* pTracedEvent=( pEvent ? pEvent : &localEvent );
+		const uint64_t start=now();
+		const cl_int error=enqueue( pTracedEvent );
+		const uint64_t end=now();
+		record( category, name, start, end, bytes, queue(), error==CL_SUCCESS ? pTracedEvent : nullptr );
+		return error;
+	}
+} // end of the unnamed namespace
+
+void tools::trace::enable( size_t newRecordsPerThread )
+{
+	std::lock_guard<std::mutex> lock( registryMutex );
+	if( tracingEnabled.load() ) return;
+	recordsPerThread=( newRecordsPerThread>0 ? newRecordsPerThread : 1 );
+	epoch=std::chrono::steady_clock::now();
+	tracingEnabled.store( true );
+}
+
+bool tools::trace::enabled()
+{
+	return tracingEnabled.load( std::memory_order_relaxed );
+}
+
+void tools::trace::writeChromeTrace( std::ostream& output )
+{
+	std::lock_guard<std::mutex> lock( registryMutex );
+	std::ios::fmtflags previousFlags=output.flags();
+	std::streamsize previousPrecision=output.precision();
+	output << std::fixed << std::setprecision(3);
+
+	const int hostProcess=1;
+	const int deviceProcess=2;
+	std::map<cl_command_queue,size_t> queueTracks;
+	bool first=true;
+	auto separator=[&first]() -> const char* { const char* text=( first ? "\n" : ",\n" ); first=false; return text; };
+
+	output << "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [";
+	output << separator() << "{\"name\": \"process_name\", \"ph\": \"M\", \"pid\": " << hostProcess << ", \"args\": {\"name\": \"host\"}}";
+	output << separator() << "{\"name\": \"process_name\", \"ph\": \"M\", \"pid\": " << deviceProcess << ", \"args\": {\"name\": \"device queues\"}}";
+
+	for( const auto& pBuffer : threadBuffers )
+	{
+		output << separator() << "{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": " << hostProcess << ", \"tid\": " << pBuffer->threadIndex
+				<< ", \"args\": {\"name\": \"thread " << pBuffer->threadIndex << "\"}}";
+
+		const uint64_t written=pBuffer->written.load( std::memory_order_acquire );
+		const uint64_t capacity=pBuffer->records.size();
+		for( uint64_t index=( written>capacity ? written-capacity : 0 ); index<written; ++index )
+		{
+			const Record& traced=pBuffer->records[index%capacity];
+			const std::string name=tools::jsonEscape( traced.name );
+			output << separator() << "{\"name\": \"" << name << "\", \"cat\": \"" << traced.category << "\", \"ph\": \"X\", \"pid\": " << hostProcess
+					<< ", \"tid\": " << pBuffer->threadIndex << ", \"ts\": " << microseconds(traced.hostStart) << ", \"dur\": " << microseconds(traced.hostEnd-traced.hostStart);
+			if( traced.bytes!=0 ) output << ", \"args\": {\"bytes\": " << traced.bytes << "}";
+			output << "}";
+
+			if( traced.event()==nullptr ) continue;
+			cl_int error=traced.event.wait();
+			if( error!=CL_SUCCESS ) continue;
+			const cl_ulong queued=traced.event.getProfilingInfo<CL_PROFILING_COMMAND_QUEUED>(&error);
+			if( error!=CL_SUCCESS ) continue; // Queue wasn't created with profiling enabled
+			const cl_ulong submitted=traced.event.getProfilingInfo<CL_PROFILING_COMMAND_SUBMIT>(&error);
+			const cl_ulong started=traced.event.getProfilingInfo<CL_PROFILING_COMMAND_START>(&error);
+			const cl_ulong ended=traced.event.getProfilingInfo<CL_PROFILING_COMMAND_END>(&error);
+			if( error!=CL_SUCCESS || started<queued ) continue;
+
+			auto iTrack=queueTracks.find( traced.queue );
+			if( iTrack==queueTracks.end() )
+			{
+				iTrack=queueTracks.insert( std::make_pair( traced.queue, queueTracks.size() ) ).first;
+				output << separator() << "{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": " << deviceProcess << ", \"tid\": " << iTrack->second
+						<< ", \"args\": {\"name\": \"queue " << iTrack->second << "\"}}";
+			}
+			const uint64_t deviceStart=traced.hostStart+(started-queued);
+			output << separator() << "{\"name\": \"" << name << "\", \"cat\": \"device\", \"ph\": \"X\", \"pid\": " << deviceProcess << ", \"tid\": " << iTrack->second
+					<< ", \"ts\": " << microseconds(deviceStart) << ", \"dur\": " << microseconds( ended>started ? ended-started : 0 )
+					<< ", \"args\": {\"queued to submit us\": " << microseconds( submitted>queued ? submitted-queued : 0 )
+					<< ", \"submit to start us\": " << microseconds( started>submitted ? started-submitted : 0 ) << "}}";
+		}
+	}
+	output << "\n]}" << std::endl;
+
+	output.flags( previousFlags );
+	output.precision( previousPrecision );
+}
+
+tools::trace::Scope::Scope( const char* category, const std::string& name )
+	: category_(category), name_(name), startTime_(0), enabled_( tools::trace::enabled() )
+{
+	if( enabled_ ) startTime_=now();
+}
+
+tools::trace::Scope::~Scope()
+{
+	if( enabled_ ) record( category_, name_, startTime_, now() );
+}
+
+cl::Context tools::trace::createContext( const cl::Device& device, cl_int* pError )
+{
+	if( !tracingEnabled.load( std::memory_order_relaxed ) ) return cl::Context( device, nullptr, nullptr, nullptr, pError );
+
+	const uint64_t start=now();
+	cl::Context context( device, nullptr, nullptr, nullptr, pError );
+	record( "context", "create context", start, now() );
+	return context;
+}
+
+cl_int tools::trace::build( const cl::Program& program, const std::vector<cl::Device>& devices, const std::string& options, const std::string& name )
+{
+	if( !tracingEnabled.load( std::memory_order_relaxed ) ) return program.build( devices, options.c_str() );
+
+	const uint64_t start=now();
+	const cl_int error=program.build( devices, options.c_str() );
+	record( "build", "build "+name, start, now() );
+	return error;
+}
+
+cl::Buffer tools::trace::createBuffer( const cl::Context& context, cl_mem_flags flags, size_t bytes, void* pHostMemory, cl_int* pError )
+{
+	if( !tracingEnabled.load( std::memory_order_relaxed ) ) return cl::Buffer( context, flags, bytes, pHostMemory, pError );
+
+	const uint64_t start=now();
+	cl::Buffer buffer( context, flags, bytes, pHostMemory, pError );
+	record( "buffer", "create buffer", start, now(), bytes );
+	return buffer;
+}
+
+cl_int tools::trace::enqueueWriteBuffer( const cl::CommandQueue& queue, const cl::Buffer& buffer, cl_bool blocking, size_t offset, size_t bytes, const void* pHostMemory,
+		const std::vector<cl::Event>* pWaitList, cl::Event* pEvent )
+{
+	return tracedEnqueue( "transfer", blocking ? "write (blocking)" : "write", bytes, queue, pEvent, [&]( cl::Event* pTracedEvent )
+		{
+			return queue.enqueueWriteBuffer( buffer, blocking, offset, bytes, pHostMemory, pWaitList, pTracedEvent );
+		} );
+}
+
+cl_int tools::trace::enqueueReadBuffer( const cl::CommandQueue& queue, const cl::Buffer& buffer, cl_bool blocking, size_t offset, size_t bytes, void* pHostMemory,
+		const std::vector<cl::Event>* pWaitList, cl::Event* pEvent )
+{
+	return tracedEnqueue( "transfer", blocking ? "read (blocking)" : "read", bytes, queue, pEvent, [&]( cl::Event* pTracedEvent )
+		{
+			return queue.enqueueReadBuffer( buffer, blocking, offset, bytes, pHostMemory, pWaitList, pTracedEvent );
+		} );
+}
+
+cl_int tools::trace::enqueueFillBuffer( const cl::CommandQueue& queue, const cl::Buffer& buffer, cl_uchar pattern, size_t offset, size_t bytes,
+		const std::vector<cl::Event>* pWaitList, cl::Event* pEvent )
+{
+	return tracedEnqueue( "transfer", "fill", bytes, queue, pEvent, [&]( cl::Event* pTracedEvent )
+		{
+			return queue.enqueueFillBuffer( buffer, pattern, offset, bytes, pWaitList, pTracedEvent );
+		} );
+}
+
+cl_int tools::trace::enqueueCopyBuffer( const cl::CommandQueue& queue, const cl::Buffer& source, const cl::Buffer& destination, size_t sourceOffset, size_t destinationOffset,
+		size_t bytes, const std::vector<cl::Event>* pWaitList, cl::Event* pEvent )
+{
+	return tracedEnqueue( "transfer", "copy", bytes, queue, pEvent, [&]( cl::Event* pTracedEvent )
+		{
+			return queue.enqueueCopyBuffer( source, destination, sourceOffset, destinationOffset, bytes, pWaitList, pTracedEvent );
+		} );
+}
+
+void* tools::trace::enqueueMapBuffer( const cl::CommandQueue& queue, const cl::Buffer& buffer, cl_bool blocking, cl_map_flags flags, size_t offset, size_t bytes,
+		const std::vector<cl::Event>* pWaitList, cl::Event* pEvent, cl_int* pError )
+{
+	void* pMapped=nullptr;
+	const cl_int error=tracedEnqueue( "transfer", blocking ? "map (blocking)" : "map", bytes, queue, pEvent, [&]( cl::Event* pTracedEvent )
+		{
+			cl_int mapError=CL_SUCCESS;
+			pMapped=queue.enqueueMapBuffer( buffer, blocking, flags, offset, bytes, pWaitList, pTracedEvent, &mapError );
+			return mapError;
+		} );
+	if( pError ) *pError=error;
+	return pMapped;
+}
+
+cl_int tools::trace::enqueueUnmapMemObject( const cl::CommandQueue& queue, const cl::Memory& memory, void* pMapped,
+		const std::vector<cl::Event>* pWaitList, cl::Event* pEvent )
+{
+	return tracedEnqueue( "transfer", "unmap", 0, queue, pEvent, [&]( cl::Event* pTracedEvent )
+		{
+			return queue.enqueueUnmapMemObject( memory, pMapped, pWaitList, pTracedEvent );
+		} );
+}
+
+cl_int tools::trace::enqueueNDRangeKernel( const cl::CommandQueue& queue, const cl::Kernel& kernel, const cl::NDRange& offset, const cl::NDRange& global,
+		const cl::NDRange& local, const std::vector<cl::Event>* pWaitList, cl::Event* pEvent )
+{
+	// Only look up the name if it's going to be used
+	const std::string name=( tools::trace::enabled() ? "kernel "+kernel.getInfo<CL_KERNEL_FUNCTION_NAME>() : std::string() );
+	return tracedEnqueue( "kernel", name, 0, queue, pEvent, [&]( cl::Event* pTracedEvent )
+		{
+			return queue.enqueueNDRangeKernel( kernel, offset, global, local, pWaitList, pTracedEvent );
+		} );
+}
+
+cl_int tools::trace::finish( const cl::CommandQueue& queue )
+{
+	if( !tracingEnabled.load( std::memory_order_relaxed ) ) return queue.finish();
+
+	const uint64_t start=now();
+	const cl_int error=queue.finish();
+	record( "sync", "finish", start, now() );
+	return error;
+}
@@ -0,0 +1,75 @@
+#ifndef INCLUDEGUARD_tools_Trace_h
+#define INCLUDEGUARD_tools_Trace_h
+
+#include <vector>
+#include <string>
+#include <cstdint>
+#include <iosfwd>
+#include <CL/cl.hpp>
+
+namespace tools
+{
+	/** @brief Thin wrappers around the OpenCL calls worth seeing on a timeline, which record them if tracing is enabled.
+	 *
+	 * Each wrapper behaves exactly like the call it wraps. When tracing is enabled it also records the host
+	 * time spent in the call and, for enqueues, keeps the event so that the device timestamps can be read
+	 * once it has finished. Device timestamps are only available if the queue was created with
+	 * CL_QUEUE_PROFILING_ENABLE. They are put on the host timeline by assuming that CL_PROFILING_COMMAND_QUEUED
+	 * happened at the start of the enqueue call.
+	 *
+	 * Each thread records into its own fixed size ring buffer, so recording never takes a lock (apart from
+	 * once per thread, to register the buffer). When a ring buffer is full the oldest records are overwritten.
+	 * When tracing is disabled each wrapper costs one atomic load on top of the call itself.
+	 */
+	namespace trace
+	{
+		/** @brief Starts recording. Times are relative to the first call. */
+		void enable( size_t recordsPerThread=1<<16 );
+		bool enabled();
+
+		/** @brief Writes everything recorded so far as Chrome trace event JSON, for chrome://tracing or ui.perfetto.dev.
+		 *
+		 * Host calls are on one track per thread, device commands on one track per queue. Waits for any
+		 * recorded commands that haven't finished, so should only be called once the other threads have
+		 * stopped recording.
+		 */
+		void writeChromeTrace( std::ostream& output );
+
+		/** @brief Records a host range from construction to destruction, for host work between the OpenCL calls. */
+		class Scope
+		{
+		public:
+			Scope( const char* category, const std::string& name );
+			~Scope();
+		protected:
+			const char* category_;
+			std::string name_;
+			uint64_t startTime_;
+			bool enabled_;
+		};
+
+		cl::Context createContext( const cl::Device& device, cl_int* pError );
+		/** @brief "name" is only used to label the trace. */
+		cl_int build( const cl::Program& program, const std::vector<cl::Device>& devices, const std::string& options, const std::string& name );
+		cl::Buffer createBuffer( const cl::Context& context, cl_mem_flags flags, size_t bytes, void* pHostMemory, cl_int* pError );
+		cl_int enqueueWriteBuffer( const cl::CommandQueue& queue, const cl::Buffer& buffer, cl_bool blocking, size_t offset, size_t bytes, const void* pHostMemory,
+				const std::vector<cl::Event>* pWaitList=nullptr, cl::Event* pEvent=nullptr );
+		cl_int enqueueReadBuffer( const cl::CommandQueue& queue, const cl::Buffer& buffer, cl_bool blocking, size_t offset, size_t bytes, void* pHostMemory,
+				const std::vector<cl::Event>* pWaitList=nullptr, cl::Event* pEvent=nullptr );
+		/** @brief Fills with a repeated byte, as cl::CommandQueue::enqueueFillBuffer with a cl_uchar pattern. */
+		cl_int enqueueFillBuffer( const cl::CommandQueue& queue, const cl::Buffer& buffer, cl_uchar pattern, size_t offset, size_t bytes,
+				const std::vector<cl::Event>* pWaitList=nullptr, cl::Event* pEvent=nullptr );
+		cl_int enqueueCopyBuffer( const cl::CommandQueue& queue, const cl::Buffer& source, const cl::Buffer& destination, size_t sourceOffset, size_t destinationOffset,
+				size_t bytes, const std::vector<cl::Event>* pWaitList=nullptr, cl::Event* pEvent=nullptr );
+		void* enqueueMapBuffer( const cl::CommandQueue& queue, const cl::Buffer& buffer, cl_bool blocking, cl_map_flags flags, size_t offset, size_t bytes,
+				const std::vector<cl::Event>* pWaitList=nullptr, cl::Event* pEvent=nullptr, cl_int* pError=nullptr );
+		cl_int enqueueUnmapMemObject( const cl::CommandQueue& queue, const cl::Memory& memory, void* pMapped,
+				const std::vector<cl::Event>* pWaitList=nullptr, cl::Event* pEvent=nullptr );
+		cl_int enqueueNDRangeKernel( const cl::CommandQueue& queue, const cl::Kernel& kernel, const cl::NDRange& offset, const cl::NDRange& global,
+				const cl::NDRange& local, const std::vector<cl::Event>* pWaitList=nullptr, cl::Event* pEvent=nullptr );
+		cl_int finish( const cl::CommandQueue& queue );
+
+	} // end of the tools::trace namespace
+} // end of the tools namespace
+
+#endif
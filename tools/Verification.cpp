@@ -0,0 +1,199 @@
+#include "Verification.h"
+
+#include <stdexcept>
+#include <ostream>
+#include <sstream>
+#include <algorithm>
+#include <limits>
+#include <cmath>
+#include <cstring>
+#include <cstdint>
+#include "Timing.h"
+#include "HostBaseline.h"
+
+//
+// Unnamed namespace for things only used in this file
+//
+namespace
+{
+	const size_t blockSize=4096; ///< @brief Elements checked at a time by each thread, small enough for the buffers to stay in cache
+
+	/** @brief Maps a float to an integer so that adjacent floats differ by one, with -0 and +0 both zero. */
+	inline int64_t orderedBits( float value )
+	{
+		int32_t bits;
+		std::memcpy( &bits, &value, sizeof(bits) );
+		return bits<0 ? static_cast<int64_t>(std::numeric_limits<int32_t>::min())-bits : bits;
+	}
+
+	/** @brief Fills pErrors with the error of each element, and returns how many are over the limit.
+	 *
+	 * Equal values always have an error of zero, so that infinities match. NaNs have an infinite error.
+	 * The loops have no branches so that they can be vectorised.
+	 */
+	size_t blockErrors( tools::Tolerance::Mode mode, double limit, const float* pActual, const float* pExpected, size_t count, double* pErrors )
+	{
+		const double infinity=std::numeric_limits<double>::infinity();
+		if( mode==tools::Tolerance::Ulp )
+		{
+			for( size_t index=0; index<count; ++index )
+			{
+				const double distance=static_cast<double>( std::llabs( orderedBits(pActual[index])-orderedBits(pExpected[index]) ) );
+				const bool isNaN=( pActual[index]!=pActual[index] ) | ( pExpected[index]!=pExpected[index] );
+				pErrors[index]=( pActual[index]==pExpected[index] ) ? 0.0 : ( isNaN ? infinity : distance );
+			}
+		}
+		else if( mode==tools::Tolerance::Relative )
+		{
+			for( size_t index=0; index<count; ++index )
+			{
+				const double error=std::fabs( static_cast<double>(pActual[index])-pExpected[index] )/std::fabs( static_cast<double>(pExpected[index]) );
+				pErrors[index]=( pActual[index]==pExpected[index] ) ? 0.0 : ( error==error ? error : infinity );
+			}
+		}
+		else
+		{
+			for( size_t index=0; index<count; ++index )
+			{
+				const double error=std::fabs( static_cast<double>(pActual[index])-pExpected[index] );
+				pErrors[index]=( pActual[index]==pExpected[index] ) ? 0.0 : ( error==error ? error : infinity );
+			}
+		}
+
+		size_t overLimit=0;
+		for( size_t index=0; index<count; ++index ) overLimit+=( pErrors[index]>limit );
+		return overLimit;
+	}
+} // end of the unnamed namespace
+
+tools::Tolerance tools::Tolerance::fromString( const std::string& description )
+{
+	if( description=="exact" ) return Tolerance{ Exact, 0 };
+
+	size_t colonPosition=description.find(':');
+	if( colonPosition==std::string::npos ) throw std::runtime_error( "Tolerance '"+description+"' should be 'exact', 'abs:<value>', 'rel:<value>' or 'ulp:<value>'" );
+	const std::string modeName=description.substr( 0, colonPosition );
+	Tolerance tolerance;
+	if( modeName=="abs" ) tolerance.mode=Absolute;
+	else if( modeName=="rel" ) tolerance.mode=Relative;
+	else if( modeName=="ulp" ) tolerance.mode=Ulp;
+	else throw std::runtime_error( "Unknown tolerance mode '"+modeName+"', expected 'exact', 'abs', 'rel' or 'ulp'" );
+
+	try{ tolerance.value=std::stod( description.substr(colonPosition+1) ); }
+	catch( std::exception& error ) { throw std::runtime_error( "Invalid tolerance value in '"+description+"'" ); }
+	if( tolerance.value<0 ) throw std::runtime_error( "Tolerance '"+description+"' can't be negative" );
+	return tolerance;
+}
+
+std::string tools::Tolerance::toString() const
+{
+	std::ostringstream output;
+	switch( mode )
+	{
+		case Exact: return "exact";
+		case Absolute: output << "abs:"; break;
+		case Relative: output << "rel:"; break;
+		case Ulp: output << "ulp:"; break;
+	}
+	output << value;
+	return output.str();
+}
+
+tools::ResultVerifier::ResultVerifier( const Tolerance& tolerance, size_t numberOfThreads, size_t mismatchesToRecord )
+	: tolerance_(tolerance), numberOfThreads_(numberOfThreads), mismatchesToRecord_(mismatchesToRecord)
+{
+	numberOfThreads_=tools::hostThreadCount( numberOfThreads_ );
+}
+
+tools::VerificationResult tools::ResultVerifier::verify( const float* pActual, size_t count, const ExpectedGenerator& expected ) const
+{
+	tools::StopWatch stopWatch;
+	const double limit=( tolerance_.mode==Tolerance::Exact ? 0.0 : tolerance_.value );
+
+	// Split by whole blocks. parallelFor doesn't use more threads than there are blocks, and gives each the same
+	// number of blocks, so the part a thread has tells which result is its own.
+	const size_t blocks=(count+blockSize-1)/blockSize;
+	const size_t threads=std::max<size_t>( 1, std::min( numberOfThreads_, blocks ) );
+	const size_t blocksPerThread=(blocks+threads-1)/threads;
+
+	std::vector<VerificationResult> threadResults( threads, VerificationResult{ 0, 0, 0, 0, std::vector<size_t>(), 0, 1 } );
+	tools::parallelFor( blocks, threads, [&]( size_t firstBlock, size_t partBlocks )
+		{
+			VerificationResult& result=threadResults[firstBlock/blocksPerThread];
+			std::vector<float> expectedBlock( blockSize );
+			std::vector<double> errors( blockSize );
+			const size_t rangeEnd=std::min( count, (firstBlock+partBlocks)*blockSize );
+			for( size_t first=firstBlock*blockSize; first<rangeEnd; first+=blockSize )
+			{
+				const size_t blockCount=std::min( blockSize, rangeEnd-first );
+				expected( first, blockCount, expectedBlock.data() );
+				const size_t overLimit=blockErrors( tolerance_.mode, limit, pActual+first, expectedBlock.data(), blockCount, errors.data() );
+
+				result.checked+=blockCount;
+				result.mismatches+=overLimit;
+				for( size_t index=0; index<blockCount; ++index )
+				{
+					if( errors[index]>result.maxError )
+					{
+						result.maxError=errors[index];
+						result.maxErrorIndex=first+index;
+					}
+				}
+				// Rare, so a scalar scan is fine
+				for( size_t index=0; overLimit!=0 && index<blockCount && result.firstMismatches.size()<mismatchesToRecord_; ++index )
+				{
+					if( errors[index]>limit ) result.firstMismatches.push_back( first+index );
+				}
+			}
+		} );
+
+	// The threads have consecutive ranges, so the mismatch lists are already in order
+	VerificationResult result{ 0, 0, 0, 0, std::vector<size_t>(), 0, threads };
+	for( const auto& threadResult : threadResults )
+	{
+		result.checked+=threadResult.checked;
+		result.mismatches+=threadResult.mismatches;
+		if( threadResult.maxError>result.maxError )
+		{
+			result.maxError=threadResult.maxError;
+			result.maxErrorIndex=threadResult.maxErrorIndex;
+		}
+		for( const auto index : threadResult.firstMismatches )
+		{
+			if( result.firstMismatches.size()<mismatchesToRecord_ ) result.firstMismatches.push_back( index );
+		}
+	}
+	result.time=stopWatch.elapsed();
+	return result;
+}
+
+tools::VerificationResult tools::ResultVerifier::verify( const float* pActual, const float* pExpected, size_t count ) const
+{
+	return verify( pActual, count, [pExpected]( size_t first, size_t blockCount, float* pBlock ){ std::copy( pExpected+first, pExpected+first+blockCount, pBlock ); } );
+}
+
+const tools::Tolerance& tools::ResultVerifier::tolerance() const
+{
+	return tolerance_;
+}
+
+size_t tools::ResultVerifier::numberOfThreads() const
+{
+	return numberOfThreads_;
+}
+
+void tools::printVerification( const VerificationResult& result, const Tolerance& tolerance, std::ostream& output, const std::string& indent )
+{
+	output << indent << result.checked-result.mismatches << "/" << result.checked << " correct results (verified in " << result.time*1e3
+			<< " ms ";
+	if( result.threads==0 ) output << "on the device)." << "\n";
+	else output << "on " << result.threads << " threads)." << "\n";
+	if( result.mismatches!=0 )
+	{
+		output << indent << "   Maximum error " << result.maxError << ( tolerance.mode==Tolerance::Ulp ? " ULP" : "" ) << " at index " << result.maxErrorIndex
+				<< " (tolerance " << tolerance.toString() << "). First mismatches at";
+		for( const auto index : result.firstMismatches ) output << " " << index;
+		output << "\n";
+	}
+	output << std::flush;
+}
@@ -0,0 +1,77 @@
+#ifndef INCLUDEGUARD_tools_Verification_h
+#define INCLUDEGUARD_tools_Verification_h
+
+#include <vector>
+#include <string>
+#include <functional>
+#include <iosfwd>
+
+namespace tools
+{
+	/** @brief How far a result can be from the expected value and still count as correct. */
+	struct Tolerance
+	{
+		/** @brief Exact       - must be equal.
+		 * Absolute    - |actual-expected| <= value.
+		 * Relative    - |actual-expected| <= value*|expected|.
+		 * Ulp         - no more than value representable floats apart.
+		 */
+		enum Mode { Exact, Absolute, Relative, Ulp };
+		Mode mode;
+		double value;
+
+		/** @brief Parses "exact", "abs:<value>", "rel:<value>" or "ulp:<value>".
+		 *
+		 * @throw std::runtime_error     If the string is not in one of those forms.
+		 */
+		static Tolerance fromString( const std::string& description );
+		/** @brief The inverse of fromString. */
+		std::string toString() const;
+	};
+
+	/** @brief The outcome of checking a set of results. */
+	struct VerificationResult
+	{
+		size_t checked;
+		size_t mismatches;
+		double maxError; ///< @brief Largest error over all elements, in the units of the tolerance mode (ULPs for Ulp, absolute difference for Exact)
+		size_t maxErrorIndex;
+		std::vector<size_t> firstMismatches; ///< @brief Indices of the first few mismatching elements, in order
+		double time; ///< @brief Host wall clock seconds the check took
+		size_t threads; ///< @brief How many host threads the check was split across, or zero if it was done on the device
+	};
+
+	/** @brief Checks float results against expected values, splitting the range across several host threads.
+	 *
+	 * Each thread works through its part in small blocks. The expected values for a block are generated
+	 * into a thread local buffer, then the errors for the whole block are calculated and compared in
+	 * branch free loops that the compiler can vectorise. Only blocks with mismatches are scanned again to
+	 * find the indices.
+	 */
+	class ResultVerifier
+	{
+	public:
+		/** @brief Fills pExpected with the expected values of elements first to first+count-1. Called from several threads at once. */
+		typedef std::function<void(size_t first, size_t count, float* pExpected)> ExpectedGenerator;
+
+		/** @brief A numberOfThreads of zero means std::thread::hardware_concurrency() (see tools::hostThreadCount). */
+		ResultVerifier( const Tolerance& tolerance=Tolerance{Tolerance::Exact,0}, size_t numberOfThreads=0, size_t mismatchesToRecord=5 );
+
+		VerificationResult verify( const float* pActual, size_t count, const ExpectedGenerator& expected ) const;
+		VerificationResult verify( const float* pActual, const float* pExpected, size_t count ) const;
+
+		const Tolerance& tolerance() const;
+		size_t numberOfThreads() const;
+	protected:
+		Tolerance tolerance_;
+		size_t numberOfThreads_;
+		size_t mismatchesToRecord_;
+	};
+
+	/** @brief Prints e.g. "4096/4096 correct results (verified in 0.1 ms on 8 threads)." with the maximum
+	 * error and the first mismatching indices if there are any. */
+	void printVerification( const VerificationResult& result, const Tolerance& tolerance, std::ostream& output, const std::string& indent="   " );
+
+} // end of the tools namespace
+
+#endif
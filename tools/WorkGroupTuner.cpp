@@ -0,0 +1,129 @@
+#include "WorkGroupTuner.h"
+
+#include <stdexcept>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <cstdlib>
+#include <algorithm>
+#include "DeviceSession.h"
+#include "OpenCLEnums.h"
+#include "Timing.h"
+#include "Trace.h"
+
+
+tools::WorkGroupSizeTable::WorkGroupSizeTable( const std::string& filename )
+	: filename_(filename)
+{
+	std::ifstream inputFile( filename_ );
+	std::string line;
+	while( std::getline( inputFile, line ) )
+	{
+		size_t firstTab=line.find('\t');
+		if( firstTab==std::string::npos ) continue;
+		try{ entries_[line.substr(firstTab+1)]=std::stoul( line.substr(0,firstTab) ); }
+		catch( std::exception& error ) { /* Ignore any corrupt lines */ }
+	}
+}
+
+void tools::WorkGroupSizeTable::save() const
+{
+	std::ofstream outputFile( filename_ );
+	if( !outputFile.is_open() ) throw std::runtime_error( "Unable to write work group sizes to '"+filename_+"'" );
+	for( const auto& entry : entries_ ) outputFile << entry.second << "\t" << entry.first << "\n";
+}
+
+bool tools::WorkGroupSizeTable::lookup( const cl::Device& device, const std::string& kernelName, const std::string& buildOptions, size_t dataSize, size_t& localSize ) const
+{
+	const auto iFindResult=entries_.find( key(device,kernelName,buildOptions,dataSize) );
+	if( iFindResult==entries_.end() ) return false;
+	localSize=iFindResult->second;
+	return true;
+}
+
+void tools::WorkGroupSizeTable::set( const cl::Device& device, const std::string& kernelName, const std::string& buildOptions, size_t dataSize, size_t localSize )
+{
+	entries_[key(device,kernelName,buildOptions,dataSize)]=localSize;
+}
+
+const std::string& tools::WorkGroupSizeTable::filename() const
+{
+	return filename_;
+}
+
+std::string tools::WorkGroupSizeTable::defaultFilename()
+{
+	const char* home=std::getenv("HOME");
+	if( home==nullptr ) return ".checkOpenCL.worksizes";
+	else return std::string(home)+"/.checkOpenCL.worksizes";
+}
+
+std::string tools::WorkGroupSizeTable::key( const cl::Device& device, const std::string& kernelName, const std::string& buildOptions, size_t dataSize )
+{
+	std::stringstream keyStream;
+	const cl::Platform platform( device.getInfo<CL_DEVICE_PLATFORM>() );
+	keyStream << platform.getInfo<CL_PLATFORM_NAME>() << "\t" << device.getInfo<CL_DEVICE_NAME>() << "\t" << device.getInfo<CL_DRIVER_VERSION>()
+			<< "\t" << kernelName << "\t" << buildOptions << "\t" << dataSize;
+	return keyStream.str();
+}
+
+std::vector<size_t> tools::workGroupSizeCandidates( const cl::Kernel& kernel, const cl::Device& device )
+{
+	size_t multiple=kernel.getWorkGroupInfo<CL_KERNEL_PREFERRED_WORK_GROUP_SIZE_MULTIPLE>(device);
+	if( multiple==0 ) multiple=1;
+	const size_t limit=std::min( kernel.getWorkGroupInfo<CL_KERNEL_WORK_GROUP_SIZE>(device), device.getInfo<CL_DEVICE_MAX_WORK_GROUP_SIZE>() );
+
+	std::vector<size_t> candidates( 1, 0 ); // Zero is the NULL local size
+	if( limit/multiple<=64 )
+	{
+		for( size_t size=multiple; size<=limit; size+=multiple ) candidates.push_back( size );
+	}
+	else
+	{
+		for( size_t size=multiple; size<=limit; size*=2 ) candidates.push_back( size );
+		if( candidates.back()!=limit && limit%multiple==0 ) candidates.push_back( limit );
+	}
+	return candidates;
+}
+
+size_t tools::autotuneWorkGroupSize( const tools::DeviceSession& session, size_t programIndex, size_t iterations, std::ostream* pReport )
+{
+	cl_int error=CL_SUCCESS;
+	const tools::DeviceSession::Program& program=session.programs().at(programIndex);
+	const size_t elementCount=session.elementCount();
+
+	tools::PhaseTimings timings; // Using each candidate size as a phase gives an easy way to print the table
+	size_t bestSize=0;
+	double bestTime=-1;
+	for( const auto localSize : workGroupSizeCandidates( program.kernel, session.device() ) )
+	{
+		std::stringstream label;
+		if( localSize==0 ) label << "local NULL";
+		else label << "local " << localSize;
+		tools::TimingStatistics& statistics=timings.phase( label.str(), (session.bytesPerElement()*2)*elementCount, elementCount );
+
+		for( size_t iteration=0; iteration<=iterations; ++iteration )
+		{
+			cl::Event kernelEvent;
+			error=tools::trace::enqueueNDRangeKernel( session.queue(), program.kernel, 0, tools::DeviceSession::globalRange( tools::DeviceSession::workItemCount( program, elementCount ), localSize ),
+					tools::DeviceSession::localRange( localSize ), nullptr, &kernelEvent );
+			if( error==CL_INVALID_WORK_GROUP_SIZE || error==CL_OUT_OF_RESOURCES ) break; // Not usable for this kernel, skip it
+			if( error!=CL_SUCCESS ) throw std::runtime_error( "Error when enqueing kernel - "+tools::enqueKernelError(error) );
+			kernelEvent.wait();
+			if( iteration!=0 ) statistics.addSample( tools::eventDuration(kernelEvent) ); // First one is a warm up
+		}
+
+		if( !statistics.empty() && (bestTime<0 || statistics.median()<bestTime) )
+		{
+			bestTime=statistics.median();
+			bestSize=localSize;
+		}
+	}
+
+	if( pReport )
+	{
+		timings.print( *pReport );
+		*pReport << "   Best local size is " << (bestSize==0 ? std::string("NULL") : std::to_string(bestSize)) << std::endl;
+	}
+	return bestSize;
+}
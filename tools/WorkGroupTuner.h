@@ -0,0 +1,67 @@
+#ifndef INCLUDEGUARD_tools_WorkGroupTuner_h
+#define INCLUDEGUARD_tools_WorkGroupTuner_h
+
+#include <vector>
+#include <string>
+#include <map>
+#include <iosfwd>
+#include <CL/cl.hpp>
+
+//
+// Forward declarations
+//
+namespace tools
+{
+	class DeviceSession;
+}
+
+namespace tools
+{
+	/** @brief The best local work group size for each (device, kernel, data size), stored in a small text file.
+	 *
+	 * Each line of the file is tab separated: local size, platform name, device name, driver version, kernel
+	 * name, build options, data size. The same device name can be on more than one platform, a new driver can
+	 * change the best size, and so can building the same kernel with other options (e.g. a vector width). A local size of zero means passing a NULL local size and letting the runtime choose.
+	 */
+	class WorkGroupSizeTable
+	{
+	public:
+		/** @brief Loads the file if it exists. A missing file is just an empty table. */
+		explicit WorkGroupSizeTable( const std::string& filename );
+		/** @brief Writes the whole table back to the file.
+		 *
+		 * @throw std::runtime_error     If the file can't be written.
+		 */
+		void save() const;
+		/** @brief Returns true and sets "localSize" if there is an entry, otherwise returns false. */
+		bool lookup( const cl::Device& device, const std::string& kernelName, const std::string& buildOptions, size_t dataSize, size_t& localSize ) const;
+		void set( const cl::Device& device, const std::string& kernelName, const std::string& buildOptions, size_t dataSize, size_t localSize );
+		const std::string& filename() const;
+		/** @brief Default file used if none is given on the command line, "$HOME/.checkOpenCL.worksizes". */
+		static std::string defaultFilename();
+	protected:
+		static std::string key( const cl::Device& device, const std::string& kernelName, const std::string& buildOptions, size_t dataSize );
+		std::string filename_;
+		std::map<std::string,size_t> entries_; ///< @brief Keyed by the tab separated platform, device, driver, kernel, build options and data size.
+	};
+
+	/** @brief The local sizes worth trying for a kernel: multiples of CL_KERNEL_PREFERRED_WORK_GROUP_SIZE_MULTIPLE
+	 * up to the kernel and device limit, plus zero for a NULL local size.
+	 *
+	 * If there would be more than 64 multiples then only power of two multiples (and the limit) are used.
+	 */
+	std::vector<size_t> workGroupSizeCandidates( const cl::Kernel& kernel, const cl::Device& device );
+
+	/** @brief Times one of the session's kernels with each candidate local size, returning the fastest.
+	 *
+	 * The global size is padded up to a multiple of the local size, which relies on the kernel checking
+	 * its bounds. The session must have been created with profiling enabled. Each candidate is run once
+	 * to warm up and then "iterations" times, and the median kernel time compared. If pReport is not
+	 * null a table of the results is printed to it.
+	 * @throw std::runtime_error     If profiling is not enabled or a kernel can't be enqueued.
+	 */
+	size_t autotuneWorkGroupSize( const tools::DeviceSession& session, size_t programIndex, size_t iterations=5, std::ostream* pReport=nullptr );
+
+} // end of the tools namespace
+
+#endif
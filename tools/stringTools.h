@@ -1,6 +1,13 @@
+#ifndef INCLUDEGUARD_tools_stringTools_h
+#define INCLUDEGUARD_tools_stringTools_h
+
+#include <vector>
+#include <string>
+#include <cstdio>
+
 namespace tools
 {
-	std::vector<std::string> splitByWhitespace( const std::string& stringToSplit )
+	inline std::vector<std::string> splitByWhitespace( const std::string& stringToSplit )
 	{
 		const char* whitespace="\x20\x09\x0D\x0A";
 
@@ -29,4 +36,32 @@ namespace tools
 		return returnValue;
 	}
 
+	/** @brief Escapes the text for use inside a JSON string (without the surrounding quotes). */
+	inline std::string jsonEscape( const std::string& text )
+	{
+		std::string escaped;
+		for( const char character : text )
+		{
+			switch( character )
+			{
+				case '"': escaped+="\\\""; break;
+				case '\\': escaped+="\\\\"; break;
+				case '\n': escaped+="\\n"; break;
+				case '\t': escaped+="\\t"; break;
+				case '\r': escaped+="\\r"; break;
+				default:
+					if( static_cast<unsigned char>(character)<0x20 )
+					{
+						char buffer[8];
+						std::snprintf( buffer, sizeof(buffer), "\\u%04x", character );
+						escaped+=buffer;
+					}
+					else escaped+=character;
+			}
+		}
+		return escaped;
+	}
+
 } // end of namespace tools
+
+#endif